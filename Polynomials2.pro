@@ -8,13 +8,20 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# Per-operation counters and traces of core.h, see View > Performance stats
+#DEFINES += CORE_PROFILING
+
 SOURCES += \
+    basemodel.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    statsdialog.cpp
 
 HEADERS += \
+    basemodel.h \
     core.h \
-    mainwindow.h
+    mainwindow.h \
+    statsdialog.h
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,15 @@
+# Allocation test for the hot paths of core.h, exits with 1 if one of them allocates after warmup
+TEMPLATE = app
+TARGET = polynomials-alloc-test
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+# Term storage allocations are counted by the profiler
+DEFINES += CORE_PROFILING
+
+SOURCES += \
+    alloctest.cpp
+
+HEADERS += \
+    core.h
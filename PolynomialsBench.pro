@@ -0,0 +1,12 @@
+# Benchmarks for core.h, prints JSON results. Build in release mode for meaningful numbers
+TEMPLATE = app
+TARGET = polynomials-bench
+
+CONFIG += console c++17 thread release
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    bench.cpp
+
+HEADERS += \
+    core.h
@@ -0,0 +1,20 @@
+# Headless command line driver, needs nothing but core.h
+TEMPLATE = app
+TARGET = polynomials-cli
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+# Needed for --profile and --trace
+#DEFINES += CORE_PROFILING
+
+SOURCES += \
+    cli.cpp
+
+HEADERS += \
+    core.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
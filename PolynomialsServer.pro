@@ -0,0 +1,17 @@
+# Query server over one shared base, also its test client (--client). Needs nothing but core.h and POSIX sockets
+TEMPLATE = app
+TARGET = polynomials-server
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    server.cpp
+
+HEADERS += \
+    core.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
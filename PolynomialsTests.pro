@@ -0,0 +1,12 @@
+# Correctness checks for core.h, exits with 1 if one of them fails
+TEMPLATE = app
+TARGET = polynomials-tests
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    tests.cpp
+
+HEADERS += \
+    core.h
@@ -0,0 +1,165 @@
+#include "core.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Checks that the hot paths don't allocate once their buffers are warm.
+// Every allocation of the process goes through the operator new below, term storage allocations
+// are also counted by the profiler (this target defines CORE_PROFILING). Exits with 1 if a check fails
+
+static std::atomic<uint64_t> allocations{ 0 };
+
+// Out of line, so g++ doesn't see free meeting memory of an inlined new expression and warn about the pair
+__attribute__((noinline)) static void Free(void *p) noexcept {
+	std::free(p);
+}
+
+void* operator new(size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+void operator delete(void *p) noexcept {
+	Free(p);
+}
+void operator delete[](void *p) noexcept {
+	Free(p);
+}
+void operator delete(void *p, size_t) noexcept {
+	Free(p);
+}
+void operator delete[](void *p, size_t) noexcept {
+	Free(p);
+}
+
+static constexpr uint32_t WARMUP = 4;
+static constexpr uint32_t REPEATS = 1000;
+static bool failed = false;
+
+static void Check(const char *name, uint64_t count) {
+	std::printf("%-50s %llu\n", name, (unsigned long long) count);
+	if (count) failed = true;
+}
+
+// Allocations made by REPEATS calls of f after WARMUP calls
+template<typename F>
+static uint64_t Allocations(F f) {
+	for (uint32_t i = 0; i < WARMUP; ++i)
+		f();
+	uint64_t before = allocations.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < REPEATS; ++i)
+		f();
+	return allocations.load(std::memory_order_relaxed) - before;
+}
+
+// Term storage allocations counted by the profiler for the same calls
+template<typename F>
+static uint64_t TermAllocations(F f) {
+	for (uint32_t i = 0; i < WARMUP; ++i)
+		f();
+	Core::Profiler::Instance().Reset();
+	{
+		// Allocations are only counted inside an operation
+		Core::ProfileScope scope(Core::ProfiledOperation::LOAD, 0);
+		for (uint32_t i = 0; i < REPEATS; ++i)
+			f();
+	}
+	return Core::Profiler::Instance().Stats()[(uint32_t) Core::ProfiledOperation::LOAD].allocations;
+}
+
+static Core::Polynomial Parse(const char *text) {
+	Core::Polynomial p;
+	if (p.InitFromString(text).first != Core::PolynomialGrammar::OK) {
+		std::fprintf(stderr, "can't parse %s\n", text);
+		std::exit(1);
+	}
+	return p;
+}
+
+int main() {
+	static_assert(Core::PROFILING, "build with CORE_PROFILING");
+	Core::Polynomial sparse_lhs = Parse("3x^1000+2x^70-x^3+5"), sparse_rhs = Parse("x^1000-2x^70+x^5+1");
+	Core::Polynomial dense_lhs = Parse("x^5+2x^4+3x^3+x^2+x+1"), dense_rhs = Parse("x^4-x^3+x^2-2x+7");
+	Core::Polynomial res;
+	Core::Polynomial::Term term{ 3, 5 };
+
+	Check("Add sparse", Allocations([&] {
+		Add(sparse_lhs, sparse_rhs, res);
+	}));
+	Check("Add dense", Allocations([&] {
+		Add(dense_lhs, dense_rhs, res);
+	}));
+	Check("Add sparse and dense into one result", Allocations([&] {
+		Add(sparse_lhs, sparse_rhs, res);
+		Add(dense_lhs, dense_rhs, res);
+	}));
+	Check("MultiplyByTerm sparse", Allocations([&] {
+		MultiplyByTerm(sparse_lhs, term, res);
+	}));
+	Check("MultiplyByTerm dense", Allocations([&] {
+		MultiplyByTerm(dense_lhs, term, res);
+	}));
+
+	// Nodes come from the list's pool, once it has enough free nodes and slab slots nothing is allocated
+	using IntList = Core::List<uint64_t>;
+	IntList list, other;
+	Check("List::EmplaceBack and Delete", Allocations([&] {
+		for (uint64_t i = 0; i < 64; ++i)
+			list.EmplaceBack(i);
+		while (!list.Empty())
+			list.Delete(list.Head());
+	}));
+	for (uint64_t i = 0; i < 64; ++i) {
+		list.EmplaceBack(i);
+		other.EmplaceFront(i);
+	}
+	Check("List::EmplaceAfter and EmplaceBefore", Allocations([&] {
+		list.Delete(list.EmplaceAfter(list.Head(), 1));
+		list.Delete(list.EmplaceBefore(list.Tail(), 2));
+	}));
+	Check("List move construction and assignment", Allocations([&] {
+		IntList moved(std::move(list));
+		list = std::move(moved);
+	}));
+	Check("List::Splice of a whole list", Allocations([&] {
+		list.Splice(list.Head(), other);
+		other.Splice(nullptr, list);
+	}));
+	other.Splice(nullptr, list);
+	for (uint64_t i = 0; i < 64; ++i)
+		list.EmplaceBack(i);
+	Check("List::Splice of one node", Allocations([&] {
+		list.Splice(list.Head(), list, list.Tail());
+		other.Splice(nullptr, list, list.Head());
+		list.Splice(nullptr, other, other.Tail());
+	}));
+
+	// Every change of the base makes a new version (the undo history and snapshots keep the old ones),
+	// that bookkeeping is a few allocations per call whatever the polynomial is. The polynomial itself has to be moved in:
+	// every source has terms of its own, afterwards the base holds that very buffer and the source is empty
+	Core::Base base;
+	Core::Polynomial big = Parse("x^100000+x^50000+x^2+1");
+	for (uint32_t i = 0; i < 1000; ++i)
+		big.AddTerm({ 3 + 7 * i, (int32_t) i + 1 });
+	std::vector<Core::Polynomial> sources(WARMUP + REPEATS), watchers(WARMUP + REPEATS);
+	for (uint32_t i = 0; i < sources.size(); ++i) {
+		Add(big, Parse("x"), sources[i]);
+		watchers[i] = sources[i];
+	}
+	uint32_t next = 0, first = (uint32_t) base.Size();
+	Check("Base::AddPolynomial(Polynomial&&) terms", TermAllocations([&] {
+		base.AddPolynomial(std::move(sources[next++]));
+	}));
+	uint64_t not_moved = 0;
+	for (uint32_t i = 0; i < sources.size(); ++i)
+		if (!sources[i].Empty() || !base.GetPolynomial(first + i).SharesTermsWith(watchers[i]))
+			++not_moved;
+	Check("Base::AddPolynomial(Polynomial&&) not moved", not_moved);
+
+	std::printf(failed ? "FAILED\n" : "OK\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+#include "basemodel.h"
+
+BaseModel::BaseModel(Core::Base & base, QObject *parent)
+	: QAbstractListModel(parent), base(base) {}
+
+int BaseModel::rowCount(const QModelIndex & parent) const {
+	if (parent.isValid()) return 0;
+	return (int) base.Size();
+}
+
+QVariant BaseModel::data(const QModelIndex & index, int role) const {
+	if (role != Qt::DisplayRole || !index.isValid() || index.row() >= rowCount())
+		return QVariant();
+	// Number isn't cached, it shifts after deletions
+	return QString::number(index.row() + 1) + ". " + Formatted((uint32_t) index.row());
+}
+
+const QString & BaseModel::Formatted(uint32_t index) const {
+	// Handle and text from the same version of the base
+	Core::Base::Snapshot snapshot = base.GetSnapshot();
+	uint64_t id = snapshot.GetHandle(index).id;
+	auto found = cache_index.find(id);
+	if (found != cache_index.end()) {
+		cache.splice(cache.begin(), cache, found->second);
+		return cache.front().text;
+	}
+	QString text = QString::fromStdString(snapshot.GetPolynomial(index).ToString(MAX_ROW_LENGTH));
+	cache_characters += text.size();
+	cache.push_front(CacheEntry{ id, std::move(text) });
+	cache_index[id] = cache.begin();
+	while (cache.size() > 1 && (cache.size() > CACHE_ROWS || cache_characters > CACHE_CHARACTERS)) {
+		cache_characters -= cache.back().text.size();
+		cache_index.erase(cache.back().id);
+		cache.pop_back();
+	}
+	return cache.front().text;
+}
+
+void BaseModel::Append(Core::Polynomial && p) {
+	int row = rowCount();
+	beginInsertRows(QModelIndex(), row, row);
+	base.AddPolynomial(std::move(p));
+	endInsertRows();
+}
+
+void BaseModel::Append(Core::Base::Loaded && loaded) {
+	// Multivariate polynomials aren't rows
+	if (!loaded.Size()) {
+		base.AddLoaded(std::move(loaded));
+		return;
+	}
+	int row = rowCount();
+	beginInsertRows(QModelIndex(), row, row + (int) loaded.Size() - 1);
+	base.AddLoaded(std::move(loaded));
+	endInsertRows();
+}
+
+void BaseModel::Remove(uint32_t index) {
+	if (index >= base.Size()) return;
+	uint64_t id = base.GetHandle(index).id;
+	beginRemoveRows(QModelIndex(), (int) index, (int) index);
+	base.DeletePolynomial(index);
+	endRemoveRows();
+	auto found = cache_index.find(id);
+	if (found != cache_index.end()) {
+		cache_characters -= found->second->text.size();
+		cache.erase(found->second);
+		cache_index.erase(found);
+	}
+	// Rows below got renumbered, views only repaint what's visible
+	if (index < base.Size())
+		emit dataChanged(createIndex((int) index, 0), createIndex(rowCount() - 1, 0), { Qt::DisplayRole });
+}
+
+// Whole versions of the base are swapped, rows are cached by handle so the cache survives
+bool BaseModel::Undo() {
+	beginResetModel();
+	bool undone = base.Undo();
+	endResetModel();
+	return undone;
+}
+
+bool BaseModel::Redo() {
+	beginResetModel();
+	bool redone = base.Redo();
+	endResetModel();
+	return redone;
+}
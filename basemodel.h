@@ -0,0 +1,47 @@
+#ifndef BASEMODEL_H
+#define BASEMODEL_H
+
+#include "core.h"
+#include <QAbstractListModel>
+#include <QString>
+#include <list>
+#include <unordered_map>
+
+// Shows Core::Base in a QListView, rows are formatted only when the view asks for them
+// Every change of the base has to go through the model so the view gets row-level signals
+class BaseModel : public QAbstractListModel {
+	Q_OBJECT
+
+public:
+	// Cache limits, whichever is hit first evicts least recently shown rows
+	static constexpr uint32_t CACHE_ROWS = 4096;
+	static constexpr uint64_t CACHE_CHARACTERS = 1 << 23;
+	// Longer polynomials are cut when shown
+	static constexpr uint32_t MAX_ROW_LENGTH = 4096;
+
+	BaseModel(Core::Base & base, QObject *parent = nullptr);
+	int rowCount(const QModelIndex & parent = QModelIndex()) const override;
+	QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
+
+	void Append(Core::Polynomial && p);
+	// Everything read from a file, in one step of the history
+	void Append(Core::Base::Loaded && loaded);
+	void Remove(uint32_t index);
+	// False if there was nothing to undo or redo
+	bool Undo();
+	bool Redo();
+
+private:
+	struct CacheEntry {
+		uint64_t id;
+		QString text;
+	};
+	Core::Base & base;
+	// Front is the most recently used
+	mutable std::list<CacheEntry> cache;
+	mutable std::unordered_map<uint64_t, std::list<CacheEntry>::iterator> cache_index;
+	mutable uint64_t cache_characters = 0;
+
+	const QString & Formatted(uint32_t index) const;
+};
+#endif // BASEMODEL_H
@@ -0,0 +1,451 @@
+#include "core.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+// Benchmarks for core.h, results are printed as JSON so runs on the same machine can be compared.
+// Not a test, nothing is checked here besides the results being used
+
+static void Usage() {
+	std::cerr <<
+		"Usage: polynomials-bench [options]\n"
+		"Options:\n"
+		"  -f, --filter TEXT      only run benchmarks with TEXT in the name\n"
+		"  -m, --min-time MS      time each benchmark for at least MS milliseconds (default 200)\n"
+		"  -o, --output FILE      write JSON to FILE instead of stdout\n"
+		"  -d, --dir DIR          directory for temporary files of load/save benchmarks (default /tmp)\n"
+		"  -q, --quick            smallest sizes only\n";
+}
+
+// Keeps the compiler from throwing away results that are never used
+template<typename T>
+static void Keep(const T & value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r"(&value) : "memory");
+#else
+	static const void * volatile sink;
+	sink = &value;
+#endif
+}
+
+// Synthetic polynomials, every generator is deterministic for a given seed
+class Generator {
+private:
+	std::mt19937_64 rng;
+
+	int32_t Coefficient() {
+		// Non-zero and small enough so products of a few thousand terms don't overflow much
+		int32_t value = (int32_t) (rng() % 199) - 99;
+		return value ? value : 1;
+	}
+public:
+	explicit Generator(uint64_t seed): rng(seed) {}
+
+	// Every degree below n is present
+	Core::Polynomial Dense(uint32_t n) {
+		Core::Polynomial p;
+		for (uint32_t i = 0; i < n; ++i)
+			p.AddTerm({ i, Coefficient() });
+		return p;
+	}
+	// terms random degrees below max_degree
+	Core::Polynomial Sparse(uint32_t terms, uint64_t max_degree) {
+		std::vector<uint64_t> degrees(terms);
+		for (uint64_t & degree : degrees)
+			degree = rng() % max_degree;
+		std::sort(degrees.begin(), degrees.end());
+		degrees.erase(std::unique(degrees.begin(), degrees.end()), degrees.end());
+		Core::Polynomial p;
+		for (uint64_t degree : degrees)
+			p.AddTerm({ degree, Coefficient() });
+		return p;
+	}
+	// Few terms with degrees up to 2^62, so the product of two still fits
+	Core::Polynomial HugeDegree(uint32_t terms) {
+		return Sparse(terms, (uint64_t) 1 << 62);
+	}
+	// Degrees of 2^63 and more, the top one is 2^64 - 2 so the integral still fits
+	template<typename C>
+	Core::BasicPolynomial<C> TopDegrees(uint32_t terms) {
+		Core::BasicPolynomial<C> p;
+		for (uint32_t i = 0; i < terms; ++i)
+			p.AddTerm({ ((uint64_t) 1 << 63) + rng() % ((uint64_t) 1 << 62), C(Coefficient()) });
+		p.AddTerm({ UINT64_MAX - 1, C(1) });
+		return p;
+	}
+	// Product of (x - r) over small roots, so GetRoots has something to find
+	Core::Polynomial WithRoots(uint32_t roots) {
+		Core::Polynomial p, factor, product;
+		p.AddTerm({ 0, 1 });
+		for (uint32_t i = 0; i < roots; ++i) {
+			factor = Core::Polynomial();
+			factor.AddTerm({ 1, 1 });
+			factor.AddTerm({ 0, (int32_t) (rng() % 7) - 3 });
+			Multiply(p, factor, product);
+			std::swap(p, product);
+		}
+		return p;
+	}
+	// Polynomial with small roots times x^gap plus another one, the gap is too wide for anything but
+	// the lacunary split to handle
+	Core::Polynomial Lacunary(uint32_t roots, uint64_t gap) {
+		Core::Polynomial low = WithRoots(roots), high = WithRoots(roots), p;
+		MultiplyByTerm(high, { gap, 1 }, high);
+		Add(low, high, p);
+		return p;
+	}
+};
+
+class Runner {
+private:
+	struct Result {
+		std::string name;
+		uint64_t size;
+		uint64_t iterations;
+		double ns_per_op;
+		double min_ns;
+		double items_per_second;
+	};
+	std::string filter;
+	double min_time_ns;
+	std::vector<Result> results;
+public:
+	Runner(std::string filter, double min_time_ms): filter(std::move(filter)), min_time_ns(min_time_ms * 1e6) {}
+
+	// Runs f in rounds of growing length until min time is spent, items is the work done per call
+	// (terms, lines) and only affects items_per_second
+	template<typename F>
+	void Run(const std::string & name, uint64_t size, uint64_t items, F f) {
+		if (!filter.empty() && name.find(filter) == std::string::npos) return;
+		using Clock = std::chrono::steady_clock;
+		uint64_t iterations = 0, batch = 1;
+		double total = 0, best = 1e300;
+		while (total < min_time_ns || iterations < 3) {
+			auto start = Clock::now();
+			for (uint64_t i = 0; i < batch; ++i)
+				f();
+			double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+			total += elapsed;
+			iterations += batch;
+			best = std::min(best, elapsed / batch);
+			// Batches grow so the clock isn't read around every call of fast operations
+			if (elapsed < min_time_ns / 20) batch *= 2;
+		}
+		Result result{ name, size, iterations, total / iterations, best, items * 1e9 / (total / iterations) };
+		std::cerr << name << '/' << size << ": " << result.ns_per_op << " ns/op, " << iterations << " runs" << std::endl;
+		results.push_back(std::move(result));
+	}
+	void WriteJson(std::ostream & out) const {
+		out << "{\n  \"compiler\": \"" <<
+#ifdef __VERSION__
+			__VERSION__
+#else
+			"unknown"
+#endif
+			<< "\",\n  \"threads\": " << std::thread::hardware_concurrency()
+			<< ",\n  \"benchmarks\": [\n";
+		for (size_t i = 0; i < results.size(); ++i) {
+			const Result & r = results[i];
+			out << "    {\"name\": \"" << r.name << "\", \"size\": " << r.size << ", \"iterations\": " << r.iterations
+				<< ", \"ns_per_op\": " << r.ns_per_op << ", \"min_ns\": " << r.min_ns
+				<< ", \"items_per_second\": " << r.items_per_second << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+		}
+		out << "  ]\n}\n";
+	}
+};
+
+static void PolynomialBenchmarks(Runner & runner, const std::vector<uint32_t> & sizes) {
+	Generator gen(1);
+	for (uint32_t n : sizes) {
+		Core::Polynomial dense_a = gen.Dense(n), dense_b = gen.Dense(n);
+		Core::Polynomial sparse_a = gen.Sparse(n, n * 64), sparse_b = gen.Sparse(n, n * 64);
+		Core::Polynomial huge_a = gen.HugeDegree(n), huge_b = gen.HugeDegree(n);
+		Core::Polynomial top = gen.TopDegrees<int32_t>(n);
+		Core::BasicPolynomial<Core::BigInt> top_big = gen.TopDegrees<Core::BigInt>(n);
+		std::string dense_text = dense_a.ToString(), sparse_text = sparse_a.ToString();
+		Core::Polynomial result;
+
+		runner.Run("InitFromString/dense", n, n, [&]() {
+			Core::Polynomial p;
+			p.InitFromString(dense_text);
+			Keep(p);
+		});
+		runner.Run("InitFromString/sparse", n, n, [&]() {
+			Core::Polynomial p;
+			p.InitFromString(sparse_text);
+			Keep(p);
+		});
+		runner.Run("ExportAsString/dense", n, n, [&]() {
+			Keep(dense_a.ToString());
+		});
+		runner.Run("Add/dense", n, n, [&]() {
+			Add(dense_a, dense_b, result);
+			Keep(result);
+		});
+		runner.Run("Add/sparse", n, n, [&]() {
+			Add(sparse_a, sparse_b, result);
+			Keep(result);
+		});
+		runner.Run("Multiply/dense", n, n, [&]() {
+			Multiply(dense_a, dense_b, result);
+			Keep(result);
+		});
+		runner.Run("Multiply/sparse", n, n, [&]() {
+			Multiply(sparse_a, sparse_b, result);
+			Keep(result);
+		});
+		runner.Run("MultiplyTruncated/dense/tenth", n, n, [&]() {
+			MultiplyTruncated(dense_a, dense_b, n / 10, result);
+			Keep(result);
+		});
+		runner.Run("CoefficientOfProduct/dense", n, n, [&]() {
+			Keep(CoefficientOfProduct(dense_a, dense_b, n));
+		});
+		runner.Run("CoefficientOfProduct/sparse", n, n, [&]() {
+			Keep(CoefficientOfProduct(sparse_a, sparse_b, n * 64));
+		});
+		// Monic divisor so the division is exact over the integers, the dividend is twice as long
+		Core::Polynomial divisor = dense_b, dividend;
+		divisor.AddTerm({ n, 1 });
+		Multiply(dense_a, divisor, dividend);
+		runner.Run("Divide/dense", n, n, [&]() {
+			Core::Polynomial remainder;
+			Divide(dividend, divisor, result, remainder);
+			Keep(result);
+		});
+		// Subresultant coefficients grow with the degree, so only small ones
+		if (n <= 256) {
+			runner.Run("Gcd/dense", n, n, [&]() {
+				Gcd(dividend, dense_b, result);
+				Keep(result);
+			});
+		}
+		if (n <= 4096) {
+			runner.Run("Multiply/huge_degree", n, n, [&]() {
+				Multiply(huge_a, huge_b, result);
+				Keep(result);
+			});
+		}
+		runner.Run("Derivative/dense", n, n, [&]() {
+			Core::Polynomial derivative;
+			Derivative(dense_a, 3, derivative);
+			Keep(derivative);
+		});
+		runner.Run("Derivative/sparse", n, n, [&]() {
+			Core::Polynomial derivative;
+			Derivative(sparse_a, 3, derivative);
+			Keep(derivative);
+		});
+		runner.Run("Derivative/top_degrees/bigint", n, n, [&]() {
+			Core::BasicPolynomial<Core::BigInt> derivative;
+			Derivative(top_big, 2, derivative);
+			Keep(derivative);
+		});
+		runner.Run("Integral/top_degrees", n, n, [&]() {
+			Core::BasicPolynomial<Core::Rational> integral;
+			Integral(top, 1, integral);
+			Keep(integral);
+		});
+		runner.Run("Evaluate/dense/int64", n, n, [&]() {
+			Keep(dense_a.Evaluate((int64_t) 3));
+		});
+		runner.Run("Evaluate/dense/double", n, n, [&]() {
+			Keep(dense_a.Evaluate(0.999));
+		});
+		runner.Run("Evaluate/huge_degree/double", n, n, [&]() {
+			Keep(huge_a.Evaluate(0.999999));
+		});
+		std::vector<double> xs(1024), ys(xs.size());
+		for (uint32_t i = 0; i < xs.size(); ++i)
+			xs[i] = i / 1024.0;
+		runner.Run("EvaluateMany/dense/double", n, (uint64_t) n * xs.size(), [&]() {
+			dense_a.EvaluateMany(xs.data(), ys.data(), xs.size());
+			Keep(ys);
+		});
+		runner.Run("EvaluateMany/huge_degree/double", n, (uint64_t) n * xs.size(), [&]() {
+			huge_a.EvaluateMany(xs.data(), ys.data(), xs.size());
+			Keep(ys);
+		});
+		// As many points as coefficients, long ones go through subproduct trees
+		std::vector<int32_t> points(n), values;
+		for (uint32_t i = 0; i < n; ++i)
+			points[i] = (int32_t) i - (int32_t) (n / 2);
+		runner.Run("EvaluateMany/dense/n_points", n, (uint64_t) n * n, [&]() {
+			dense_a.EvaluateMany(points, values);
+			Keep(values);
+		});
+		using Modular = Core::Zp<998244353>;
+		std::vector<Modular> modular_points(points.begin(), points.end()), modular_values;
+		Core::BasicPolynomial<Modular> modular_result;
+		dense_a.EvaluateMany(points, values);
+		modular_values.assign(values.begin(), values.end());
+		runner.Run("Interpolate/zp", n, n, [&]() {
+			Interpolate(modular_points, modular_values, modular_result);
+			Keep(modular_result);
+		});
+	}
+	// Root finding cost grows with the root count and coefficient size rather than the term count
+	for (uint32_t roots : { 2u, 6u, 10u }) {
+		Core::Polynomial p = gen.WithRoots(roots);
+		runner.Run("GetRoots/with_roots", roots, 1, [&]() {
+			Keep(p.GetRootsWithMultiplicity());
+		});
+	}
+	for (uint32_t roots : { 2u, 6u, 10u }) {
+		Core::Polynomial p = gen.Lacunary(roots, (uint64_t) 1 << 50);
+		runner.Run("GetRoots/lacunary", roots, 1, [&]() {
+			Keep(p.GetRootsWithMultiplicity());
+		});
+	}
+	for (uint32_t n : sizes) {
+		if (n > 1024) break;
+		Core::Polynomial p = gen.Dense(n);
+		runner.Run("GetRoots/dense", n, 1, [&]() {
+			Keep(p.GetRootsWithMultiplicity());
+		});
+	}
+	// Fateman's product: f = (1 + t + x + y + z)^k times f + 1, dense in four variables
+	for (uint32_t k : { 4u, 8u, 12u }) {
+		Core::MultivariatePolynomial base, f, g, one, product;
+		base.InitFromString("1 + t + x + y + z");
+		one.InitFromString("1");
+		f = one;
+		for (uint32_t i = 0; i < k; ++i)
+			Multiply(f, base, f);
+		Add(f, one, g);
+		runner.Run("Multivariate/Multiply/fateman", k, (uint64_t) f.Size() * g.Size(), [&]() {
+			Multiply(f, g, product);
+			Keep(product);
+		});
+		runner.Run("Multivariate/Derivative", k, f.Size(), [&]() {
+			Derivative(f, 'x', 2, product);
+			Keep(product);
+		});
+	}
+}
+
+static void BaseBenchmarks(Runner & runner, const std::vector<uint32_t> & sizes, const std::string & dir) {
+	Generator gen(2);
+	for (uint32_t n : sizes) {
+		uint32_t lines = n * 16;
+		Core::Base base;
+		for (uint32_t i = 0; i < lines; ++i)
+			base.AddPolynomial(gen.Sparse(8, 64));
+		std::mt19937 rng(3);
+		runner.Run("Base::GetPolynomial/random", lines, 1, [&]() {
+			Keep(base.GetPolynomial(rng() % lines));
+		});
+		runner.Run("Base::GetPolynomial/sequential", lines, lines, [&]() {
+			for (uint32_t i = 0; i < lines; ++i)
+				Keep(base.GetPolynomial(i));
+		});
+		runner.Run("Base::Snapshot/sequential", lines, lines, [&]() {
+			Core::Base::Snapshot snapshot = base.GetSnapshot();
+			for (uint32_t i = 0; i < lines; ++i)
+				Keep(snapshot.GetPolynomial(i));
+		});
+		runner.Run("Base::GetSnapshot", lines, 1, [&]() {
+			Keep(base.GetSnapshot().Size());
+		});
+		// A writer copies the chunk index and one chunk per change
+		Core::Polynomial extra = base.GetPolynomial(0);
+		runner.Run("Base::AddPolynomial+Undo", lines, 1, [&]() {
+			base.AddPolynomial(extra, lines / 2);
+			base.Undo();
+		});
+		// Readers don't wait for the writer
+		{
+			std::atomic<bool> stop{ false };
+			std::thread writer([&]() {
+				while (!stop.load(std::memory_order_relaxed)) {
+					base.AddPolynomial(extra, lines / 2);
+					base.Undo();
+				}
+			});
+			runner.Run("Base::GetPolynomial/concurrent writer", lines, 1, [&]() {
+				Keep(base.GetPolynomial(rng() % lines));
+			});
+			stop = true;
+			writer.join();
+		}
+		base.ClearHistory();
+		// Same operands over and over, the second one is served by the result cache
+		base.SetCacheCapacity(0);
+		runner.Run("Base::MultiplyPolynomials/uncached", lines, 1, [&]() {
+			Keep(base.MultiplyPolynomials(0, 1));
+		});
+		base.SetCacheCapacity(Core::Base::DEFAULT_CACHE_CAPACITY);
+		runner.Run("Base::MultiplyPolynomials/cached", lines, 1, [&]() {
+			Keep(base.MultiplyPolynomials(0, 1));
+		});
+
+		std::string text_path = dir + "/polynomials-bench.pln", binary_path = dir + "/polynomials-bench.plnb";
+		runner.Run("Base::SaveToStream", lines, lines, [&]() {
+			std::ofstream output(text_path);
+			base.SaveToStream(output);
+		});
+		runner.Run("Base::LoadFromFile", lines, lines, [&]() {
+			Core::Base loaded;
+			Keep(loaded.LoadFromFile(text_path));
+		});
+		runner.Run("Base::LoadFromStream", lines, lines, [&]() {
+			std::ifstream input(text_path);
+			Core::Base loaded;
+			Keep(loaded.LoadFromStream(input));
+		});
+		runner.Run("Base::SaveToBinary", lines, lines, [&]() {
+			std::ofstream output(binary_path, std::ios::binary);
+			base.SaveToBinary(output);
+		});
+		runner.Run("Base::LoadFromBinary", lines, lines, [&]() {
+			std::ifstream input(binary_path, std::ios::binary);
+			Core::Base loaded;
+			Keep(loaded.LoadFromBinary(input));
+		});
+		std::remove(text_path.c_str());
+		std::remove(binary_path.c_str());
+	}
+}
+
+int main(int argc, char *argv[]) {
+	std::string filter, output_path, dir = "/tmp";
+	double min_time = 200;
+	bool quick = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) {
+				std::cerr << arg << " needs a value" << std::endl;
+				std::exit(2);
+			}
+			return argv[++i];
+		};
+		if (arg == "-f" || arg == "--filter") filter = value();
+		else if (arg == "-m" || arg == "--min-time") min_time = std::atof(value().c_str());
+		else if (arg == "-o" || arg == "--output") output_path = value();
+		else if (arg == "-d" || arg == "--dir") dir = value();
+		else if (arg == "-q" || arg == "--quick") quick = true;
+		else {
+			if (arg != "-h" && arg != "--help")
+				std::cerr << "Unknown option " << arg << std::endl;
+			Usage();
+			return arg == "-h" || arg == "--help" ? 0 : 2;
+		}
+	}
+	std::vector<uint32_t> sizes = quick ? std::vector<uint32_t>{ 64 } : std::vector<uint32_t>{ 16, 256, 4096, 65536 };
+	Runner runner(filter, min_time);
+	PolynomialBenchmarks(runner, sizes);
+	BaseBenchmarks(runner, sizes, dir);
+	if (output_path.empty()) {
+		runner.WriteJson(std::cout);
+	} else {
+		std::ofstream output(output_path);
+		if (!output) {
+			std::cerr << "Couldn't open " << output_path << std::endl;
+			return 1;
+		}
+		runner.WriteJson(output);
+	}
+	return 0;
+}
@@ -0,0 +1,428 @@
+#include "core.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cerrno>
+
+// Headless driver over Core::Base, see Usage() for the script format
+
+static void Usage() {
+	std::cerr <<
+		"Usage: polynomials-cli [options] [input.pln | input.plnb | -]...\n"
+		"Options:\n"
+		"  -e, --exec \"OP ARGS\"   run one operation, can be repeated\n"
+		"  -s, --script FILE      run operations from FILE, one per line ('-' is stdin)\n"
+		"  -o, --output FILE      write results to FILE instead of stdout\n"
+		"  -t, --threads N        worker threads for loading and operations over the whole base\n"
+		"  -q, --quiet            don't print the time breakdown\n"
+		"  -p, --profile          print calls, terms, allocations and time of every core operation\n"
+		"      --trace FILE       write spans of core operations to FILE as Chrome trace JSON\n"
+		"                         (both need a build with CORE_PROFILING defined)\n"
+		"Operations, indexes start from 1, 'all' means every polynomial:\n"
+		"  add I J       appends the sum\n"
+		"  mul I J       appends the product\n"
+		"  mullow I J D  appends the product without terms above degree D\n"
+		"  pcoeff I J D  coefficient at degree D of the product, the product itself isn't computed\n"
+		"  div I J       appends the quotient and the remainder\n"
+		"  gcd I J       appends the greatest common divisor\n"
+		"  compose F G M appends F(G) modulo M\n"
+		"  meval I X...  values at every X, fast for many points\n"
+		"  interp X Y... appends the polynomial through points (X, Y), if its coefficients are integers\n"
+		"  der I|all N   appends the N-th derivative\n"
+		"  int I N       N-th antiderivative with rational coefficients\n"
+		"  defint I A B  integral from A to B, A and B can be fractions like 1/2\n"
+		"  roots I|all   integer roots with multiplicities\n"
+		"  coeff I D     coefficient at degree D\n"
+		"  eval I|all X  value at X, X with a '.' is evaluated in doubles\n"
+		"  print I|all   prints polynomials\n"
+		"  load FILE     appends polynomials from .pln or .plnb\n"
+		"  save FILE     saves the base as .pln or .plnb\n"
+		"  undo, redo    reverts or repeats the last change of the base, loads included\n"
+		"Polynomials in several variables are a separate list, .pln lines with several variables go there:\n"
+		"  madd I J      appends the sum\n"
+		"  mmul I J      appends the product\n"
+		"  mder I V N    appends the N-th derivative by variable V\n"
+		"  mevalv I X... value with X for every variable, in alphabetical order\n"
+		"  mprint I|all  prints polynomials\n";
+}
+
+static bool EndsWith(const std::string & str, const std::string & suffix) {
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+class Driver {
+private:
+	using Coeff = Core::Polynomial::Coefficient;
+	Core::Base base;
+	Core::ThreadPool & pool;
+	std::ostream & out;
+	struct Timing {
+		uint32_t count = 0;
+		double total = 0;
+	};
+	std::vector<std::pair<std::string, double>> history;
+	std::map<std::string, Timing> totals;
+
+	uint32_t ParseIndex(const std::string & token, uint32_t size) const {
+		char *end = nullptr;
+		unsigned long long value = std::strtoull(token.c_str(), &end, 10);
+		if (token.empty() || *end || !value || value > size)
+			throw std::out_of_range("Index " + token + " is out of bounds");
+		return (uint32_t) value - 1;
+	}
+	uint32_t ParseIndex(const std::string & token) const {
+		return ParseIndex(token, base.Size());
+	}
+	uint32_t ParseMultivariateIndex(const std::string & token) const {
+		return ParseIndex(token, base.MultivariateSize());
+	}
+	static uint32_t ParseNumber(const std::string & token) {
+		char *end = nullptr;
+		unsigned long long value = std::strtoull(token.c_str(), &end, 10);
+		if (token.empty() || *end || value > UINT32_MAX)
+			throw std::invalid_argument("Expected a number, got '" + token + "'");
+		return (uint32_t) value;
+	}
+	static uint64_t ParseDegree(const std::string & token) {
+		char *end = nullptr;
+		errno = 0;
+		unsigned long long value = std::strtoull(token.c_str(), &end, 10);
+		if (token.empty() || !std::isdigit((unsigned char) token[0]) || *end || errno)
+			throw std::invalid_argument("Expected a degree, got '" + token + "'");
+		return (uint64_t) value;
+	}
+	static Coeff ParseCoefficient(const std::string & token) {
+		char *end = nullptr;
+		errno = 0;
+		long long value = std::strtoll(token.c_str(), &end, 10);
+		if (token.empty() || *end || errno || value < INT32_MIN || value > INT32_MAX)
+			throw std::invalid_argument("Expected a coefficient, got '" + token + "'");
+		return (Coeff) value;
+	}
+	// A or A/B
+	static Core::Rational ParseRational(const std::string & token) {
+		size_t slash = token.find('/');
+		if (slash == std::string::npos)
+			return Core::Rational(Core::BigInt((int64_t) ParseCoefficient(token)));
+		Coeff denominator = ParseCoefficient(token.substr(slash + 1));
+		if (!denominator)
+			throw std::invalid_argument("Zero denominator in '" + token + "'");
+		return Core::Rational(Core::BigInt((int64_t) ParseCoefficient(token.substr(0, slash))), Core::BigInt((int64_t) denominator));
+	}
+	void Print(uint32_t index) {
+		out << index + 1 << ". " << base.GetPolynomial(index).ExportAsString() << '\n';
+	}
+	void Append(Core::Polynomial && p) {
+		base.AddPolynomial(std::move(p));
+		Print(base.Size() - 1);
+	}
+	void PrintMultivariate(uint32_t index) {
+		out << index + 1 << ". " << base.GetMultivariatePolynomial(index).ExportAsString() << '\n';
+	}
+	void AppendMultivariate(Core::MultivariatePolynomial && p) {
+		base.AddMultivariatePolynomial(std::move(p));
+		PrintMultivariate(base.MultivariateSize() - 1);
+	}
+	void PrintRoots(uint32_t index, const std::vector<Core::IntegerRoot> & roots) {
+		out << index + 1 << ": ";
+		for (uint32_t i = 0; i < roots.size(); ++i) {
+			out << roots[i].value;
+			if (roots[i].multiplicity > 1)
+				out << " (x" << roots[i].multiplicity << ")";
+			if (i + 1 < roots.size())
+				out << ", ";
+		}
+		out << '\n';
+	}
+	template<typename T>
+	void Evaluate(const std::string & target, T x) {
+		if (target == "all") {
+			std::vector<T> values = base.EvaluateAllAt(x, pool);
+			for (uint32_t i = 0; i < values.size(); ++i)
+				out << i + 1 << ": " << values[i] << '\n';
+		} else {
+			out << base.GetPolynomial(ParseIndex(target)).Evaluate(x) << '\n';
+		}
+	}
+
+public:
+	Driver(Core::ThreadPool & pool, std::ostream & out): pool(pool), out(out) {}
+
+	void Load(const std::string & path) {
+		if (path == "-") {
+			uint32_t rejected = base.LoadFromStream(std::cin);
+			if (rejected)
+				std::cerr << "stdin: " << rejected << " lines rejected" << std::endl;
+			return;
+		}
+		if (EndsWith(path, ".plnb")) {
+			std::ifstream input(path, std::ios::binary);
+			Core::BinaryFormat::Error error = input ? base.LoadFromBinary(input) : Core::BinaryFormat::CANT_OPEN;
+			if (error != Core::BinaryFormat::OK)
+				throw std::runtime_error("Couldn't load " + path + ", error " + std::to_string((int) error));
+			return;
+		}
+		Core::LoadReport report = base.LoadFromFile(path, pool);
+		if (!report.opened)
+			throw std::runtime_error("Couldn't open " + path);
+		for (const Core::LoadError & error : report.errors)
+			std::cerr << path << ':' << error.line << ':' << error.position + 1 << ": error " << (int) error.error << std::endl;
+		if (report.multivariate)
+			std::cerr << path << ": " << report.multivariate << " multivariate polynomials" << std::endl;
+	}
+	void Save(const std::string & path) {
+		if (EndsWith(path, ".plnb")) {
+			std::ofstream output(path, std::ios::binary);
+			base.SaveToBinary(output);
+		} else {
+			std::ofstream output(path);
+			base.SaveToStream(output);
+		}
+	}
+	void Execute(const std::vector<std::string> & args) {
+		const std::string & op = args[0];
+		auto expect = [&args, &op](size_t count) {
+			if (args.size() != count + 1)
+				throw std::invalid_argument(op + " expects " + std::to_string(count) + " arguments");
+		};
+		if (op == "add" || op == "mul") {
+			expect(2);
+			uint32_t lhs = ParseIndex(args[1]), rhs = ParseIndex(args[2]);
+			Append(op == "add" ? base.AddPolynomials(lhs, rhs) : base.MultiplyPolynomials(lhs, rhs));
+		} else if (op == "mullow") {
+			expect(3);
+			Append(base.MultiplyPolynomialsTruncated(ParseIndex(args[1]), ParseIndex(args[2]), ParseDegree(args[3])));
+		} else if (op == "pcoeff") {
+			expect(3);
+			out << Core::CoefficientToString(base.GetCoefficientOfProduct(ParseIndex(args[1]), ParseIndex(args[2]), ParseDegree(args[3]))) << '\n';
+		} else if (op == "div") {
+			expect(2);
+			std::pair<Core::Polynomial, Core::Polynomial> result = base.DividePolynomials(ParseIndex(args[1]), ParseIndex(args[2]));
+			Append(std::move(result.first));
+			Append(std::move(result.second));
+		} else if (op == "gcd") {
+			expect(2);
+			Append(base.GcdOfPolynomials(ParseIndex(args[1]), ParseIndex(args[2])));
+		} else if (op == "compose") {
+			expect(3);
+			Append(base.ComposePolynomials(ParseIndex(args[1]), ParseIndex(args[2]), ParseIndex(args[3])));
+		} else if (op == "meval") {
+			if (args.size() < 3)
+				throw std::invalid_argument(op + " expects an index and points");
+			std::vector<Coeff> points;
+			for (size_t i = 2; i < args.size(); ++i)
+				points.push_back(ParseCoefficient(args[i]));
+			std::vector<Coeff> values = base.EvaluatePolynomialAt(ParseIndex(args[1]), points);
+			for (size_t i = 0; i < values.size(); ++i)
+				out << Core::CoefficientToString(values[i]) << (i + 1 < values.size() ? ' ' : '\n');
+		} else if (op == "interp") {
+			if (args.size() < 3 || args.size() % 2 == 0)
+				throw std::invalid_argument(op + " expects pairs of a point and a value");
+			std::vector<Coeff> points, values;
+			for (size_t i = 1; i < args.size(); i += 2) {
+				points.push_back(ParseCoefficient(args[i]));
+				values.push_back(ParseCoefficient(args[i + 1]));
+			}
+			Append(base.InterpolatePolynomial(points, values));
+		} else if (op == "der") {
+			expect(2);
+			uint32_t n = ParseNumber(args[2]);
+			if (args[1] == "all") {
+				for (Core::Polynomial & p : base.GetAllDerivatives(n, pool))
+					Append(std::move(p));
+			} else {
+				Append(base.GetDerivative(ParseIndex(args[1]), n));
+			}
+		} else if (op == "int") {
+			expect(2);
+			out << base.GetIntegral(ParseIndex(args[1]), ParseNumber(args[2])).ExportAsString() << '\n';
+		} else if (op == "defint") {
+			expect(3);
+			out << Core::CoefficientToString(base.GetDefiniteIntegral(ParseIndex(args[1]), ParseRational(args[2]), ParseRational(args[3]))) << '\n';
+		} else if (op == "roots") {
+			expect(1);
+			if (args[1] == "all") {
+				std::vector<std::vector<Core::IntegerRoot>> roots(base.Size());
+				pool.ParallelFor(base.Size(), [this, &roots](uint32_t i) {
+					roots[i] = base.GetIntegerRootsWithMultiplicity(i);
+				});
+				for (uint32_t i = 0; i < roots.size(); ++i)
+					PrintRoots(i, roots[i]);
+			} else {
+				uint32_t index = ParseIndex(args[1]);
+				PrintRoots(index, base.GetIntegerRootsWithMultiplicity(index));
+			}
+		} else if (op == "coeff") {
+			expect(2);
+			out << Core::CoefficientToString(base.GetPolynomial(ParseIndex(args[1])).GetCoefficient(ParseDegree(args[2]))) << '\n';
+		} else if (op == "eval") {
+			expect(2);
+			if (args[2].find('.') != std::string::npos)
+				Evaluate(args[1], std::stod(args[2]));
+			else
+				Evaluate(args[1], (int64_t) std::stoll(args[2]));
+		} else if (op == "print") {
+			expect(1);
+			if (args[1] == "all") {
+				for (uint32_t i = 0; i < base.Size(); ++i)
+					Print(i);
+			} else {
+				Print(ParseIndex(args[1]));
+			}
+		} else if (op == "madd" || op == "mmul") {
+			expect(2);
+			uint32_t lhs = ParseMultivariateIndex(args[1]), rhs = ParseMultivariateIndex(args[2]);
+			AppendMultivariate(op == "madd" ? base.AddMultivariatePolynomials(lhs, rhs) : base.MultiplyMultivariatePolynomials(lhs, rhs));
+		} else if (op == "mder") {
+			expect(3);
+			if (args[2].size() != 1)
+				throw std::invalid_argument("Expected a variable, got '" + args[2] + "'");
+			AppendMultivariate(base.GetPartialDerivative(ParseMultivariateIndex(args[1]), args[2][0], ParseNumber(args[3])));
+		} else if (op == "mevalv") {
+			if (args.size() < 2)
+				throw std::invalid_argument(op + " expects an index and values");
+			std::vector<int64_t> values;
+			for (size_t i = 2; i < args.size(); ++i)
+				values.push_back((int64_t) ParseCoefficient(args[i]));
+			out << base.GetMultivariatePolynomial(ParseMultivariateIndex(args[1])).Evaluate(values) << '\n';
+		} else if (op == "mprint") {
+			expect(1);
+			if (args[1] == "all") {
+				for (uint32_t i = 0; i < base.MultivariateSize(); ++i)
+					PrintMultivariate(i);
+			} else {
+				PrintMultivariate(ParseMultivariateIndex(args[1]));
+			}
+		} else if (op == "load") {
+			expect(1);
+			Load(args[1]);
+		} else if (op == "save") {
+			expect(1);
+			Save(args[1]);
+		} else if (op == "undo" || op == "redo") {
+			expect(0);
+			if (op == "undo" ? base.Undo() : base.Redo())
+				out << base.Size() << " polynomials, " << base.MultivariateSize() << " multivariate\n";
+			else
+				out << "nothing to " << op << '\n';
+		} else {
+			throw std::invalid_argument("Unknown operation '" + op + "'");
+		}
+	}
+	// Runs line and records its time, returns false if it failed
+	bool Run(const std::string & line) {
+		std::istringstream tokens(line);
+		std::vector<std::string> args;
+		for (std::string token; tokens >> token;)
+			args.push_back(token);
+		if (args.empty() || args[0][0] == '#') return true;
+		auto start = std::chrono::steady_clock::now();
+		bool ok = true;
+		try {
+			Execute(args);
+		} catch (const std::exception & e) {
+			std::cerr << "error: " << line << ": " << e.what() << std::endl;
+			ok = false;
+		}
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		history.emplace_back(line, elapsed);
+		Timing & total = totals[args[0]];
+		++total.count;
+		total.total += elapsed;
+		return ok;
+	}
+	void ReportTimes(std::ostream & report) const {
+		report << "time breakdown, ms:\n";
+		for (const auto & entry : history)
+			report << "  " << entry.second << "\t" << entry.first << '\n';
+		for (const auto & entry : totals)
+			report << "  " << entry.first << ": " << entry.second.count << " runs, " << entry.second.total << " total\n";
+	}
+};
+
+int main(int argc, char *argv[]) {
+	std::vector<std::string> inputs;
+	// Operations and scripts run in command line order, true marks a script
+	std::vector<std::pair<bool, std::string>> steps;
+	std::string output_path;
+	uint32_t threads = 0;
+	bool quiet = false, profile = false;
+	std::string trace_path;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) {
+				std::cerr << arg << " needs a value" << std::endl;
+				std::exit(2);
+			}
+			return argv[++i];
+		};
+		if (arg == "-e" || arg == "--exec") steps.emplace_back(false, value());
+		else if (arg == "-s" || arg == "--script") steps.emplace_back(true, value());
+		else if (arg == "-o" || arg == "--output") output_path = value();
+		else if (arg == "-t" || arg == "--threads") threads = (uint32_t) std::atoi(value().c_str());
+		else if (arg == "-q" || arg == "--quiet") quiet = true;
+		else if (arg == "-p" || arg == "--profile") profile = true;
+		else if (arg == "--trace") trace_path = value();
+		else if (arg == "-h" || arg == "--help") {
+			Usage();
+			return 0;
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			std::cerr << "Unknown option " << arg << std::endl;
+			Usage();
+			return 2;
+		} else inputs.push_back(arg);
+	}
+	if (steps.empty()) {
+		Usage();
+		return 2;
+	}
+	std::ofstream file;
+	if (!output_path.empty()) {
+		file.open(output_path);
+		if (!file) {
+			std::cerr << "Couldn't open " << output_path << std::endl;
+			return 1;
+		}
+	}
+	if ((profile || !trace_path.empty()) && !Core::PROFILING)
+		std::cerr << "warning: built without CORE_PROFILING, there's nothing to profile" << std::endl;
+	Core::Profiler::Instance().SetTracing(!trace_path.empty());
+	Core::ThreadPool pool(threads);
+	Driver driver(pool, output_path.empty() ? std::cout : file);
+	bool ok = true;
+	for (const std::string & input : inputs)
+		ok &= driver.Run("load " + input);
+	for (const auto & step : steps) {
+		if (!step.first) {
+			ok &= driver.Run(step.second);
+			continue;
+		}
+		const std::string & script = step.second;
+		std::ifstream script_file;
+		if (script != "-") {
+			script_file.open(script);
+			if (!script_file) {
+				std::cerr << "Couldn't open " << script << std::endl;
+				return 1;
+			}
+		}
+		std::istream & lines = script == "-" ? std::cin : script_file;
+		for (std::string line; std::getline(lines, line);)
+			ok &= driver.Run(line);
+	}
+	if (!quiet)
+		driver.ReportTimes(std::cerr);
+	if (profile)
+		Core::Profiler::Instance().WriteReport(std::cerr);
+	if (!trace_path.empty()) {
+		std::ofstream trace(trace_path);
+		if (!trace) {
+			std::cerr << "Couldn't open " << trace_path << std::endl;
+			return 1;
+		}
+		Core::Profiler::Instance().WriteChromeTrace(trace);
+	}
+	return ok ? 0 : 1;
+}
@@ -5,11 +5,38 @@
 #include <vector>
 #include <cctype>
 #include <string>
+#include <string_view>
+#include <array>
 #include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <numeric>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <map>
+#include <iterator>
+#include <fstream>
+#include <chrono>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
 namespace Core {
 	template<typename T>
-	T Binpow(T a, int p) {
+	T Binpow(T a, uint64_t p) {
 		T result = 1;
 		while (p) {
 			if (p & 1) result *= a;
@@ -18,30 +45,474 @@ namespace Core {
 		}
 		return result;
 	}
+	// Powers of one base: x^(2^k) are squared once and shared between exponents,
+	// every power up to max_exponent then costs one multiplication per set bit
+	template<typename T>
+	class PowerTable {
+	private:
+		std::vector<T> squares;
+	public:
+		PowerTable(T x, uint64_t max_exponent) {
+			squares.push_back(std::move(x));
+			for (max_exponent >>= 1; max_exponent; max_exponent >>= 1)
+				squares.push_back(squares.back() * squares.back());
+		}
+		T Power(uint64_t p) const {
+			if (!p) return T(1);
+			uint32_t k = (uint32_t) __builtin_ctzll(p);
+			T result = squares[k];
+			for (p >>= k + 1, ++k; p; p >>= 1, ++k)
+				if (p & 1) result *= squares[k];
+			return result;
+		}
+	};
+
+	// Cooperative cancellation. Long computations call CheckCancellation now and then,
+	// it throws OperationCancelled if the token installed on this thread was cancelled
+	class OperationCancelled : public std::runtime_error {
+	public:
+		OperationCancelled(): std::runtime_error("Operation was cancelled") {}
+	};
+	class CancellationToken {
+	private:
+		std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+	public:
+		// Copies share the flag
+		void Cancel() const {
+			cancelled->store(true, std::memory_order_relaxed);
+		}
+		bool IsCancelled() const {
+			return cancelled->load(std::memory_order_relaxed);
+		}
+	};
+	inline const CancellationToken*& CurrentCancellation() {
+		thread_local const CancellationToken *current = nullptr;
+		return current;
+	}
+	inline void CheckCancellation() {
+		const CancellationToken *token = CurrentCancellation();
+		if (token && token->IsCancelled())
+			throw OperationCancelled();
+	}
+	// Installs token for the current thread until the scope ends, token has to outlive the scope
+	class CancellationScope {
+	private:
+		const CancellationToken *previous;
+	public:
+		explicit CancellationScope(const CancellationToken * token): previous(CurrentCancellation()) {
+			CurrentCancellation() = token;
+		}
+		explicit CancellationScope(const CancellationToken & token): CancellationScope(&token) {}
+		CancellationScope(const CancellationScope &) = delete;
+		CancellationScope& operator=(const CancellationScope &) = delete;
+		~CancellationScope() {
+			CurrentCancellation() = previous;
+		}
+	};
+
+	// Per-operation counters and trace spans, compiled in only with CORE_PROFILING defined.
+	// Without it CORE_PROFILE and friends expand to nothing and Profiler reports zeros, so callers need no #ifdefs.
+	// Time is inclusive, a multiplication inside a division counts for both
+#ifdef CORE_PROFILING
+	static constexpr bool PROFILING = true;
+#define CORE_PROFILE(operation, terms) ::Core::ProfileScope core_profile_scope(::Core::ProfiledOperation::operation, (uint64_t) (terms))
+#define CORE_PROFILE_ALLOCATION() ::Core::Profiler::Instance().CountAllocation()
+#define CORE_PROFILE_CACHE_HIT(operation) ::Core::Profiler::Instance().CountCacheHit(operation)
+#else
+	static constexpr bool PROFILING = false;
+#define CORE_PROFILE(operation, terms) ((void) 0)
+#define CORE_PROFILE_ALLOCATION() ((void) 0)
+#define CORE_PROFILE_CACHE_HIT(operation) ((void) 0)
+#endif
+	enum class ProfiledOperation : uint8_t {
+		PARSE, ADD, MULTIPLY, MULTIPLY_TRUNCATED, COEFFICIENT_OF_PRODUCT, DIVIDE, GCD, COMPOSE, DERIVATIVE, INTEGRAL,
+		EVALUATE, INTERPOLATE, INTEGER_ROOTS, REAL_ROOTS, LOAD, SAVE,
+		MULTIVARIATE_PARSE, MULTIVARIATE_ADD, MULTIVARIATE_MULTIPLY, MULTIVARIATE_DERIVATIVE,
+		COUNT
+	};
+	struct OperationStats {
+		uint64_t calls = 0;
+		// Size of the input of every call: terms of the operands (times points for evaluation), bytes for parsing
+		// and loading, polynomials for saving
+		uint64_t terms = 0;
+		// Term storage allocations, copies on write included
+		uint64_t allocations = 0;
+		uint64_t nanoseconds = 0;
+		// Results the base took from its cache, these aren't calls
+		uint64_t cache_hits = 0;
+	};
+	// Span of one call, nanoseconds since the profiler was created
+	struct TraceEvent {
+		ProfiledOperation operation;
+		uint32_t thread;
+		uint64_t terms;
+		uint64_t start;
+		uint64_t duration;
+	};
+	class Profiler {
+	public:
+		static constexpr uint32_t OPERATIONS = (uint32_t) ProfiledOperation::COUNT;
+		// Spans kept per thread while tracing, later ones are dropped
+		static constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+	private:
+		// Counters only have one writer, their thread, so counting is a load and a store to a line nobody else writes
+		struct Counter {
+			std::atomic<uint64_t> value{ 0 };
+			void Add(uint64_t x) {
+				value.store(value.load(std::memory_order_relaxed) + x, std::memory_order_relaxed);
+			}
+			uint64_t Get() const {
+				return value.load(std::memory_order_relaxed);
+			}
+		};
+		struct Counters {
+			Counter calls, terms, allocations, nanoseconds, cache_hits;
+		};
+		// Slots outlive their threads, the stats are sums over all of them
+		struct ThreadSlot {
+			uint32_t thread;
+			std::array<Counters, OPERATIONS> counters;
+			std::mutex events_mutex;
+			std::vector<TraceEvent> events;
+		};
+		mutable std::mutex thread_slots_mutex;
+		std::vector<std::shared_ptr<ThreadSlot>> thread_slots;
+		std::atomic<bool> tracing{ false };
+		const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+		Profiler() {}
+		ThreadSlot & Slot() {
+			thread_local std::shared_ptr<ThreadSlot> slot;
+			if (!slot) {
+				slot = std::make_shared<ThreadSlot>();
+				std::lock_guard<std::mutex> lock(thread_slots_mutex);
+				slot->thread = (uint32_t) thread_slots.size() + 1;
+				thread_slots.push_back(slot);
+			}
+			return *slot;
+		}
+		std::vector<std::shared_ptr<ThreadSlot>> Slots() const {
+			std::lock_guard<std::mutex> lock(thread_slots_mutex);
+			return thread_slots;
+		}
+		static void WriteMicroseconds(std::ostream & output, uint64_t nanoseconds) {
+			std::string fraction = std::to_string(nanoseconds % 1000);
+			output << nanoseconds / 1000 << '.' << std::string(3 - fraction.size(), '0') << fraction;
+		}
+	public:
+		Profiler(const Profiler &) = delete;
+		Profiler& operator=(const Profiler &) = delete;
+		static Profiler & Instance() {
+			static Profiler profiler;
+			return profiler;
+		}
+		static const char* Name(ProfiledOperation operation) {
+			static constexpr const char *NAMES[OPERATIONS] = {
+				"Parse", "Add", "Multiply", "MultiplyTruncated", "CoefficientOfProduct", "Divide", "Gcd", "ComposeModulo",
+				"Derivative", "Integral", "Evaluate", "Interpolate", "IntegerRoots", "RealRoots", "Load", "Save",
+				"MultivariateParse", "MultivariateAdd", "MultivariateMultiply", "MultivariateDerivative"
+			};
+			return operation < ProfiledOperation::COUNT ? NAMES[(uint32_t) operation] : "Unknown";
+		}
+		// Innermost operation running on this thread, COUNT if there's none
+		static ProfiledOperation & CurrentOperation() {
+			thread_local ProfiledOperation current = ProfiledOperation::COUNT;
+			return current;
+		}
+		std::chrono::steady_clock::time_point Epoch() const {
+			return epoch;
+		}
+		void Record(ProfiledOperation operation, uint64_t terms, std::chrono::steady_clock::time_point start,
+			std::chrono::steady_clock::time_point end) {
+			ThreadSlot & slot = Slot();
+			Counters & counters = slot.counters[(uint32_t) operation];
+			uint64_t duration = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+			counters.calls.Add(1);
+			counters.terms.Add(terms);
+			counters.nanoseconds.Add(duration);
+			if (!tracing.load(std::memory_order_relaxed)) return;
+			std::lock_guard<std::mutex> lock(slot.events_mutex);
+			if (slot.events.size() < MAX_EVENTS_PER_THREAD)
+				slot.events.push_back(TraceEvent{ operation, slot.thread, terms,
+					(uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count(), duration });
+		}
+		// Counted for the innermost operation, allocations outside of any are ignored
+		void CountAllocation() {
+			ProfiledOperation operation = CurrentOperation();
+			if (operation != ProfiledOperation::COUNT)
+				Slot().counters[(uint32_t) operation].allocations.Add(1);
+		}
+		void CountCacheHit(ProfiledOperation operation) {
+			Slot().counters[(uint32_t) operation].cache_hits.Add(1);
+		}
+		std::array<OperationStats, OPERATIONS> Stats() const {
+			std::array<OperationStats, OPERATIONS> result{};
+			for (const std::shared_ptr<ThreadSlot> & slot : Slots())
+				for (uint32_t i = 0; i < OPERATIONS; ++i) {
+					const Counters & counters = slot->counters[i];
+					result[i].calls += counters.calls.Get();
+					result[i].terms += counters.terms.Get();
+					result[i].allocations += counters.allocations.Get();
+					result[i].nanoseconds += counters.nanoseconds.Get();
+					result[i].cache_hits += counters.cache_hits.Get();
+				}
+			return result;
+		}
+		// Counts of operations running meanwhile may survive partially
+		void Reset() {
+			for (const std::shared_ptr<ThreadSlot> & slot : Slots()) {
+				for (Counters & counters : slot->counters)
+					for (Counter *counter : { &counters.calls, &counters.terms, &counters.allocations, &counters.nanoseconds, &counters.cache_hits })
+						counter->value.store(0, std::memory_order_relaxed);
+				std::lock_guard<std::mutex> lock(slot->events_mutex);
+				slot->events.clear();
+			}
+		}
+		// Spans are only kept while tracing is on
+		void SetTracing(bool enabled) {
+			tracing.store(enabled, std::memory_order_relaxed);
+		}
+		bool Tracing() const {
+			return tracing.load(std::memory_order_relaxed);
+		}
+		std::vector<TraceEvent> Events() const {
+			std::vector<TraceEvent> result;
+			for (const std::shared_ptr<ThreadSlot> & slot : Slots()) {
+				std::lock_guard<std::mutex> lock(slot->events_mutex);
+				result.insert(result.end(), slot->events.begin(), slot->events.end());
+			}
+			std::sort(result.begin(), result.end(), [](const TraceEvent & l, const TraceEvent & r) {
+				return l.start < r.start;
+			});
+			return result;
+		}
+		// Trace Event Format, opens in chrome://tracing or Perfetto
+		void WriteChromeTrace(std::ostream & output) const {
+			output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+			bool first = true;
+			for (const TraceEvent & event : Events()) {
+				output << (first ? "\n" : ",\n") << "{\"name\":\"" << Name(event.operation) << "\",\"cat\":\"core\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+					<< event.thread << ",\"ts\":";
+				WriteMicroseconds(output, event.start);
+				output << ",\"dur\":";
+				WriteMicroseconds(output, event.duration);
+				output << ",\"args\":{\"terms\":" << event.terms << "}}";
+				first = false;
+			}
+			output << "\n]}\n";
+		}
+		// Table of the operations that ran
+		void WriteReport(std::ostream & output) const {
+			if (!PROFILING) {
+				output << "profiling is off, build with CORE_PROFILING defined\n";
+				return;
+			}
+			std::array<OperationStats, OPERATIONS> stats = Stats();
+			output << "operation\tcalls\tterms\tallocations\tms\tcache hits\n";
+			for (uint32_t i = 0; i < OPERATIONS; ++i) {
+				if (!stats[i].calls && !stats[i].cache_hits) continue;
+				output << Name((ProfiledOperation) i) << '\t' << stats[i].calls << '\t' << stats[i].terms << '\t'
+					<< stats[i].allocations << '\t' << (double) stats[i].nanoseconds / 1e6 << '\t' << stats[i].cache_hits << '\n';
+			}
+		}
+	};
+	// Times the enclosing block as one call of operation, use it through CORE_PROFILE
+	class ProfileScope {
+	private:
+		ProfiledOperation operation, previous;
+		uint64_t terms;
+		std::chrono::steady_clock::time_point start;
+	public:
+		ProfileScope(ProfiledOperation operation, uint64_t terms)
+			: operation(operation), previous(Profiler::CurrentOperation()), terms(terms), start(std::chrono::steady_clock::now()) {
+			Profiler::CurrentOperation() = operation;
+		}
+		ProfileScope(const ProfileScope &) = delete;
+		ProfileScope& operator=(const ProfileScope &) = delete;
+		~ProfileScope() {
+			Profiler::CurrentOperation() = previous;
+			Profiler::Instance().Record(operation, terms, start, std::chrono::steady_clock::now());
+		}
+	};
 
 	template<typename T>
+	struct ListNode {
+		T data;
+		ListNode *next;
+		ListNode *prev;
+	};
+
+	// Hands out nodes from contiguous slabs with a free list on top
+	// Release drops every slab at once, so nodes must already be destroyed (or trivially destructible)
+	template<typename Node>
+	class NodePool {
+		union Slot {
+			Slot *next_free;
+			Node node;
+			Slot() {}
+			~Slot() {}
+		};
+		static constexpr uint32_t FIRST_SLAB = 16, MAX_SLAB = 4096;
+
+		std::vector<std::unique_ptr<Slot[]>> slabs;
+		Slot *free_head = nullptr, *free_tail = nullptr;
+		Slot *bump = nullptr, *bump_end = nullptr;
+		uint32_t next_slab = FIRST_SLAB;
+
+		void Reset() {
+			free_head = free_tail = nullptr;
+			bump = bump_end = nullptr;
+			next_slab = FIRST_SLAB;
+		}
+
+	public:
+		static constexpr bool BULK_RELEASE = true;
+
+		NodePool() = default;
+		NodePool(const NodePool &) = delete;
+		NodePool& operator=(const NodePool &) = delete;
+		NodePool(NodePool && other) noexcept {
+			*this = std::move(other);
+		}
+		NodePool& operator=(NodePool && other) noexcept {
+			if (this == &other) return *this;
+			slabs = std::move(other.slabs);
+			free_head = other.free_head;
+			free_tail = other.free_tail;
+			bump = other.bump;
+			bump_end = other.bump_end;
+			next_slab = other.next_slab;
+			other.slabs.clear();
+			other.Reset();
+			return *this;
+		}
+		// Returns raw memory for a node, constructing it is up to the caller
+		Node* Allocate() {
+			Slot *slot;
+			if (free_head) {
+				slot = free_head;
+				free_head = slot->next_free;
+				if (!free_head) free_tail = nullptr;
+			} else {
+				if (bump == bump_end) {
+					slabs.emplace_back(new Slot[next_slab]);
+					bump = slabs.back().get();
+					bump_end = bump + next_slab;
+					next_slab = std::min(next_slab * 2, MAX_SLAB);
+				}
+				slot = bump++;
+			}
+			return &slot->node;
+		}
+		void Deallocate(Node *node) {
+			Slot *slot = reinterpret_cast<Slot*>(node);
+			slot->next_free = free_head;
+			free_head = slot;
+			if (!free_tail) free_tail = slot;
+		}
+		void Release() {
+			slabs.clear();
+			Reset();
+		}
+		// Takes over every slab of other, nodes allocated there stay valid and become ours
+		void Absorb(NodePool & other) {
+			if (this == &other) return;
+			for (auto & slab : other.slabs)
+				slabs.push_back(std::move(slab));
+			if (other.free_head) {
+				if (free_tail)
+					free_tail->next_free = other.free_head;
+				else
+					free_head = other.free_head;
+				free_tail = other.free_tail;
+			}
+			// Unused tail of other's current slab is lost until Release, that's fine
+			other.slabs.clear();
+			other.Reset();
+		}
+	};
+
+	// Plain new/delete for every node, for when nodes have to outlive the list
+	template<typename Node>
+	class HeapNodeAllocator {
+	public:
+		static constexpr bool BULK_RELEASE = false;
+
+		Node* Allocate() {
+			return static_cast<Node*>(::operator new(sizeof(Node)));
+		}
+		void Deallocate(Node *node) {
+			::operator delete(node);
+		}
+		void Release() {}
+		void Absorb(HeapNodeAllocator &) {}
+	};
+
+	template<typename T, typename Allocator = NodePool<ListNode<T>>>
 	class List {
 	public:
-		struct Node {
-			T data;
-			Node *next;
-			Node *prev;
-		};
+		using Node = ListNode<T>;
 
 	private:
 		uint32_t size = 0;
 		Node *head = nullptr, *tail = nullptr;
+		Allocator allocator;
+
+		template<typename... Args>
+		Node* MakeNode(Args&&... args) {
+			Node *memory = allocator.Allocate();
+			try {
+				return new (memory) Node{ T(std::forward<Args>(args)...), nullptr, nullptr };
+			} catch (...) {
+				allocator.Deallocate(memory);
+				throw;
+			}
+		}
+		void FreeNode(Node *node) {
+			node->~Node();
+			allocator.Deallocate(node);
+		}
+		// Links a detached node before position, nullptr position means at the end
+		void Link(Node *position, Node *new_node) {
+			new_node->next = position;
+			new_node->prev = position ? position->prev : tail;
+			if (new_node->prev)
+				new_node->prev->next = new_node;
+			else
+				head = new_node;
+			if (position)
+				position->prev = new_node;
+			else
+				tail = new_node;
+			size++;
+		}
+		// Detaches node without deleting it
+		void Unlink(Node *node) {
+			if (node->prev)
+				node->prev->next = node->next;
+			else
+				head = node->next;
+			if (node->next)
+				node->next->prev = node->prev;
+			else
+				tail = node->prev;
+			node->next = node->prev = nullptr;
+			size--;
+		}
 
 	public:
 		List() = default;
-		List(const List<T> & other) {
-			Clear();
+		List(const List & other) {
 			Node* current = other.head;
 			while (current) {
 				InsertBack(current->data);
 				current = current->next;
 			}
 		}
+		List(List && other) noexcept: size(other.size), head(other.head), tail(other.tail), allocator(std::move(other.allocator)) {
+			other.size = 0;
+			other.head = other.tail = nullptr;
+		}
 		~List() {
 			Clear();
 		}
@@ -57,7 +528,8 @@ namespace Core {
 		Node* Tail() const {
 			return tail;
 		}
-		List<T>& operator=(const List<T> & other) {
+		List& operator=(const List & other) {
+			if (this == &other) return *this;
 			Clear();
 			Node* current = other.head;
 			while (current) {
@@ -66,13 +538,29 @@ namespace Core {
 			}
 			return *this;
 		}
+		List& operator=(List && other) noexcept {
+			if (this == &other) return *this;
+			Clear();
+			allocator = std::move(other.allocator);
+			std::swap(size, other.size);
+			std::swap(head, other.head);
+			std::swap(tail, other.tail);
+			return *this;
+		}
+		// With a pooling allocator this only runs destructors (if T has any) and drops the slabs
 		void Clear() {
-			Node* current = head, *next;
-			while (current != nullptr) {
-				next = current->next;
-				delete current;
-				current = next;
+			if (!Allocator::BULK_RELEASE || !std::is_trivially_destructible<T>::value) {
+				Node* current = head, *next;
+				while (current != nullptr) {
+					next = current->next;
+					if (Allocator::BULK_RELEASE)
+						current->~Node();
+					else
+						FreeNode(current);
+					current = next;
+				}
 			}
+			allocator.Release();
 			head = nullptr;
 			tail = nullptr;
 			size = 0;
@@ -108,500 +596,6174 @@ namespace Core {
 			}
 			return cur;
 		}
+		// Emplace versions construct the element inside the node from args
+		template<typename... Args>
+		Node* EmplaceAfter(Node *node, Args&&... args) {
+			if (!node) return nullptr;
+			Node *new_node = MakeNode(std::forward<Args>(args)...);
+			Link(node->next, new_node);
+			return new_node;
+		}
+		template<typename... Args>
+		Node* EmplaceBefore(Node *node, Args&&... args) {
+			if (!node) return nullptr;
+			Node *new_node = MakeNode(std::forward<Args>(args)...);
+			Link(node, new_node);
+			return new_node;
+		}
+		template<typename... Args>
+		Node* EmplaceBack(Args&&... args) {
+			Node *new_node = MakeNode(std::forward<Args>(args)...);
+			Link(nullptr, new_node);
+			return new_node;
+		}
+		template<typename... Args>
+		Node* EmplaceFront(Args&&... args) {
+			Node *new_node = MakeNode(std::forward<Args>(args)...);
+			Link(head, new_node);
+			return new_node;
+		}
 		void InsertAfter(Node *node, const T & data) {
-			if (!node) return;
-			Node* new_node = new Node;
-			if (node == tail)
-				tail = new_node;
-			new_node->data = data;
-			new_node->next = node->next;
-			new_node->prev = node;
-			node->next = new_node;
-			if (new_node->next)
-				new_node->next->prev = new_node;
-			size++;
+			EmplaceAfter(node, data);
+		}
+		void InsertAfter(Node *node, T && data) {
+			EmplaceAfter(node, std::move(data));
 		}
 		void InsertBefore(Node *node, const T & data) {
-			if (!node) return;
-			Node* new_node = new Node;
-			if (node == head)
-				head = new_node;
-			new_node->data = data;
-			new_node->next = node;
-			new_node->prev = node->prev;
-			node->prev = new_node;
-			if (new_node->prev)
-				new_node->prev->next = new_node;
-			size++;
+			EmplaceBefore(node, data);
+		}
+		void InsertBefore(Node *node, T && data) {
+			EmplaceBefore(node, std::move(data));
 		}
 		void InsertBack(const T & data) {
-			if (Empty()) {
-				head = new Node;
-				head->data = data;
-				head->next = head->prev = nullptr;
-				tail = head;
-				size = 1;
-			} else {
-				InsertAfter(tail, data);
-			}
+			EmplaceBack(data);
+		}
+		void InsertBack(T && data) {
+			EmplaceBack(std::move(data));
 		}
 		void InsertFront(const T & data) {
-			if (Empty()) {
-				head = new Node;
-				head->data = data;
-				head->next = head->prev = nullptr;
-				tail = head;
-				size = 1;
-			} else {
-				InsertBefore(head, data);
+			EmplaceFront(data);
+		}
+		void InsertFront(T && data) {
+			EmplaceFront(std::move(data));
+		}
+		// Moves every node of other before position (nullptr means at the end) without reallocating
+		void Splice(Node *position, List & other) {
+			if (this == &other || other.Empty()) return;
+			allocator.Absorb(other.allocator);
+			Node *first = other.head, *last = other.tail;
+			first->prev = position ? position->prev : tail;
+			last->next = position;
+			if (first->prev)
+				first->prev->next = first;
+			else
+				head = first;
+			if (position)
+				position->prev = last;
+			else
+				tail = last;
+			size += other.size;
+			other.head = other.tail = nullptr;
+			other.size = 0;
+		}
+		// Moves a single node of other before position (nullptr means at the end)
+		// Nodes belong to their list's pool, so between different lists the element is moved into a new node
+		// Returns the node holding the element afterwards
+		Node* Splice(Node *position, List & other, Node *node) {
+			if (!node || node == position) return node;
+			if (this == &other) {
+				Unlink(node);
+				Link(position, node);
+				return node;
 			}
+			Node *new_node = MakeNode(std::move(node->data));
+			other.Delete(node);
+			Link(position, new_node);
+			return new_node;
 		}
 		void Delete(Node *node) {
 			if (!node) return;
-			if (node->prev)
-				node->prev->next = node->next;
-			if (node->next)
-				node->next->prev = node->prev;
-			if (node->next) {
-				if (node->prev) {
-					// deleting from somewhere in the middle, no need to do anything
-				} else {
-					// deleting head, should reassign it
-					head = node->next;
-				}
-			} else {
-				if (node->prev) {
-					// deleting tail, should reassign it
-					tail = node->prev;
-				} else {
-					// deleting the only element in the list
-					head = tail = nullptr;
-				}
-			}
-			delete node;
-			size--;
+			Unlink(node);
+			FreeNode(node);
+		}
+	};
+	// splitmix64 finalizer, spreads every input bit over the whole result
+	inline uint64_t HashMix(uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xBF58476D1CE4E5B9ull;
+		x ^= x >> 27;
+		x *= 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+	// Stable reference to an element of ChunkedSequence, stays valid while indices shift around it
+	struct Handle {
+		uint64_t id = 0;
+		bool Valid() const {
+			return id != 0;
+		}
+		bool operator==(const Handle & other) const {
+			return id == other.id;
+		}
+		bool operator!=(const Handle & other) const {
+			return id != other.id;
 		}
 	};
-	class Polynomial {
+
+	// Sequence with fast access by index and cheap insertion and deletion in the middle.
+	// Elements are kept in chunks of at most CHUNK_SIZE, offsets[i] is the index of the first element of chunk i.
+	// Access by index is a binary search over chunks, insertion and deletion move at most CHUNK_SIZE elements
+	// and update the offsets of the following chunks.
+	// Chunks are shared between copies and copied on write, so a copy costs O(Size() / CHUNK_SIZE)
+	// and changing it afterwards copies only the chunks it touches. Copies are independent versions
+	// that can be read from other threads while this one changes.
+	// Handles are found through an index from id to the slot of the chunk holding it, the index is split
+	// in INDEX_SHARDS parts that are shared and copied on write the same way
+	template<typename T>
+	class ChunkedSequence {
 	public:
-		enum ErrorType : uint8_t {
-			OK = 0,
-			UNKNOWN_CHARACTERS = 1, // 4(x^2)
-			MULTIPLE_VARIABLES = 2, // x^2 + 4y^2
-			EXPECTED_COEFFICIENT = 3, // x^2 +
-			EXPECTED_VARIABLE = 4, // 4^3
-			EXPECTED_POWER_SYMBOL = 5, // 4x3
-			EXPECTED_DEGREE = 6 // 4x^x
-		};
+		static constexpr uint32_t CHUNK_SIZE = 256;
+		static constexpr uint32_t INDEX_SHARDS = 64;
 	private:
-		struct Term {
-			uint32_t degree;
-			int32_t coeff;
-			bool operator<(const Term & other) {
-				return degree < other.degree;
-			}
-		};
-		char var;
-		// Stored as sorted
-		List<Term> list;
-		std::string string_view;
-		bool updated;
-		static constexpr uint32_t Q = 8;
-		static constexpr uint32_t Q0 = 0;
-		static constexpr uint32_t SIGMA = 5;
-		static constexpr uint32_t FA[Q][SIGMA] = {
-			{ 2, 3, Q, 1, 0 },
-			{ 2, 3, Q, Q, 1 },
-			{ 2, 3, Q, 1, 6 },
-			{ Q, Q, 4, 1, 3 },
-			{ 5, Q, Q, Q, 4 },
-			{ 5, Q, Q, 1, 7 },
-			{ Q, 3, Q, 1, 6 },
-			{ Q, Q, Q, 1, 7 }
-		};
-		static constexpr ErrorType ERROR_ON_LEAVE[Q] = {
-			OK,
-			EXPECTED_COEFFICIENT,
-			OK,
-			OK,
-			EXPECTED_DEGREE,
-			OK,
-			OK,
-			OK
-		};
-		static constexpr ErrorType ERROR_ON_FAIL[Q] = {
-			EXPECTED_COEFFICIENT,
-			EXPECTED_COEFFICIENT,
-			EXPECTED_VARIABLE,
-			EXPECTED_POWER_SYMBOL,
-			EXPECTED_DEGREE,
-			EXPECTED_COEFFICIENT,
-			EXPECTED_VARIABLE,
-			EXPECTED_COEFFICIENT
+		struct Chunk {
+			std::vector<T> items;
+			std::vector<uint64_t> ids;
+			// Stays with the chunk when it's copied, so the index doesn't change
+			uint32_t slot = 0;
 		};
-	private:
-		std::pair<ErrorType, uint32_t> CheckForErrors(const std::string & str, char & varLetter) const {
-			varLetter = '\0';
-			for (uint32_t i = 0; i < str.size(); ++i) {
-				if (std::isdigit(str[i]) || str[i] == '^' || str[i] == ' '
-					|| str[i] == '+' || str[i] == '-') continue;
-				if (!std::isalpha(str[i])) {
-					return std::make_pair(UNKNOWN_CHARACTERS, i);
-				}
-			}
-			uint32_t state = Q0;
-			for (uint32_t i = 0; i < str.size(); ++i) {
-				/* RIP Good Code. Frick QT Compiler. It rejected it...
-				CHAR_TYPES.resize(256);
-				std::fill(CHAR_TYPES.begin(), CHAR_TYPES.end(), 0);
-				for (uint32_t i = (uint32_t) '0', till = (uint32_t) '9'; i <= till; ++i)
-					CHAR_TYPES[i] = 0;
-				for (uint32_t i = (uint32_t) 'A', till = (uint32_t) 'Z'; i <= till; ++i)
-					CHAR_TYPES[i] = 1;
-				for (uint32_t i = (uint32_t) 'a', till = (uint32_t) 'z'; i <= till; ++i)
-					CHAR_TYPES[i] = 1;
-				CHAR_TYPES[(uint32_t) '^'] = 2;
-				CHAR_TYPES[(uint32_t) '+'] = CHAR_TYPES[(uint32_t) '-'] = 3;
-				CHAR_TYPES[(uint32_t) ' '] = 4;
-			*/
-				uint32_t next = 0;
-				if (std::isdigit(str[i])) next = 0;
-				else if (std::isalpha(str[i])) next = 1;
-				else if (str[i] == '^') next = 2;
-				else if (str[i] == '+' || str[i] == '-') next = 3;
-				else if (str[i] == ' ') next = 4;
-				if (FA[state][next] == Q)
-					return std::make_pair(ERROR_ON_FAIL[state], i);
-				state = FA[state][next];
-			}
-			if (ERROR_ON_LEAVE[state] != OK)
-				return std::make_pair(ERROR_ON_LEAVE[state], str.size());
-			for (uint32_t i = 0; i < str.size(); ++i) {
-				if (!std::isalpha(str[i])) continue;
-				if (varLetter == '\0')
-					varLetter = str[i];
-				else if (varLetter != str[i])
-					return std::make_pair(MULTIPLE_VARIABLES, i);
-			}
-			if (varLetter == '\0') varLetter = 'x';
-			return std::make_pair(OK, 0);
+		// (id, slot) sorted by id. New ids are the largest so far, so they go to the end
+		using IndexShard = std::vector<std::pair<uint64_t, uint32_t>>;
+		std::vector<std::shared_ptr<Chunk>> chunks;
+		std::vector<uint32_t> offsets;
+		// positions[slot] is the position of the chunk in chunks
+		std::vector<uint32_t> positions;
+		std::vector<uint32_t> free_slots;
+		// Empty until the first element
+		std::vector<std::shared_ptr<IndexShard>> index;
+		uint32_t size = 0;
+		// Ids are unique over the process, so handles stay unambiguous in copies and older versions
+		inline static std::atomic<uint64_t> next_id{ 1 };
+
+		// chunk containing index, index < size
+		uint32_t ChunkOf(uint32_t index) const {
+			return (uint32_t) (std::upper_bound(offsets.begin(), offsets.end(), index) - offsets.begin()) - 1;
 		}
-		std::string TermToString(const Term & term, bool first) const {
-			std::string result;
-			if (!first)
-				result += ' ';
-			if (!first && term.coeff > 0)
-				result += "+ ";
-			else if (term.coeff < 0)
-				result += "- ";
-			if (abs(term.coeff) != 1 || (abs(term.coeff) == 1 && term.degree == 0))
-				result += std::to_string(abs(term.coeff));
-			if (term.degree > 0)
-				result += var;
-			if (term.degree > 1)
-				result += '^' + std::to_string(term.degree);
-			return result;
+		// Also moves the slots of the chunks from position from on
+		void UpdateOffsets(uint32_t from) {
+			offsets.resize(chunks.size());
+			for (uint32_t i = from; i < chunks.size(); ++i) {
+				offsets[i] = i ? offsets[i - 1] + (uint32_t) chunks[i - 1]->items.size() : 0;
+				positions[chunks[i]->slot] = i;
+			}
 		}
-	public:
-		Polynomial(): var('x'), updated(true) {}
-		int GetCoefficient(uint32_t degree) {
-			Term temp;
-			temp.degree = degree;
-			List<Term>::Node *ptr = list.LowerBound(temp);
-			if (!ptr || ptr->data.degree != degree) return 0;
-			else return ptr->data.coeff;
+		// Chunk that only this copy sees
+		Chunk & Writable(uint32_t position) {
+			std::shared_ptr<Chunk> & chunk = chunks[position];
+			if (chunk.use_count() > 1)
+				chunk = std::make_shared<Chunk>(*chunk);
+			return *chunk;
 		}
-		void AddTerm(const Term & term) {
-			updated = true;
-			if (list.Empty()) {
-				list.InsertBack(term);
-				return;
-			}
-			List<Term>::Node* place = list.LowerBound(term);
-			if (!place) {
-				list.InsertBack(term);
-				return;
-			}
-			if (place->data.degree == term.degree) {
-				if (place->data.coeff == -term.coeff)
-					list.Delete(place);
-				else
-					place->data.coeff += term.coeff;
+		std::shared_ptr<Chunk> NewChunk() {
+			std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+			chunk->items.reserve(CHUNK_SIZE);
+			chunk->ids.reserve(CHUNK_SIZE);
+			if (free_slots.empty()) {
+				chunk->slot = (uint32_t) positions.size();
+				positions.push_back(0);
 			} else {
-				// degree is higher so we insert before
-				list.InsertBefore(place, term);
+				chunk->slot = free_slots.back();
+				free_slots.pop_back();
 			}
+			return chunk;
 		}
-		std::pair<ErrorType, uint32_t> InitFromString(const std::string & str) {
-			char varLetter;
-			std::pair<ErrorType, uint32_t> error = CheckForErrors(str, varLetter);
-			if (error.first != OK)
-				return error;
-			var = varLetter;
-			list.Clear();
-			std::string str_upd; // no spaces
-			for (char sym : str)
-				if (sym != ' ')
-					str_upd.push_back(sym);
-			uint32_t i = 0;
-			int32_t degree, coefficient;
-			while (i < str_upd.size()) {
-				bool positive = true;
-				if (str_upd[i] == '+')
-					++i;
-				else if (str_upd[i] == '-')
-					positive = false, ++i;
-				degree = 0; coefficient = 0;
-				if (std::isdigit(str_upd[i])) {
-					for (; i < str_upd.size() && std::isdigit(str_upd[i]); ++i)
-						coefficient = coefficient * 10 + ((int32_t) str_upd[i] - (int32_t) '0');
-				} else {
-					coefficient = 1;
-				}
-				if (!positive) coefficient = -coefficient;
-				if (i < str_upd.size() && std::isalpha(str_upd[i])) {
-					++i; // skipping variable letter
-					if (i < str_upd.size() && str_upd[i] == '^') {
-						++i; // skipping power symbol
-						for (; i < str_upd.size() && std::isdigit(str_upd[i]); ++i)
-							degree = degree * 10 + ((int32_t) str_upd[i] - (int32_t) '0');
-					} else {
-						degree = 1;
-					}
-				}
-				Term new_term;
-				new_term.degree = degree;
-				new_term.coeff = coefficient;
-				AddTerm(new_term);
+		const IndexShard* ShardOf(uint64_t id) const {
+			return index.empty() ? nullptr : index[HashMix(id) % INDEX_SHARDS].get();
+		}
+		IndexShard & WritableShard(uint64_t id) {
+			if (index.empty())
+				index.resize(INDEX_SHARDS);
+			std::shared_ptr<IndexShard> & shard = index[HashMix(id) % INDEX_SHARDS];
+			if (!shard)
+				shard = std::make_shared<IndexShard>();
+			else if (shard.use_count() > 1)
+				shard = std::make_shared<IndexShard>(*shard);
+			return *shard;
+		}
+		static IndexShard::iterator LowerBound(IndexShard & shard, uint64_t id) {
+			return std::lower_bound(shard.begin(), shard.end(), std::make_pair(id, (uint32_t) 0));
+		}
+		void IndexAdd(uint64_t id, uint32_t slot) {
+			IndexShard & shard = WritableShard(id);
+			if (shard.empty() || shard.back().first < id)
+				shard.emplace_back(id, slot);
+			else
+				shard.emplace(LowerBound(shard, id), id, slot);
+		}
+		void IndexMove(uint64_t id, uint32_t slot) {
+			IndexShard & shard = WritableShard(id);
+			LowerBound(shard, id)->second = slot;
+		}
+		void IndexRemove(uint64_t id) {
+			IndexShard & shard = WritableShard(id);
+			shard.erase(LowerBound(shard, id));
+		}
+		// Slot of the chunk holding the element, UINT32_MAX if it isn't here
+		uint32_t SlotOf(uint64_t id) const {
+			const IndexShard *shard = ShardOf(id);
+			if (!shard) return UINT32_MAX;
+			auto it = std::lower_bound(shard->begin(), shard->end(), std::make_pair(id, (uint32_t) 0));
+			return it != shard->end() && it->first == id ? it->second : UINT32_MAX;
+		}
+
+	public:
+		uint32_t Size() const {
+			return size;
+		}
+		bool Empty() const {
+			return !size;
+		}
+		const T& Get(uint32_t index) const {
+			uint32_t position = ChunkOf(index);
+			return chunks[position]->items[index - offsets[position]];
+		}
+		// Copies the chunk first if another version shares it
+		T& GetMutable(uint32_t index) {
+			uint32_t position = ChunkOf(index);
+			return Writable(position).items[index - offsets[position]];
+		}
+		Handle HandleAt(uint32_t index) const {
+			uint32_t position = ChunkOf(index);
+			return Handle{ chunks[position]->ids[index - offsets[position]] };
+		}
+		// Current index of the element, Size() if it was deleted.
+		// Binary search in one shard of the index, then a scan of one chunk
+		uint32_t IndexOf(Handle handle) const {
+			uint32_t slot = SlotOf(handle.id);
+			if (slot == UINT32_MAX)
+				return size;
+			uint32_t position = positions[slot];
+			const std::vector<uint64_t> & ids = chunks[position]->ids;
+			return offsets[position] + (uint32_t) (std::find(ids.begin(), ids.end(), handle.id) - ids.begin());
+		}
+		// nullptr if the element was deleted
+		const T* Find(Handle handle) const {
+			uint32_t index = IndexOf(handle);
+			return index < size ? &Get(index) : nullptr;
+		}
+		void Reserve(uint32_t count) {
+			chunks.reserve((size + count) / CHUNK_SIZE + 1);
+			offsets.reserve((size + count) / CHUNK_SIZE + 1);
+		}
+		// Appending fills chunks completely instead of splitting them
+		Handle PushBack(T && data) {
+			uint64_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+			if (chunks.empty() || chunks.back()->items.size() >= CHUNK_SIZE) {
+				chunks.push_back(NewChunk());
+				offsets.push_back(size);
+				positions[chunks.back()->slot] = (uint32_t) chunks.size() - 1;
+			}
+			Chunk & chunk = Writable((uint32_t) chunks.size() - 1);
+			chunk.items.push_back(std::move(data));
+			chunk.ids.push_back(id);
+			IndexAdd(id, chunk.slot);
+			++size;
+			return Handle{ id };
+		}
+		// Inserts before index, index == Size() appends
+		Handle Insert(uint32_t index, T && data) {
+			if (index == size)
+				return PushBack(std::move(data));
+			uint64_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+			uint32_t position = ChunkOf(index);
+			Chunk & chunk = Writable(position);
+			uint32_t inside = index - offsets[position];
+			chunk.items.insert(chunk.items.begin() + inside, std::move(data));
+			chunk.ids.insert(chunk.ids.begin() + inside, id);
+			IndexAdd(id, chunk.slot);
+			++size;
+			if (chunk.items.size() > CHUNK_SIZE) {
+				// splitting in halves
+				std::shared_ptr<Chunk> second = NewChunk();
+				std::move(chunk.items.begin() + CHUNK_SIZE / 2, chunk.items.end(), std::back_inserter(second->items));
+				second->ids.assign(chunk.ids.begin() + CHUNK_SIZE / 2, chunk.ids.end());
+				for (uint64_t moved : second->ids)
+					IndexMove(moved, second->slot);
+				chunk.items.erase(chunk.items.begin() + CHUNK_SIZE / 2, chunk.items.end());
+				chunk.ids.resize(CHUNK_SIZE / 2);
+				chunks.insert(chunks.begin() + position + 1, std::move(second));
+			}
+			UpdateOffsets(position + 1);
+			return Handle{ id };
+		}
+		void Erase(uint32_t index) {
+			uint32_t position = ChunkOf(index);
+			IndexRemove(chunks[position]->ids[index - offsets[position]]);
+			if (chunks[position]->items.size() == 1) {
+				free_slots.push_back(chunks[position]->slot);
+				chunks.erase(chunks.begin() + position);
+			} else {
+				Chunk & chunk = Writable(position);
+				uint32_t inside = index - offsets[position];
+				chunk.items.erase(chunk.items.begin() + inside);
+				chunk.ids.erase(chunk.ids.begin() + inside);
+			}
+			--size;
+			UpdateOffsets(position);
+		}
+		void Clear() {
+			chunks.clear();
+			offsets.clear();
+			positions.clear();
+			free_slots.clear();
+			index.clear();
+			size = 0;
+		}
+		// Calls f(element) for every element in order
+		template<typename F>
+		void ForEach(F f) const {
+			for (const std::shared_ptr<Chunk> & chunk : chunks)
+				for (const T & item : chunk->items)
+					f(item);
+		}
+		// Copies every shared chunk
+		template<typename F>
+		void ForEach(F f) {
+			for (uint32_t i = 0; i < chunks.size(); ++i)
+				for (T & item : Writable(i).items)
+					f(item);
+		}
+	};
+
+	// Helpers for the binary file format (see BinaryFormat below)
+	constexpr std::array<uint32_t, 256> MakeCrcTable() {
+		std::array<uint32_t, 256> table{};
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (uint32_t k = 0; k < 8; ++k)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		return table;
+	}
+	constexpr std::array<uint32_t, 256> CRC_TABLE = MakeCrcTable();
+	// CRC-32 (IEEE), crc is the running value, start with 0
+	inline uint32_t Crc32(uint32_t crc, const char *data, size_t size) {
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = CRC_TABLE[(crc ^ (uint8_t) data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+	inline uint64_t ZigZag(int64_t value) {
+		return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+	}
+	inline int64_t UnZigZag(uint64_t value) {
+		return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+	}
+
+	// Buffered output with running checksum and position
+	class ByteWriter {
+	private:
+		static constexpr size_t BUFFER_SIZE = 1 << 16;
+		std::ostream & output;
+		std::string buffer;
+		uint64_t position = 0;
+		uint32_t crc = 0;
+
+	public:
+		explicit ByteWriter(std::ostream & output): output(output) {
+			buffer.reserve(BUFFER_SIZE);
+		}
+		~ByteWriter() {
+			Flush();
+		}
+		uint64_t Position() const {
+			return position;
+		}
+		uint32_t Checksum() const {
+			return crc;
+		}
+		void Write(const char *data, size_t size) {
+			crc = Crc32(crc, data, size);
+			position += size;
+			buffer.append(data, size);
+			if (buffer.size() >= BUFFER_SIZE) Flush();
+		}
+		void WriteByte(uint8_t byte) {
+			char c = (char) byte;
+			Write(&c, 1);
+		}
+		template<typename T>
+		void WriteFixed(T value) {
+			char bytes[sizeof(T)];
+			for (uint32_t i = 0; i < sizeof(T); ++i)
+				bytes[i] = (char) (uint8_t) ((uint64_t) value >> (8 * i));
+			Write(bytes, sizeof(T));
+		}
+		template<typename U>
+		void WriteVarint(U value) {
+			char bytes[20];
+			uint32_t n = 0;
+			do {
+				uint8_t byte = (uint8_t) (value & 0x7F);
+				value >>= 7;
+				bytes[n++] = (char) (value ? byte | 0x80 : byte);
+			} while (value);
+			Write(bytes, n);
+		}
+		void Flush() {
+			output.write(buffer.data(), (std::streamsize) buffer.size());
+			buffer.clear();
+		}
+	};
+
+	// Buffered input with running checksum, every read reports failure instead of throwing
+	class ByteReader {
+	private:
+		static constexpr size_t BUFFER_SIZE = 1 << 16;
+		std::istream & input;
+		std::vector<char> buffer;
+		size_t begin = 0, end = 0;
+		uint64_t position = 0;
+		uint32_t crc = 0;
+
+		bool Refill() {
+			if (begin < end) return true;
+			input.read(buffer.data(), (std::streamsize) buffer.size());
+			begin = 0;
+			end = (size_t) input.gcount();
+			return end > 0;
+		}
+
+	public:
+		explicit ByteReader(std::istream & input, uint64_t position = 0): input(input), buffer(BUFFER_SIZE), position(position) {}
+		uint64_t Position() const {
+			return position;
+		}
+		uint32_t Checksum() const {
+			return crc;
+		}
+		bool Read(char *data, size_t size) {
+			while (size) {
+				if (!Refill()) return false;
+				size_t n = std::min(size, end - begin);
+				std::copy(buffer.data() + begin, buffer.data() + begin + n, data);
+				crc = Crc32(crc, data, n);
+				begin += n;
+				position += n;
+				data += n;
+				size -= n;
+			}
+			return true;
+		}
+		bool ReadByte(uint8_t & byte) {
+			char c;
+			if (!Read(&c, 1)) return false;
+			byte = (uint8_t) c;
+			return true;
+		}
+		template<typename T>
+		bool ReadFixed(T & value) {
+			char bytes[sizeof(T)];
+			if (!Read(bytes, sizeof(T))) return false;
+			uint64_t result = 0;
+			for (uint32_t i = 0; i < sizeof(T); ++i)
+				result |= (uint64_t) (uint8_t) bytes[i] << (8 * i);
+			value = (T) result;
+			return true;
+		}
+		template<typename U>
+		bool ReadVarint(U & value) {
+			value = 0;
+			for (uint32_t shift = 0; shift < sizeof(U) * 8; shift += 7) {
+				uint8_t byte;
+				if (!ReadByte(byte)) return false;
+				value |= (U) (byte & 0x7F) << shift;
+				if (!(byte & 0x80)) return true;
+			}
+			return false;
+		}
+	};
+
+	// Coefficient rings Polynomial can be instantiated with besides fixed width integers
+	using Int128 = __int128;
+
+	// Arbitrary precision signed integer, magnitude is kept as little endian 32-bit limbs
+	class BigInt {
+	private:
+		std::vector<uint32_t> limbs;
+		bool negative = false;
+	public:
+		static constexpr uint64_t BINARY_TAG = (uint64_t) 4 << 32;
+	private:
+		void Trim() {
+			while (!limbs.empty() && !limbs.back()) limbs.pop_back();
+			if (limbs.empty()) negative = false;
+		}
+		static int CompareMagnitude(const std::vector<uint32_t> & a, const std::vector<uint32_t> & b) {
+			if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+			for (uint32_t i = (uint32_t) a.size(); i-- > 0;)
+				if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+			return 0;
+		}
+		// a += b
+		static void AddMagnitude(std::vector<uint32_t> & a, const std::vector<uint32_t> & b) {
+			if (a.size() < b.size()) a.resize(b.size(), 0);
+			uint64_t carry = 0;
+			for (uint32_t i = 0; i < a.size(); ++i) {
+				carry += (uint64_t) a[i] + (i < b.size() ? b[i] : 0);
+				a[i] = (uint32_t) carry;
+				carry >>= 32;
+				if (!carry && i >= b.size()) break;
+			}
+			if (carry) a.push_back((uint32_t) carry);
+		}
+		// a -= b, |a| >= |b|
+		static void SubtractMagnitude(std::vector<uint32_t> & a, const std::vector<uint32_t> & b) {
+			int64_t borrow = 0;
+			for (uint32_t i = 0; i < a.size(); ++i) {
+				int64_t diff = (int64_t) a[i] - (i < b.size() ? b[i] : 0) - borrow;
+				borrow = diff < 0;
+				a[i] = (uint32_t) (diff + (borrow << 32));
+				if (!borrow && i >= b.size()) break;
+			}
+		}
+		void AddSigned(const BigInt & other, bool other_negative) {
+			if (negative == other_negative) {
+				AddMagnitude(limbs, other.limbs);
+			} else if (CompareMagnitude(limbs, other.limbs) >= 0) {
+				SubtractMagnitude(limbs, other.limbs);
+			} else {
+				std::vector<uint32_t> result = other.limbs;
+				SubtractMagnitude(result, limbs);
+				limbs = std::move(result);
+				negative = other_negative;
+			}
+			Trim();
+		}
+
+	public:
+		BigInt() = default;
+		BigInt(int64_t value) {
+			negative = value < 0;
+			uint64_t magnitude = negative ? 0 - (uint64_t) value : (uint64_t) value;
+			while (magnitude) {
+				limbs.push_back((uint32_t) magnitude);
+				magnitude >>= 32;
+			}
+		}
+		static BigInt FromUnsigned(uint64_t value) {
+			BigInt result;
+			for (; value; value >>= 32)
+				result.limbs.push_back((uint32_t) value);
+			return result;
+		}
+		bool IsNegative() const {
+			return negative;
+		}
+		bool IsZero() const {
+			return limbs.empty();
+		}
+		BigInt Abs() const {
+			BigInt result = *this;
+			result.negative = false;
+			return result;
+		}
+		// Sign and limb count as one varint, then the limbs
+		void Encode(ByteWriter & writer) const {
+			writer.WriteVarint((uint64_t) limbs.size() << 1 | (negative ? 1 : 0));
+			for (uint32_t limb : limbs)
+				writer.WriteFixed(limb);
+		}
+		bool Decode(ByteReader & reader) {
+			uint64_t header;
+			if (!reader.ReadVarint(header) || (header >> 1) > ((uint64_t) 1 << 32)) return false;
+			limbs.resize((size_t) (header >> 1));
+			for (uint32_t & limb : limbs)
+				if (!reader.ReadFixed(limb)) return false;
+			negative = header & 1;
+			Trim();
+			return true;
+		}
+		uint64_t Hash() const {
+			uint64_t hash = negative;
+			for (uint32_t limb : limbs)
+				hash = HashMix(hash ^ limb);
+			return hash;
+		}
+		// Number of significant bits of the magnitude
+		uint32_t BitLength() const {
+			if (limbs.empty()) return 0;
+			uint32_t top = limbs.back(), bits = 0;
+			while (top) ++bits, top >>= 1;
+			return ((uint32_t) limbs.size() - 1) * 32 + bits;
+		}
+		BigInt operator-() const {
+			BigInt result = *this;
+			if (!result.limbs.empty()) result.negative = !negative;
+			return result;
+		}
+		BigInt& operator+=(const BigInt & other) {
+			AddSigned(other, other.negative);
+			return *this;
+		}
+		BigInt& operator-=(const BigInt & other) {
+			AddSigned(other, !other.negative && !other.limbs.empty());
+			return *this;
+		}
+		BigInt& operator*=(const BigInt & other) {
+			if (limbs.empty() || other.limbs.empty()) {
+				limbs.clear();
+				negative = false;
+				return *this;
+			}
+			std::vector<uint32_t> result(limbs.size() + other.limbs.size(), 0);
+			for (uint32_t i = 0; i < limbs.size(); ++i) {
+				uint64_t carry = 0;
+				for (uint32_t j = 0; j < other.limbs.size(); ++j) {
+					carry += (uint64_t) limbs[i] * other.limbs[j] + result[i + j];
+					result[i + j] = (uint32_t) carry;
+					carry >>= 32;
+				}
+				for (uint32_t k = i + (uint32_t) other.limbs.size(); carry; ++k) {
+					carry += result[k];
+					result[k] = (uint32_t) carry;
+					carry >>= 32;
+				}
+			}
+			limbs = std::move(result);
+			negative = negative != other.negative;
+			Trim();
+			return *this;
+		}
+		// Divides magnitude in place, returns remainder of the magnitude
+		uint32_t DivModSmall(uint32_t divisor) {
+			uint64_t remainder = 0;
+			for (uint32_t i = (uint32_t) limbs.size(); i-- > 0;) {
+				remainder = (remainder << 32) | limbs[i];
+				limbs[i] = (uint32_t) (remainder / divisor);
+				remainder %= divisor;
+			}
+			Trim();
+			return (uint32_t) remainder;
+		}
+		// Truncating division like built-in integers do: quotient is rounded toward zero,
+		// remainder takes the sign of the dividend. Long division is Knuth's algorithm D
+		static void DivMod(const BigInt & a, const BigInt & b, BigInt & quotient, BigInt & remainder) {
+			if (b.limbs.empty())
+				throw std::domain_error("Division by zero.");
+			if (CompareMagnitude(a.limbs, b.limbs) < 0) {
+				remainder = a;
+				quotient = BigInt();
+				return;
+			}
+			bool quotient_negative = a.negative != b.negative, remainder_negative = a.negative;
+			if (b.limbs.size() == 1) {
+				BigInt q = a;
+				uint32_t r = q.DivModSmall(b.limbs[0]);
+				q.negative = quotient_negative;
+				q.Trim();
+				quotient = std::move(q);
+				remainder = BigInt(r);
+				remainder.negative = remainder_negative && r;
+				return;
+			}
+			uint32_t n = (uint32_t) b.limbs.size(), m = (uint32_t) a.limbs.size() - n;
+			uint32_t shift = (uint32_t) __builtin_clz(b.limbs.back());
+			std::vector<uint32_t> u(a.limbs.size() + 1, 0), v(n, 0), q(m + 1, 0);
+			for (uint32_t i = 0; i < n; ++i)
+				v[i] = (b.limbs[i] << shift) | (shift && i ? b.limbs[i - 1] >> (32 - shift) : 0);
+			for (uint32_t i = 0; i < a.limbs.size(); ++i)
+				u[i] = (a.limbs[i] << shift) | (shift && i ? a.limbs[i - 1] >> (32 - shift) : 0);
+			u[a.limbs.size()] = shift ? a.limbs.back() >> (32 - shift) : 0;
+			for (uint32_t j = m + 1; j-- > 0;) {
+				uint64_t numerator = ((uint64_t) u[j + n] << 32) | u[j + n - 1];
+				uint64_t q_hat = numerator / v[n - 1], r_hat = numerator % v[n - 1];
+				while (q_hat >> 32 || q_hat * v[n - 2] > ((r_hat << 32) | u[j + n - 2])) {
+					--q_hat;
+					r_hat += v[n - 1];
+					if (r_hat >> 32) break;
+				}
+				int64_t borrow = 0;
+				uint64_t carry = 0;
+				for (uint32_t i = 0; i < n; ++i) {
+					uint64_t product = q_hat * v[i] + carry;
+					carry = product >> 32;
+					int64_t diff = (int64_t) u[i + j] - borrow - (int64_t) (uint32_t) product;
+					u[i + j] = (uint32_t) diff;
+					borrow = diff < 0;
+				}
+				int64_t diff = (int64_t) u[j + n] - borrow - (int64_t) carry;
+				u[j + n] = (uint32_t) diff;
+				if (diff < 0) {
+					// q_hat was one too big, adding divisor back
+					--q_hat;
+					carry = 0;
+					for (uint32_t i = 0; i < n; ++i) {
+						uint64_t sum = (uint64_t) u[i + j] + v[i] + carry;
+						u[i + j] = (uint32_t) sum;
+						carry = sum >> 32;
+					}
+					u[j + n] += (uint32_t) carry;
+				}
+				q[j] = (uint32_t) q_hat;
+			}
+			quotient.limbs = std::move(q);
+			quotient.negative = quotient_negative;
+			quotient.Trim();
+			remainder.limbs.assign(n, 0);
+			for (uint32_t i = 0; i < n; ++i)
+				remainder.limbs[i] = (u[i] >> shift) | (shift ? u[i + 1] << (32 - shift) : 0);
+			remainder.negative = remainder_negative;
+			remainder.Trim();
+		}
+		static BigInt Gcd(BigInt a, BigInt b) {
+			a.negative = b.negative = false;
+			while (!b.IsZero()) {
+				BigInt q, r;
+				DivMod(a, b, q, r);
+				a = std::move(b);
+				b = std::move(r);
+			}
+			return a;
+		}
+		// Writes magnitude into result if it fits into 64 bits
+		bool MagnitudeToUint64(uint64_t & result) const {
+			if (limbs.size() > 2) return false;
+			result = 0;
+			for (uint32_t i = 0; i < limbs.size(); ++i)
+				result |= (uint64_t) limbs[i] << (32 * i);
+			return true;
+		}
+		// Remainder of the division by a small modulus in [0, modulus)
+		uint32_t Residue(uint32_t modulus) const {
+			uint64_t remainder = 0;
+			for (uint32_t i = (uint32_t) limbs.size(); i-- > 0;)
+				remainder = ((remainder << 32) | limbs[i]) % modulus;
+			return negative && remainder ? modulus - (uint32_t) remainder : (uint32_t) remainder;
+		}
+		friend BigInt operator/(const BigInt & lhs, const BigInt & rhs) {
+			BigInt q, r;
+			DivMod(lhs, rhs, q, r);
+			return q;
+		}
+		friend BigInt operator%(const BigInt & lhs, const BigInt & rhs) {
+			BigInt q, r;
+			DivMod(lhs, rhs, q, r);
+			return r;
+		}
+		friend BigInt operator+(BigInt lhs, const BigInt & rhs) {
+			return lhs += rhs;
+		}
+		friend BigInt operator-(BigInt lhs, const BigInt & rhs) {
+			return lhs -= rhs;
+		}
+		friend BigInt operator*(BigInt lhs, const BigInt & rhs) {
+			return lhs *= rhs;
+		}
+		friend bool operator==(const BigInt & lhs, const BigInt & rhs) {
+			return lhs.negative == rhs.negative && lhs.limbs == rhs.limbs;
+		}
+		friend bool operator!=(const BigInt & lhs, const BigInt & rhs) {
+			return !(lhs == rhs);
+		}
+		friend bool operator<(const BigInt & lhs, const BigInt & rhs) {
+			if (lhs.negative != rhs.negative) return lhs.negative;
+			int cmp = CompareMagnitude(lhs.limbs, rhs.limbs);
+			return lhs.negative ? cmp > 0 : cmp < 0;
+		}
+		friend bool operator>(const BigInt & lhs, const BigInt & rhs) {
+			return rhs < lhs;
+		}
+		friend bool operator<=(const BigInt & lhs, const BigInt & rhs) {
+			return !(rhs < lhs);
+		}
+		friend bool operator>=(const BigInt & lhs, const BigInt & rhs) {
+			return !(lhs < rhs);
+		}
+		std::string ToString() const {
+			if (limbs.empty()) return "0";
+			BigInt magnitude = Abs();
+			std::string result;
+			while (!magnitude.IsZero()) {
+				uint32_t chunk = magnitude.DivModSmall(1000000000);
+				for (uint32_t i = 0; i < 9 && (chunk || !magnitude.IsZero()); ++i) {
+					result.push_back((char) ('0' + chunk % 10));
+					chunk /= 10;
+				}
+			}
+			if (negative) result.push_back('-');
+			std::reverse(result.begin(), result.end());
+			return result;
+		}
+		// Low 64 bits in two's complement, same as narrowing a wider integer
+		explicit operator int64_t() const {
+			uint64_t low = 0;
+			for (uint32_t i = 0; i < limbs.size() && i < 2; ++i)
+				low |= (uint64_t) limbs[i] << (32 * i);
+			return (int64_t) (negative ? 0 - low : low);
+		}
+		// Lowest 128 bits, like the int64_t conversion
+		explicit operator Int128() const {
+			unsigned __int128 low = 0;
+			for (uint32_t i = 0; i < limbs.size() && i < 4; ++i)
+				low |= (unsigned __int128) limbs[i] << (32 * i);
+			return (Int128) (negative ? 0 - low : low);
+		}
+		explicit operator double() const {
+			double result = 0;
+			for (uint32_t i = (uint32_t) limbs.size(); i-- > 0;)
+				result = result * 4294967296.0 + limbs[i];
+			return negative ? -result : result;
+		}
+	};
+
+	// Exact rational number, always kept reduced with positive denominator
+	class Rational {
+	private:
+		BigInt num, den = 1;
+	public:
+		static constexpr uint64_t BINARY_TAG = (uint64_t) 5 << 32;
+	private:
+		void Reduce() {
+			if (den.IsNegative()) {
+				num = -num;
+				den = -den;
+			}
+			BigInt g = BigInt::Gcd(num, den);
+			if (g != BigInt(1) && !g.IsZero()) {
+				num = num / g;
+				den = den / g;
+			}
+		}
+	public:
+		Rational() = default;
+		Rational(int64_t value): num(value) {}
+		Rational(const BigInt & value): num(value) {}
+		Rational(const BigInt & numerator, const BigInt & denominator): num(numerator), den(denominator) {
+			if (den.IsZero())
+				throw std::domain_error("Rational with zero denominator.");
+			Reduce();
+		}
+		const BigInt & Numerator() const {
+			return num;
+		}
+		const BigInt & Denominator() const {
+			return den;
+		}
+		void Encode(ByteWriter & writer) const {
+			num.Encode(writer);
+			den.Encode(writer);
+		}
+		bool Decode(ByteReader & reader) {
+			BigInt n, d;
+			if (!n.Decode(reader) || !d.Decode(reader) || d.IsZero()) return false;
+			*this = Rational(n, d);
+			return true;
+		}
+		uint64_t Hash() const {
+			return HashMix(num.Hash() ^ HashMix(den.Hash()));
+		}
+		bool IsNegative() const {
+			return num.IsNegative();
+		}
+		Rational Abs() const {
+			Rational result = *this;
+			result.num = num.Abs();
+			return result;
+		}
+		Rational operator-() const {
+			Rational result = *this;
+			result.num = -num;
+			return result;
+		}
+		Rational& operator+=(const Rational & other) {
+			*this = Rational(num * other.den + other.num * den, den * other.den);
+			return *this;
+		}
+		Rational& operator-=(const Rational & other) {
+			*this = Rational(num * other.den - other.num * den, den * other.den);
+			return *this;
+		}
+		Rational& operator*=(const Rational & other) {
+			*this = Rational(num * other.num, den * other.den);
+			return *this;
+		}
+		Rational& operator/=(const Rational & other) {
+			*this = Rational(num * other.den, den * other.num);
+			return *this;
+		}
+		friend Rational operator+(Rational lhs, const Rational & rhs) {
+			return lhs += rhs;
+		}
+		friend Rational operator-(Rational lhs, const Rational & rhs) {
+			return lhs -= rhs;
+		}
+		friend Rational operator*(Rational lhs, const Rational & rhs) {
+			return lhs *= rhs;
+		}
+		friend Rational operator/(Rational lhs, const Rational & rhs) {
+			return lhs /= rhs;
+		}
+		friend bool operator==(const Rational & lhs, const Rational & rhs) {
+			return lhs.num == rhs.num && lhs.den == rhs.den;
+		}
+		friend bool operator!=(const Rational & lhs, const Rational & rhs) {
+			return !(lhs == rhs);
+		}
+		friend bool operator<(const Rational & lhs, const Rational & rhs) {
+			return lhs.num * rhs.den < rhs.num * lhs.den;
+		}
+		std::string ToString() const {
+			if (den == BigInt(1)) return num.ToString();
+			return num.ToString() + '/' + den.ToString();
+		}
+		explicit operator double() const {
+			return (double) num / (double) den;
+		}
+	};
+
+	// Element of the prime field Z/PZ, P has to be a prime below 2^31
+	template<uint32_t P>
+	class Zp {
+	private:
+		uint32_t value = 0;
+	public:
+		static constexpr uint32_t Modulus = P;
+		Zp() = default;
+		Zp(int64_t x) {
+			int64_t residue = x % (int64_t) P;
+			value = (uint32_t) (residue < 0 ? residue + P : residue);
+		}
+		uint32_t Value() const {
+			return value;
+		}
+		bool IsNegative() const {
+			return false;
+		}
+		Zp Abs() const {
+			return *this;
+		}
+		Zp Power(uint64_t p) const {
+			Zp result = 1, a = *this;
+			while (p) {
+				if (p & 1) result *= a;
+				a *= a;
+				p >>= 1;
+			}
+			return result;
+		}
+		Zp Inverse() const {
+			return Power(P - 2);
+		}
+		Zp operator-() const {
+			Zp result;
+			result.value = value ? P - value : 0;
+			return result;
+		}
+		Zp& operator+=(const Zp & other) {
+			value += other.value;
+			if (value >= P) value -= P;
+			return *this;
+		}
+		Zp& operator-=(const Zp & other) {
+			value = value >= other.value ? value - other.value : value + P - other.value;
+			return *this;
+		}
+		Zp& operator*=(const Zp & other) {
+			value = (uint32_t) ((uint64_t) value * other.value % P);
+			return *this;
+		}
+		friend Zp operator+(Zp lhs, const Zp & rhs) {
+			return lhs += rhs;
+		}
+		friend Zp operator-(Zp lhs, const Zp & rhs) {
+			return lhs -= rhs;
+		}
+		friend Zp operator*(Zp lhs, const Zp & rhs) {
+			return lhs *= rhs;
+		}
+		friend bool operator==(const Zp & lhs, const Zp & rhs) {
+			return lhs.value == rhs.value;
+		}
+		friend bool operator!=(const Zp & lhs, const Zp & rhs) {
+			return lhs.value != rhs.value;
+		}
+		std::string ToString() const {
+			return std::to_string(value);
+		}
+		explicit operator int64_t() const {
+			return value;
+		}
+		explicit operator double() const {
+			return value;
+		}
+	};
+
+	// Signed overflow is UB, so fixed width integers are added and multiplied in the unsigned type of the same width:
+	// it's the same ring modulo 2^n, so results are bit-identical to wrapping arithmetic
+	template<typename T, typename = void>
+	struct WrappingType {
+		using type = T;
+	};
+	template<typename T>
+	struct WrappingType<T, std::enable_if_t<std::is_integral<T>::value>> {
+		using type = std::make_unsigned_t<T>;
+	};
+	template<>
+	struct WrappingType<Int128> {
+		using type = unsigned __int128;
+	};
+	// Single operations for the merges, other types are used as they are so BigInt isn't copied
+	template<typename T>
+	T WrappingAdd(const T & lhs, const T & rhs) {
+		using W = typename WrappingType<T>::type;
+		if constexpr (std::is_same<W, T>::value)
+			return lhs + rhs;
+		else
+			return (T) ((W) lhs + (W) rhs);
+	}
+	template<typename T>
+	T WrappingMultiply(const T & lhs, const T & rhs) {
+		using W = typename WrappingType<T>::type;
+		if constexpr (std::is_same<W, T>::value)
+			return lhs * rhs;
+		else
+			return (T) ((W) lhs * (W) rhs);
+	}
+
+	// Length of a dense array indexed by degrees up to degree. Degrees go up to 2^64 - 1, so sparse polynomials
+	// can be far beyond what fits in memory densely, algorithms that need the dense form throw std::length_error then
+	template<typename T>
+	size_t DenseLength(uint64_t degree) {
+		if (degree >= std::vector<T>().max_size())
+			throw std::length_error("Degree is too high for a dense representation.");
+		return (size_t) degree + 1;
+	}
+
+	// Flat term storage for polynomials.
+	// Sparse polynomials are kept as two parallel arrays (degrees and coefficients) sorted by degree,
+	// dense ones as a plain coefficient array indexed by degree.
+	// Representation is picked by fill ratio in Normalize(), zero coefficients are never kept
+	// Copies share the arrays, they are copied only when a shared storage gets modified
+	template<typename C>
+	class TermStorage {
+	public:
+		struct Term {
+			uint64_t degree;
+			C coeff;
+			bool operator<(const Term & other) const {
+				return degree < other.degree;
+			}
+		};
+		// dense array is used when at least 1/DENSE_FILL of its slots are non-zero
+		static constexpr uint32_t DENSE_FILL = 2;
+
+	private:
+		struct Data {
+			// sparse representation
+			std::vector<uint64_t> degrees;
+			std::vector<C> coeffs;
+			// dense representation, dense[i] is the coefficient of x^i, last element is never zero
+			std::vector<C> dense;
+			uint32_t count = 0;
+			bool dense_mode = false;
+			// Structural hash, 0 if it wasn't computed since the last change
+			mutable std::atomic<uint64_t> hash{ 0 };
+
+			Data() = default;
+			Data(const Data & other): degrees(other.degrees), coeffs(other.coeffs), dense(other.dense),
+				count(other.count), dense_mode(other.dense_mode), hash(other.hash.load(std::memory_order_relaxed)) {}
+		};
+		std::shared_ptr<Data> data;
+
+		static const Data & EmptyData() {
+			static const Data empty;
+			return empty;
+		}
+		const Data & Read() const {
+			return data ? *data : EmptyData();
+		}
+		// Every modification goes through here
+		Data & Write() {
+			if (!data) {
+				CORE_PROFILE_ALLOCATION();
+				data = std::make_shared<Data>();
+			} else if (data.use_count() > 1) {
+				CORE_PROFILE_ALLOCATION();
+				data = std::make_shared<Data>(*data);
+			}
+			data->hash.store(0, std::memory_order_relaxed);
+			return *data;
+		}
+		static uint32_t SparseIndex(const Data & d, uint64_t degree) {
+			return (uint32_t) (std::lower_bound(d.degrees.begin(), d.degrees.end(), degree) - d.degrees.begin());
+		}
+		static void ToSparse(Data & d) {
+			d.degrees.clear();
+			d.coeffs.clear();
+			d.degrees.reserve(d.count);
+			d.coeffs.reserve(d.count);
+			for (uint32_t i = 0; i < d.dense.size(); ++i) {
+				if (d.dense[i] == C(0)) continue;
+				d.degrees.push_back(i);
+				d.coeffs.push_back(d.dense[i]);
+			}
+			d.dense.clear();
+			d.dense_mode = false;
+		}
+		static void ToDense(Data & d) {
+			d.dense.assign(d.degrees.empty() ? 0 : DenseLength<C>(d.degrees.back()), C(0));
+			for (uint32_t i = 0; i < d.degrees.size(); ++i)
+				d.dense[d.degrees[i]] = d.coeffs[i];
+			d.degrees.clear();
+			d.coeffs.clear();
+			d.dense_mode = true;
+		}
+		static bool ShouldBeDense(uint32_t nonzero, uint64_t max_degree) {
+			return nonzero && max_degree < (uint64_t) nonzero * DENSE_FILL;
+		}
+
+	public:
+		class ConstIterator {
+		private:
+			const Data *storage;
+			uint32_t pos;
+		public:
+			ConstIterator(const Data *storage, uint32_t pos): storage(storage), pos(pos) {}
+			Term operator*() const {
+				if (storage->dense_mode)
+					return Term{ pos, storage->dense[pos] };
+				return Term{ storage->degrees[pos], storage->coeffs[pos] };
+			}
+			ConstIterator& operator++() {
+				++pos;
+				if (storage->dense_mode)
+					while (pos < storage->dense.size() && storage->dense[pos] == C(0)) ++pos;
+				return *this;
+			}
+			ConstIterator& operator--() {
+				--pos;
+				if (storage->dense_mode)
+					while (pos > 0 && storage->dense[pos] == C(0)) --pos;
+				return *this;
+			}
+			bool operator==(const ConstIterator & other) const {
+				return pos == other.pos;
+			}
+			bool operator!=(const ConstIterator & other) const {
+				return pos != other.pos;
+			}
+		};
+
+		uint32_t Size() const {
+			return Read().count;
+		}
+		bool Empty() const {
+			return !Read().count;
+		}
+		bool IsDense() const {
+			return Read().dense_mode;
+		}
+		// Both hold the very same arrays
+		bool SharesWith(const TermStorage & other) const {
+			return data && data == other.data;
+		}
+		void ShareWith(const TermStorage & other) {
+			data = other.data;
+		}
+		// Cached hash, compute is only called if there's none. 0 isn't a valid hash
+		template<typename F>
+		uint64_t Hash(F compute) const {
+			const Data & d = Read();
+			uint64_t hash = d.hash.load(std::memory_order_relaxed);
+			if (!hash) {
+				hash = compute();
+				if (!hash) hash = 1;
+				d.hash.store(hash, std::memory_order_relaxed);
+			}
+			return hash;
+		}
+		bool operator==(const TermStorage & other) const {
+			if (data == other.data) return true;
+			const Data & l = Read(), & r = other.Read();
+			if (l.count != r.count) return false;
+			if (l.dense_mode && r.dense_mode) return l.dense == r.dense;
+			if (!l.dense_mode && !r.dense_mode) return l.degrees == r.degrees && l.coeffs == r.coeffs;
+			for (auto lp = begin(), rp = other.begin(), lend = end(); lp != lend; ++lp, ++rp) {
+				Term lt = *lp, rt = *rp;
+				if (lt.degree != rt.degree || lt.coeff != rt.coeff) return false;
+			}
+			return true;
+		}
+		bool operator!=(const TermStorage & other) const {
+			return !(*this == other);
+		}
+		ConstIterator begin() const {
+			const Data & d = Read();
+			if (!d.dense_mode) return ConstIterator(&d, 0);
+			uint32_t pos = 0;
+			while (pos < d.dense.size() && d.dense[pos] == C(0)) ++pos;
+			return ConstIterator(&d, pos);
+		}
+		ConstIterator end() const {
+			const Data & d = Read();
+			return ConstIterator(&d, d.dense_mode ? (uint32_t) d.dense.size() : (uint32_t) d.degrees.size());
+		}
+		// lowest and highest degree terms, storage must not be empty
+		Term Front() const {
+			return *begin();
+		}
+		Term Back() const {
+			const Data & d = Read();
+			if (d.dense_mode)
+				return Term{ (uint64_t) d.dense.size() - 1, d.dense.back() };
+			return Term{ d.degrees.back(), d.coeffs.back() };
+		}
+		// Sparse arrays are only meaningful when !IsDense() and vice versa
+		const std::vector<uint64_t> & Degrees() const {
+			return Read().degrees;
+		}
+		const std::vector<C> & Coeffs() const {
+			return Read().coeffs;
+		}
+		const std::vector<C> & Dense() const {
+			return Read().dense;
+		}
+		// Keeps capacity unless the arrays are shared
+		void Clear() {
+			if (!data || data.use_count() > 1) {
+				data.reset();
+				return;
+			}
+			data->degrees.clear();
+			data->coeffs.clear();
+			data->dense.clear();
+			data->count = 0;
+			data->dense_mode = false;
+			data->hash.store(0, std::memory_order_relaxed);
+		}
+		void Reserve(uint32_t n) {
+			Data & d = Write();
+			d.degrees.reserve(n);
+			d.coeffs.reserve(n);
+		}
+		C Get(uint64_t degree) const {
+			const Data & d = Read();
+			if (d.dense_mode)
+				return degree < d.dense.size() ? d.dense[degree] : C(0);
+			uint32_t index = SparseIndex(d, degree);
+			if (index == d.degrees.size() || d.degrees[index] != degree) return C(0);
+			return d.coeffs[index];
+		}
+		// Adds coeff*x^degree to whatever is stored at that degree
+		void Add(uint64_t degree, C coeff) {
+			if (coeff == C(0)) return;
+			Data & d = Write();
+			if (d.dense_mode) {
+				if (degree < d.dense.size()) {
+					C & slot = d.dense[degree];
+					if (slot == C(0)) ++d.count;
+					slot = WrappingAdd(slot, coeff);
+					if (slot == C(0)) --d.count;
+					while (!d.dense.empty() && d.dense.back() == C(0)) d.dense.pop_back();
+					return;
+				}
+				if (!ShouldBeDense(d.count + 1, degree))
+					ToSparse(d);
+				else {
+					d.dense.resize((size_t) degree + 1, C(0));
+					d.dense[degree] = coeff;
+					++d.count;
+					return;
+				}
+			}
+			uint32_t index = SparseIndex(d, degree);
+			if (index < d.degrees.size() && d.degrees[index] == degree) {
+				d.coeffs[index] = WrappingAdd(d.coeffs[index], coeff);
+				if (d.coeffs[index] == C(0)) {
+					d.degrees.erase(d.degrees.begin() + index);
+					d.coeffs.erase(d.coeffs.begin() + index);
+					--d.count;
+				}
+				return;
+			}
+			d.degrees.insert(d.degrees.begin() + index, degree);
+			d.coeffs.insert(d.coeffs.begin() + index, coeff);
+			++d.count;
+		}
+		// Appends a term with degree higher than every stored one. Only valid in sparse mode,
+		// meant for building results in order (Clear, PushBack..., Normalize)
+		void PushBack(uint64_t degree, C coeff) {
+			if (coeff == C(0)) return;
+			Data & d = Write();
+			d.degrees.push_back(degree);
+			d.coeffs.push_back(coeff);
+			++d.count;
+		}
+		// Hands the dense buffer out so its capacity can be reused, leaves storage empty
+		std::vector<C> ReleaseDense() {
+			std::vector<C> result;
+			if (data && data.use_count() == 1)
+				result = std::move(data->dense);
+			Clear();
+			return result;
+		}
+		// Replaces contents with dense coefficient array, trailing zeroes are allowed
+		void AssignDense(std::vector<C> && values) {
+			Data & d = Write();
+			d.degrees.clear();
+			d.coeffs.clear();
+			d.dense = std::move(values);
+			while (!d.dense.empty() && d.dense.back() == C(0)) d.dense.pop_back();
+			d.count = 0;
+			for (const C & value : d.dense)
+				if (value != C(0)) ++d.count;
+			d.dense_mode = true;
+			Normalize();
+		}
+		// Replaces contents with sorted sparse arrays without zero coefficients
+		void AssignSparse(std::vector<uint64_t> && new_degrees, std::vector<C> && new_coeffs) {
+			Data & d = Write();
+			d.dense.clear();
+			d.degrees = std::move(new_degrees);
+			d.coeffs = std::move(new_coeffs);
+			d.count = (uint32_t) d.degrees.size();
+			d.dense_mode = false;
+			Normalize();
+		}
+		// Same as AssignSparse but takes terms in any order, equal degrees are summed and zeros dropped
+		void AssignUnsorted(std::vector<uint64_t> && new_degrees, std::vector<C> && new_coeffs) {
+			uint32_t n = (uint32_t) new_degrees.size();
+			bool sorted = true;
+			for (uint32_t i = 1; i < n && sorted; ++i)
+				sorted = new_degrees[i - 1] < new_degrees[i];
+			if (!sorted) {
+				// Input is usually written from the highest degree down
+				bool descending = true;
+				for (uint32_t i = 1; i < n && descending; ++i)
+					descending = new_degrees[i - 1] > new_degrees[i];
+				if (descending) {
+					std::reverse(new_degrees.begin(), new_degrees.end());
+					std::reverse(new_coeffs.begin(), new_coeffs.end());
+				} else {
+					std::vector<uint32_t> order(n);
+					std::iota(order.begin(), order.end(), 0);
+					std::stable_sort(order.begin(), order.end(), [&new_degrees](uint32_t l, uint32_t r) {
+						return new_degrees[l] < new_degrees[r];
+					});
+					std::vector<uint64_t> sorted_degrees;
+					std::vector<C> sorted_coeffs;
+					sorted_degrees.reserve(n);
+					sorted_coeffs.reserve(n);
+					for (uint32_t i = 0; i < n; ++i) {
+						uint32_t j = order[i];
+						if (!sorted_degrees.empty() && sorted_degrees.back() == new_degrees[j])
+							sorted_coeffs.back() = WrappingAdd(sorted_coeffs.back(), new_coeffs[j]);
+						else {
+							sorted_degrees.push_back(new_degrees[j]);
+							sorted_coeffs.push_back(std::move(new_coeffs[j]));
+						}
+					}
+					new_degrees = std::move(sorted_degrees);
+					new_coeffs = std::move(sorted_coeffs);
+				}
+			}
+			uint32_t kept = 0;
+			for (uint32_t i = 0; i < new_degrees.size(); ++i) {
+				if (new_coeffs[i] == C(0)) continue;
+				if (kept != i) {
+					new_degrees[kept] = new_degrees[i];
+					new_coeffs[kept] = std::move(new_coeffs[i]);
+				}
+				++kept;
+			}
+			new_degrees.resize(kept);
+			new_coeffs.resize(kept, C(0));
+			AssignSparse(std::move(new_degrees), std::move(new_coeffs));
+		}
+		// Number of terms with degree up to max_degree
+		uint32_t TermsUpTo(uint64_t max_degree) const {
+			const Data & d = Read();
+			if (!d.dense_mode)
+				return (uint32_t) (std::upper_bound(d.degrees.begin(), d.degrees.end(), max_degree) - d.degrees.begin());
+			if (max_degree >= d.dense.size()) return d.count;
+			uint32_t result = 0;
+			for (uint64_t i = 0; i <= max_degree; ++i)
+				if (d.dense[i] != C(0)) ++result;
+			return result;
+		}
+		// Writes sorted non-zero terms with degree up to max_degree into two parallel arrays
+		void ToSparse(std::vector<uint64_t> & out_degrees, std::vector<C> & out_coeffs, uint64_t max_degree = UINT64_MAX) const {
+			const Data & d = Read();
+			if (!d.dense_mode) {
+				uint32_t count = TermsUpTo(max_degree);
+				out_degrees.assign(d.degrees.begin(), d.degrees.begin() + count);
+				out_coeffs.assign(d.coeffs.begin(), d.coeffs.begin() + count);
+				return;
+			}
+			out_degrees.clear();
+			out_coeffs.clear();
+			out_degrees.reserve(d.count);
+			out_coeffs.reserve(d.count);
+			for (Term term : *this) {
+				if (term.degree > max_degree) break;
+				out_degrees.push_back(term.degree);
+				out_coeffs.push_back(term.coeff);
+			}
+		}
+		// Writes coefficients up to max_degree into array indexed by degree,
+		// size is max degree + 1 (or max_degree + 1 if that's smaller)
+		void ToDense(std::vector<C> & out, uint64_t max_degree = UINT64_MAX) const {
+			const Data & d = Read();
+			if (d.dense_mode) {
+				if (max_degree >= d.dense.size())
+					out = d.dense;
+				else
+					out.assign(d.dense.begin(), d.dense.begin() + max_degree + 1);
+				return;
+			}
+			uint32_t count = TermsUpTo(max_degree);
+			out.assign(count ? DenseLength<C>(d.degrees[count - 1]) : 0, C(0));
+			for (uint32_t i = 0; i < count; ++i)
+				out[d.degrees[i]] = d.coeffs[i];
+		}
+		// Picks representation by fill ratio
+		void Normalize() {
+			if (!Read().count) {
+				Clear();
+				return;
+			}
+			bool should_be_dense = ShouldBeDense(Read().count, Back().degree);
+			if (should_be_dense == Read().dense_mode) return;
+			Data & d = Write();
+			if (should_be_dense) ToDense(d);
+			else ToSparse(d);
+		}
+	};
+
+	// Multiplication engine. Everything below works on plain coefficient arrays,
+	// Polynomial picks the algorithm by size and density of its operands
+
+	static constexpr uint32_t KARATSUBA_THRESHOLD = 32;
+	static constexpr uint32_t NTT_THRESHOLD = 4096;
+
+	// res has to hold n + m - 1 zeroes
+	template<typename T>
+	void MultiplySchoolbook(const T *a, uint32_t n, const T *b, uint32_t m, T *res) {
+		CheckCancellation();
+		for (uint32_t i = 0; i < n; ++i) {
+			// long rows come from unbalanced operands, small blocks only check once
+			if (m >= 1024) CheckCancellation();
+			if (a[i] == T(0)) continue;
+			for (uint32_t j = 0; j < m; ++j)
+				res[i + j] += a[i] * b[j];
+		}
+	}
+
+	// Only the lowest length coefficients of the product, res has to hold length zeroes
+	template<typename T>
+	void MultiplySchoolbookTruncated(const T *a, uint32_t n, const T *b, uint32_t m, T *res, uint32_t length) {
+		CheckCancellation();
+		n = std::min(n, length);
+		for (uint32_t i = 0; i < n; ++i) {
+			if (m >= 1024) CheckCancellation();
+			if (a[i] == T(0)) continue;
+			uint32_t end = std::min(m, length - i);
+			for (uint32_t j = 0; j < end; ++j)
+				res[i + j] += a[i] * b[j];
+		}
+	}
+
+	// Both operands have length n, res has to hold 2n zeroes
+	template<typename T>
+	void MultiplyKaratsubaBalanced(const T *a, const T *b, uint32_t n, T *res) {
+		if (n <= KARATSUBA_THRESHOLD) {
+			MultiplySchoolbook(a, n, b, n, res);
+			return;
+		}
+		// a = a0 + x^k * a1, where a0 has k coefficients and a1 has h >= k
+		uint32_t k = n / 2, h = n - k;
+		std::vector<T> z0(2 * k, T(0)), z1(2 * h, T(0)), z2(2 * h, T(0));
+		std::vector<T> a_sum(a + k, a + n), b_sum(b + k, b + n);
+		for (uint32_t i = 0; i < k; ++i) {
+			a_sum[i] += a[i];
+			b_sum[i] += b[i];
+		}
+		MultiplyKaratsubaBalanced(a, b, k, z0.data());
+		MultiplyKaratsubaBalanced(a + k, b + k, h, z2.data());
+		MultiplyKaratsubaBalanced(a_sum.data(), b_sum.data(), h, z1.data());
+		for (uint32_t i = 0; i < 2 * k; ++i) {
+			z1[i] -= z0[i];
+			res[i] += z0[i];
+		}
+		for (uint32_t i = 0; i < 2 * h; ++i) {
+			z1[i] -= z2[i];
+			res[2 * k + i] += z2[i];
+		}
+		for (uint32_t i = 0; i < 2 * h; ++i)
+			res[k + i] += z1[i];
+	}
+
+	// Lowest n coefficients of the product of two length n operands, res has to hold n zeroes.
+	// a0 * b0 is a full product, the cross terms a1 * b0 and a0 * b1 are only needed modulo x^h,
+	// and a1 * b1 not at all. With the split at 0.7n (Mulders) it's about 0.8 of the full Karatsuba,
+	// at n/2 it wouldn't save anything
+	template<typename T>
+	void MultiplyKaratsubaLow(const T *a, const T *b, uint32_t n, T *res) {
+		if (n <= KARATSUBA_THRESHOLD) {
+			MultiplySchoolbookTruncated(a, n, b, n, res, n);
+			return;
+		}
+		// a = a0 + x^k * a1, where a0 has k coefficients and a1 has h < k
+		uint32_t k = (uint32_t) (((uint64_t) n * 7 + 9) / 10), h = n - k;
+		std::vector<T> z0(2 * k, T(0)), cross(h, T(0));
+		MultiplyKaratsubaBalanced(a, b, k, z0.data());
+		for (uint32_t i = 0; i < n; ++i)
+			res[i] += z0[i];
+		MultiplyKaratsubaLow(a + k, b, h, cross.data());
+		MultiplyKaratsubaLow(a, b + k, h, cross.data());
+		for (uint32_t i = 0; i < h; ++i)
+			res[k + i] += cross[i];
+	}
+
+	// Longer operand is cut into pieces of the shorter one's length
+	template<typename T>
+	void MultiplyKaratsuba(const std::vector<T> & a, const std::vector<T> & b, std::vector<T> & res) {
+		if (a.size() < b.size()) {
+			MultiplyKaratsuba(b, a, res);
+			return;
+		}
+		uint32_t n = (uint32_t) a.size(), m = (uint32_t) b.size();
+		res.assign(n + m - 1, T(0));
+		std::vector<T> chunk(m), product(2 * m);
+		for (uint32_t offset = 0; offset < n; offset += m) {
+			uint32_t len = std::min(m, n - offset);
+			std::fill(std::copy(a.begin() + offset, a.begin() + offset + len, chunk.begin()), chunk.end(), T(0));
+			std::fill(product.begin(), product.end(), T(0));
+			MultiplyKaratsubaBalanced(chunk.data(), b.data(), m, product.data());
+			for (uint32_t i = 0; i < 2 * m && offset + i < res.size(); ++i)
+				res[offset + i] += product[i];
+		}
+	}
+
+	// Number-theoretic transform modulo an NTT-friendly prime MOD = c * 2^k + 1 with primitive root ROOT
+	template<uint32_t MOD, uint32_t ROOT>
+	struct NTTPrime {
+		static constexpr uint32_t Mod = MOD;
+		static uint32_t Power(uint64_t a, uint64_t p) {
+			uint64_t result = 1;
+			a %= MOD;
+			while (p) {
+				if (p & 1) result = result * a % MOD;
+				a = a * a % MOD;
+				p >>= 1;
+			}
+			return (uint32_t) result;
+		}
+		// Largest supported transform length
+		static constexpr uint32_t MaxLength() {
+			uint32_t length = 1;
+			while ((MOD - 1) % ((uint64_t) length * 2) == 0) length *= 2;
+			return length;
+		}
+		static void Transform(std::vector<uint32_t> & a, bool invert) {
+			uint32_t n = (uint32_t) a.size();
+			for (uint32_t i = 1, j = 0; i < n; ++i) {
+				uint32_t bit = n >> 1;
+				for (; j & bit; bit >>= 1)
+					j ^= bit;
+				j ^= bit;
+				if (i < j) std::swap(a[i], a[j]);
+			}
+			for (uint32_t len = 2; len <= n; len <<= 1) {
+				CheckCancellation();
+				uint64_t w_len = Power(ROOT, (MOD - 1) / len);
+				if (invert) w_len = Power(w_len, MOD - 2);
+				uint32_t half = len >> 1;
+				std::vector<uint32_t> w(half);
+				w[0] = 1;
+				for (uint32_t i = 1; i < half; ++i)
+					w[i] = (uint32_t) (w[i - 1] * w_len % MOD);
+				for (uint32_t i = 0; i < n; i += len) {
+					for (uint32_t j = 0; j < half; ++j) {
+						uint32_t u = a[i + j];
+						uint32_t v = (uint32_t) ((uint64_t) a[i + j + half] * w[j] % MOD);
+						a[i + j] = u + v < MOD ? u + v : u + v - MOD;
+						a[i + j + half] = u >= v ? u - v : u + MOD - v;
+					}
+				}
+			}
+			if (invert) {
+				uint64_t n_inv = Power(n, MOD - 2);
+				for (uint32_t & x : a)
+					x = (uint32_t) (x * n_inv % MOD);
+			}
+		}
+		// Cyclic product of a and b modulo MOD, length is a power of two
+		template<typename T>
+		static std::vector<uint32_t> Multiply(const std::vector<T> & a, const std::vector<T> & b, uint32_t length) {
+			std::vector<uint32_t> fa(length, 0), fb(length, 0);
+			for (uint32_t i = 0; i < a.size(); ++i)
+				fa[i] = Reduce(a[i]);
+			for (uint32_t i = 0; i < b.size(); ++i)
+				fb[i] = Reduce(b[i]);
+			Transform(fa, false);
+			Transform(fb, false);
+			for (uint32_t i = 0; i < length; ++i)
+				fa[i] = (uint32_t) ((uint64_t) fa[i] * fb[i] % MOD);
+			Transform(fa, true);
+			return fa;
+		}
+		template<typename T>
+		static uint32_t Reduce(T value) {
+			T residue = value % (T) MOD;
+			return (uint32_t) (residue < 0 ? residue + (T) MOD : residue);
+		}
+	};
+	using NTTPrime1 = NTTPrime<998244353, 3>;
+	using NTTPrime2 = NTTPrime<167772161, 3>;
+	using NTTPrime3 = NTTPrime<469762049, 3>;
+
+	// Exact product of signed integer arrays: three NTTs recombined with CRT (Garner's algorithm).
+	// Result coefficients are exact as long as their absolute value is below 2^85,
+	// which holds for 32-bit inputs of any length the transform supports.
+	// Every exact coefficient is passed through narrow to get the result type.
+	// Returns false if the product is too long for the transform
+	template<typename T, typename R, typename Narrow>
+	bool MultiplyNTT(const std::vector<T> & a, const std::vector<T> & b, std::vector<R> & res, Narrow narrow) {
+		uint32_t result_size = (uint32_t) (a.size() + b.size() - 1);
+		uint32_t length = 1;
+		while (length < result_size) length <<= 1;
+		if (length > NTTPrime1::MaxLength()) return false;
+		std::vector<uint32_t> r1 = NTTPrime1::Multiply(a, b, length);
+		std::vector<uint32_t> r2 = NTTPrime2::Multiply(a, b, length);
+		std::vector<uint32_t> r3 = NTTPrime3::Multiply(a, b, length);
+		constexpr uint64_t m1 = NTTPrime1::Mod, m2 = NTTPrime2::Mod, m3 = NTTPrime3::Mod;
+		const uint64_t m1_inv_m2 = NTTPrime2::Power(m1, m2 - 2);
+		const uint64_t m12_inv_m3 = NTTPrime3::Power(m1 * m2 % m3, m3 - 2);
+		const unsigned __int128 m12 = (unsigned __int128) m1 * m2;
+		const unsigned __int128 m123 = m12 * m3;
+		res.resize(result_size);
+		for (uint32_t i = 0; i < result_size; ++i) {
+			uint64_t x1 = r1[i];
+			uint64_t x2 = (r2[i] + m2 - x1 % m2) % m2 * m1_inv_m2 % m2;
+			uint64_t x3 = (r3[i] + m3 - (x1 + x2 * m1) % m3) % m3 * m12_inv_m3 % m3;
+			unsigned __int128 value = x1 + (unsigned __int128) x2 * m1 + x3 * m12;
+			__int128 signed_value = value > m123 / 2 ? -(__int128) (m123 - value) : (__int128) value;
+			res[i] = narrow(signed_value);
+		}
+		return true;
+	}
+
+	// Number of significant bits of the largest absolute value in the array
+	template<typename T>
+	uint32_t MaxBitLength(const std::vector<T> & a) {
+		using W = typename WrappingType<T>::type;
+		W max = 0;
+		for (const T & x : a) {
+			W magnitude = x < 0 ? W(0) - W(x) : W(x);
+			if (magnitude > max) max = magnitude;
+		}
+		uint32_t bits = 0;
+		for (; max; max >>= 1) ++bits;
+		return bits;
+	}
+	template<typename T>
+	bool FitsNTT(const std::vector<T> & a, const std::vector<T> & b) {
+		uint32_t length_bits = 0;
+		for (size_t n = std::min(a.size(), b.size()); n; n >>= 1) ++length_bits;
+		return MaxBitLength(a) + MaxBitLength(b) + length_bits <= 84;
+	}
+
+	// Per coefficient ring operations Polynomial needs besides + - *.
+	// Types without a specialization (BigInt, Zp) provide them as members.
+	// MultiplyFast is the hook for transform based multiplication, it returns false if it can't be used
+	template<typename C, typename = void>
+	struct CoefficientTraits {
+		static bool IsNegative(const C & c) {
+			return c.IsNegative();
+		}
+		static C Abs(const C & c) {
+			return c.Abs();
+		}
+		static std::string ToString(const C & c) {
+			return c.ToString();
+		}
+		static BigInt ToBigInt(const C & c) {
+			if constexpr (std::is_same<C, BigInt>::value)
+				return c;
+			else
+				return BigInt(static_cast<int64_t>(c));
+		}
+		static bool MultiplyFast(const std::vector<C> &, const std::vector<C> &, std::vector<C> &) {
+			return false;
+		}
+		static uint64_t Hash(const C & c) {
+			return c.Hash();
+		}
+		// Every non-zero element has an inverse
+		static constexpr bool IS_FIELD = std::is_same<C, Rational>::value;
+		// quotient = a / b if b divides a in the ring
+		static bool DivideExact(const C & a, const C & b, C & quotient) {
+			if (b == C(0)) return false;
+			if constexpr (std::is_same<C, BigInt>::value) {
+				BigInt remainder;
+				BigInt::DivMod(a, b, quotient, remainder);
+				return remainder.IsZero();
+			} else {
+				quotient = a / b;
+				return true;
+			}
+		}
+		static C FromBigInt(const BigInt & c) {
+			return C(c);
+		}
+		// Binary format: tag identifies the ring in file headers
+		static constexpr uint64_t BINARY_TAG = C::BINARY_TAG;
+		static void Encode(const C & c, ByteWriter & writer) {
+			c.Encode(writer);
+		}
+		static bool Decode(ByteReader & reader, C & c) {
+			return c.Decode(reader);
+		}
+	};
+	template<typename C>
+	struct CoefficientTraits<C, std::enable_if_t<std::is_integral<C>::value>> {
+		static bool IsNegative(C c) {
+			return c < 0;
+		}
+		static C Abs(C c) {
+			return c < 0 ? -c : c;
+		}
+		static std::string ToString(C c) {
+			return std::to_string(c);
+		}
+		static BigInt ToBigInt(C c) {
+			return BigInt((int64_t) c);
+		}
+		static bool MultiplyFast(const std::vector<C> & a, const std::vector<C> & b, std::vector<C> & res) {
+			if (!FitsNTT(a, b)) return false;
+			return MultiplyNTT(a, b, res, [](Int128 value) { return (C) value; });
+		}
+		static uint64_t Hash(C c) {
+			return HashMix((uint64_t) c);
+		}
+		static constexpr bool IS_FIELD = false;
+		static bool DivideExact(C a, C b, C & quotient) {
+			if (!b) return false;
+			// a / -1 overflows for the minimum value, negation wraps instead
+			if (std::is_signed<C>::value && b == (C) -1) {
+				quotient = (C) (0 - (std::make_unsigned_t<C>) a);
+				return true;
+			}
+			if (a % b) return false;
+			quotient = a / b;
+			return true;
+		}
+		// Wraps like the fixed width arithmetic does
+		static C FromBigInt(const BigInt & c) {
+			return (C) (int64_t) c;
+		}
+		static constexpr uint64_t BINARY_TAG = (uint64_t) 1 << 32 | sizeof(C) << 1 | (std::is_signed<C>::value ? 1 : 0);
+		static void Encode(C c, ByteWriter & writer) {
+			writer.WriteVarint(ZigZag((int64_t) c));
+		}
+		static bool Decode(ByteReader & reader, C & c) {
+			uint64_t value;
+			if (!reader.ReadVarint(value)) return false;
+			c = (C) UnZigZag(value);
+			return true;
+		}
+	};
+	template<>
+	struct CoefficientTraits<Int128> {
+		static bool IsNegative(Int128 c) {
+			return c < 0;
+		}
+		static Int128 Abs(Int128 c) {
+			return c < 0 ? -c : c;
+		}
+		static std::string ToString(Int128 c) {
+			if (!c) return "0";
+			unsigned __int128 magnitude = c < 0 ? -(unsigned __int128) c : (unsigned __int128) c;
+			std::string result;
+			for (; magnitude; magnitude /= 10)
+				result.push_back((char) ('0' + (uint32_t) (magnitude % 10)));
+			if (c < 0) result.push_back('-');
+			std::reverse(result.begin(), result.end());
+			return result;
+		}
+		static BigInt ToBigInt(Int128 c) {
+			unsigned __int128 magnitude = c < 0 ? -(unsigned __int128) c : (unsigned __int128) c;
+			BigInt result = 0;
+			for (int32_t shift = 96; shift >= 0; shift -= 32)
+				result = result * BigInt((int64_t) 1 << 32) + BigInt((int64_t) (uint32_t) (magnitude >> shift));
+			return c < 0 ? -result : result;
+		}
+		static bool MultiplyFast(const std::vector<Int128> & a, const std::vector<Int128> & b, std::vector<Int128> & res) {
+			if (!FitsNTT(a, b)) return false;
+			return MultiplyNTT(a, b, res, [](Int128 value) { return value; });
+		}
+		static uint64_t Hash(Int128 c) {
+			return HashMix((uint64_t) c ^ HashMix((uint64_t) ((unsigned __int128) c >> 64)));
+		}
+		static constexpr bool IS_FIELD = false;
+		static bool DivideExact(Int128 a, Int128 b, Int128 & quotient) {
+			if (!b) return false;
+			if (b == -1) {
+				quotient = (Int128) (0 - (unsigned __int128) a);
+				return true;
+			}
+			if (a % b) return false;
+			quotient = a / b;
+			return true;
+		}
+		static Int128 FromBigInt(const BigInt & c) {
+			return (Int128) c;
+		}
+		static constexpr uint64_t BINARY_TAG = (uint64_t) 2 << 32;
+		static void Encode(Int128 c, ByteWriter & writer) {
+			writer.WriteVarint(((unsigned __int128) c << 1) ^ (unsigned __int128) (c >> 127));
+		}
+		static bool Decode(ByteReader & reader, Int128 & c) {
+			unsigned __int128 value;
+			if (!reader.ReadVarint(value)) return false;
+			c = (Int128) (value >> 1) ^ -(Int128) (value & 1);
+			return true;
+		}
+	};
+	template<uint32_t P>
+	struct CoefficientTraits<Zp<P>> {
+		static bool IsNegative(const Zp<P> &) {
+			return false;
+		}
+		static Zp<P> Abs(const Zp<P> & c) {
+			return c;
+		}
+		static std::string ToString(const Zp<P> & c) {
+			return c.ToString();
+		}
+		static BigInt ToBigInt(const Zp<P> & c) {
+			return BigInt((int64_t) c.Value());
+		}
+		// NTT-friendly moduli need a single transform, others go through the three-prime CRT
+		// (residues are below 2^31, so the bound always holds)
+		static bool MultiplyFast(const std::vector<Zp<P>> & a, const std::vector<Zp<P>> & b, std::vector<Zp<P>> & res) {
+			std::vector<int64_t> wa(a.size()), wb(b.size());
+			for (uint32_t i = 0; i < a.size(); ++i)
+				wa[i] = a[i].Value();
+			for (uint32_t i = 0; i < b.size(); ++i)
+				wb[i] = b[i].Value();
+			if (P == NTTPrime1::Mod || P == NTTPrime2::Mod || P == NTTPrime3::Mod) {
+				uint32_t result_size = (uint32_t) (a.size() + b.size() - 1), length = 1;
+				while (length < result_size) length <<= 1;
+				std::vector<uint32_t> product;
+				if (P == NTTPrime1::Mod && length <= NTTPrime1::MaxLength())
+					product = NTTPrime1::Multiply(wa, wb, length);
+				else if (P == NTTPrime2::Mod && length <= NTTPrime2::MaxLength())
+					product = NTTPrime2::Multiply(wa, wb, length);
+				else if (P == NTTPrime3::Mod && length <= NTTPrime3::MaxLength())
+					product = NTTPrime3::Multiply(wa, wb, length);
+				else
+					return false;
+				res.resize(result_size);
+				for (uint32_t i = 0; i < result_size; ++i)
+					res[i] = Zp<P>(product[i]);
+				return true;
+			}
+			return MultiplyNTT(wa, wb, res, [](Int128 value) { return Zp<P>((int64_t) (value % P)); });
+		}
+		static uint64_t Hash(const Zp<P> & c) {
+			return HashMix(c.Value());
+		}
+		// P is prime
+		static constexpr bool IS_FIELD = true;
+		static bool DivideExact(const Zp<P> & a, const Zp<P> & b, Zp<P> & quotient) {
+			if (b == Zp<P>(0)) return false;
+			quotient = a * b.Inverse();
+			return true;
+		}
+		static Zp<P> FromBigInt(const BigInt & c) {
+			return Zp<P>((int64_t) c.Residue(P));
+		}
+		static constexpr uint64_t BINARY_TAG = (uint64_t) 3 << 32 | P;
+		static void Encode(const Zp<P> & c, ByteWriter & writer) {
+			writer.WriteVarint(c.Value());
+		}
+		static bool Decode(ByteReader & reader, Zp<P> & c) {
+			uint32_t value;
+			if (!reader.ReadVarint(value) || value >= P) return false;
+			c = Zp<P>((int64_t) value);
+			return true;
+		}
+	};
+	template<typename C>
+	std::string CoefficientToString(const C & c) {
+		return CoefficientTraits<C>::ToString(c);
+	}
+
+	// Picks schoolbook, Karatsuba or NTT by operand sizes, both operands must be non-empty
+	template<typename T>
+	void MultiplyDense(const std::vector<T> & a, const std::vector<T> & b, std::vector<T> & res) {
+		using W = typename WrappingType<T>::type;
+		uint32_t shorter = (uint32_t) std::min(a.size(), b.size());
+		if (a.size() + b.size() > NTT_THRESHOLD && shorter > KARATSUBA_THRESHOLD
+			&& CoefficientTraits<T>::MultiplyFast(a, b, res))
+			return;
+		auto multiply = [shorter](const std::vector<W> & wa, const std::vector<W> & wb, std::vector<W> & wres) {
+			if (shorter <= KARATSUBA_THRESHOLD) {
+				wres.assign(wa.size() + wb.size() - 1, W(0));
+				MultiplySchoolbook(wa.data(), (uint32_t) wa.size(), wb.data(), (uint32_t) wb.size(), wres.data());
+			} else {
+				MultiplyKaratsuba(wa, wb, wres);
+			}
+		};
+		if constexpr (std::is_same<W, T>::value) {
+			multiply(a, b, res);
+		} else {
+			std::vector<W> wa(a.begin(), a.end()), wb(b.begin(), b.end()), wres;
+			multiply(wa, wb, wres);
+			res.assign(wres.begin(), wres.end());
+		}
+	}
+
+	// Lowest length coefficients of the product, operands must be non-empty and not longer than length.
+	// Transforms can't skip the high half, so they compute everything and the result is cut
+	template<typename T>
+	void MultiplyDenseTruncated(const std::vector<T> & a, const std::vector<T> & b, uint32_t length, std::vector<T> & res) {
+		using W = typename WrappingType<T>::type;
+		uint32_t shorter = (uint32_t) std::min(a.size(), b.size());
+		// Truncation saves little when the full product is barely longer than the window
+		if (a.size() + b.size() - 1 <= length || shorter * 2 < length
+			|| (a.size() + b.size() > NTT_THRESHOLD && shorter > KARATSUBA_THRESHOLD)) {
+			MultiplyDense(a, b, res);
+			if (res.size() > length)
+				res.resize(length);
+			return;
+		}
+		auto multiply = [shorter, length](std::vector<W> & wa, std::vector<W> & wb, std::vector<W> & wres) {
+			wres.assign(length, W(0));
+			if (shorter <= KARATSUBA_THRESHOLD) {
+				MultiplySchoolbookTruncated(wa.data(), (uint32_t) wa.size(), wb.data(), (uint32_t) wb.size(), wres.data(), length);
+			} else {
+				wa.resize(length, W(0));
+				wb.resize(length, W(0));
+				MultiplyKaratsubaLow(wa.data(), wb.data(), length, wres.data());
+			}
+		};
+		std::vector<W> wa(a.begin(), a.end()), wb(b.begin(), b.end()), wres;
+		multiply(wa, wb, wres);
+		res.assign(wres.begin(), wres.end());
+	}
+
+	// Division switches from the long one to Newton's reciprocal when both the quotient and the divisor are this long
+	static constexpr uint32_t NEWTON_DIVISION_THRESHOLD = 128;
+
+	// Inverse of the power series f modulo x^length by Newton's iteration g = g * (2 - f * g),
+	// every step doubles the number of correct coefficients. inverse is the inverse of f[0]
+	template<typename T>
+	void InverseSeries(const std::vector<T> & f, const T & inverse, uint32_t length, std::vector<T> & g) {
+		using W = typename WrappingType<T>::type;
+		g.assign(1, inverse);
+		std::vector<T> head, error, product;
+		for (uint32_t current = 1; current < length;) {
+			uint32_t next = (uint32_t) std::min<uint64_t>((uint64_t) current * 2, length);
+			head.assign(f.begin(), f.begin() + std::min<size_t>(f.size(), next));
+			MultiplyDenseTruncated(head, g, next, error);
+			error.resize(next, T(0));
+			// error = 2 - f * g, wrapping like the products do
+			for (T & c : error)
+				c = (T) -(W) c;
+			error[0] = (T) ((W) error[0] + (W) 2);
+			MultiplyDenseTruncated(g, error, next, product);
+			g.swap(product);
+			g.resize(next, T(0));
+			current = next;
+		}
+	}
+
+	// low (low + 1) ... high, the range is halved so the big multiplications are balanced. 1 for an empty range
+	inline BigInt ProductOfRange(uint64_t low, uint64_t high) {
+		if (low > high) return BigInt(1);
+		if (high - low < 16) {
+			// high may be UINT64_MAX, so the loop stops at it instead of stepping past it
+			BigInt result(1);
+			for (uint64_t i = low;; ++i) {
+				result = result * BigInt::FromUnsigned(i);
+				if (i == high) break;
+			}
+			return result;
+		}
+		uint64_t middle = low + (high - low) / 2;
+		return ProductOfRange(low, middle) * ProductOfRange(middle + 1, high);
+	}
+
+	// Products low (low + 1) ... (low + n - 1) of n consecutive integers for increasing low. The next low
+	// reuses the previous product with one multiplication and one exact division, others are multiplied out
+	class ConsecutiveProducts {
+	private:
+		uint32_t n;
+		uint64_t low = 0;
+		BigInt product;
+	public:
+		explicit ConsecutiveProducts(uint32_t n): n(n) {}
+		const BigInt & From(uint64_t new_low) {
+			if (n && low && new_low == low + 1)
+				product = product * BigInt::FromUnsigned(low + n) / BigInt::FromUnsigned(low);
+			else
+				product = n ? ProductOfRange(new_low, new_low + n - 1) : BigInt(1);
+			low = new_low;
+			return product;
+		}
+	};
+
+	// c d (d - 1) ... (d - n + 1) for degrees d >= n in increasing order. Exact types take the product from
+	// ConsecutiveProducts, the others multiply in their wrapping arithmetic and stop once the product is zero,
+	// which for fixed width types happens within 2 * bits factors (n consecutive factors have at least n / 2 twos)
+	template<typename T>
+	class FallingFactorials {
+	private:
+		using W = typename WrappingType<T>::type;
+		static constexpr bool EXACT = std::is_same<T, BigInt>::value || std::is_same<T, Rational>::value;
+
+		uint32_t n;
+		ConsecutiveProducts products;
+	public:
+		explicit FallingFactorials(uint32_t n): n(n), products(n) {}
+		T Times(const T & c, uint64_t d) {
+			if constexpr (EXACT) {
+				return c * T(products.From(d - n + 1));
+			} else {
+				W result = (W) c;
+				for (uint32_t i = 0; i < n && result != W(0); ++i)
+					result = result * W(d - i);
+				return (T) result;
+			}
+		}
+		// values[i] times the falling factorial of first + i. Fixed width and modular types go in blocks that stay
+		// in cache, with a pass over the block per factor so the passes vectorize. Fixed width ones need at most 2 * bits passes
+		void TimesAll(std::vector<T> & values, uint64_t first) {
+			if constexpr (EXACT) {
+				for (size_t i = 0; i < values.size(); ++i) {
+					if (!(i & 255)) CheckCancellation();
+					values[i] = Times(values[i], first + i);
+				}
+			} else {
+				uint32_t passes = n;
+				if constexpr (std::is_integral<W>::value || std::is_same<W, unsigned __int128>::value) {
+					if (n >= 2 * 8 * sizeof(W)) {
+						values.assign(values.size(), T(0));
+						return;
+					}
+				}
+				// Groups of LANES with a fixed trip count are what gets vectorized, the block's tail is padded
+				constexpr size_t BLOCK = 1024, LANES = 16;
+				W block[BLOCK];
+				for (size_t start = 0; start < values.size(); start += BLOCK) {
+					if (!(start & (64 * BLOCK - 1))) CheckCancellation();
+					size_t count = std::min(BLOCK, values.size() - start), padded = (count + LANES - 1) / LANES * LANES;
+					for (size_t i = 0; i < count; ++i)
+						block[i] = (W) values[start + i];
+					std::fill(block + count, block + padded, W(0));
+					for (uint32_t k = 0; k < passes; ++k) {
+						W factor = W(first + start - k);
+						for (size_t group = 0; group < padded; group += LANES) {
+							for (size_t lane = 0; lane < LANES; ++lane)
+								block[group + lane] = block[group + lane] * (factor + W(lane));
+							factor = factor + W(LANES);
+						}
+					}
+					for (size_t i = 0; i < count; ++i)
+						values[start + i] = (T) block[i];
+				}
+			}
+		}
+	};
+
+	// Remainder of a modulo the monic b, in place. Long division for short operands, otherwise
+	// the quotient comes from the reciprocal of the reversed b, same as in Divide
+	template<typename T>
+	void ReduceMonic(std::vector<T> & a, const std::vector<T> & b) {
+		using W = typename WrappingType<T>::type;
+		uint32_t m = (uint32_t) b.size() - 1;
+		if (a.size() <= m) return;
+		uint32_t k = (uint32_t) a.size() - m;
+		if (std::min(k, m) < NEWTON_DIVISION_THRESHOLD) {
+			for (uint32_t i = k; i-- > 0;) {
+				W factor = (W) a[i + m];
+				if (factor == W(0)) continue;
+				for (uint32_t j = 0; j < m; ++j)
+					a[i + j] = (T) ((W) a[i + j] - factor * (W) b[j]);
+			}
+			a.resize(m);
+			return;
+		}
+		std::vector<T> reversed_a(a.rbegin(), a.rbegin() + k), reversed_b(b.rbegin(), b.rbegin() + std::min<size_t>(b.size(), k));
+		std::vector<T> reciprocal, q, product;
+		InverseSeries(reversed_b, T(1), k, reciprocal);
+		MultiplyDenseTruncated(reversed_a, reciprocal, k, q);
+		q.resize(k, T(0));
+		std::reverse(q.begin(), q.end());
+		// Only the lowest m coefficients of b * q matter
+		q.resize(std::min(k, m));
+		std::vector<T> low_b(b.begin(), b.begin() + m);
+		MultiplyDenseTruncated(low_b, q, m, product);
+		product.resize(m, T(0));
+		a.resize(m);
+		for (uint32_t i = 0; i < m; ++i)
+			a[i] = (T) ((W) a[i] - (W) product[i]);
+	}
+
+	// Below this many points Horner's scheme at every point is faster than the tree
+	static constexpr uint32_t SUBPRODUCT_TREE_THRESHOLD = 1024;
+
+	// Products of (x - points[i]) over ranges of points. Level 0 holds the linear factors, every next level
+	// multiplies neighbours (an odd one out goes up as is), so node i of level l covers points [i * 2^l, (i + 1) * 2^l).
+	// Evaluation goes down the tree taking remainders by nodes, interpolation goes up combining with them,
+	// both are O(M(n) log n) where M(n) is the cost of a product
+	template<typename T>
+	class SubproductTree {
+	private:
+		using W = typename WrappingType<T>::type;
+		// Remainders aren't taken by nodes this small, their points are evaluated directly
+		static constexpr uint32_t LEAF_LEVEL = 4;
+
+		std::vector<T> points;
+		std::vector<std::vector<std::vector<T>>> levels;
+	public:
+		explicit SubproductTree(std::vector<T> points): points(std::move(points)) {
+			if (this->points.empty())
+				throw std::invalid_argument("Subproduct tree needs at least one point.");
+			levels.emplace_back();
+			for (const T & x : this->points)
+				levels[0].push_back({ (T) -(W) x, T(1) });
+			while (levels.back().size() > 1) {
+				CheckCancellation();
+				const std::vector<std::vector<T>> & below = levels.back();
+				std::vector<std::vector<T>> level((below.size() + 1) / 2);
+				for (size_t i = 0; i + 1 < below.size(); i += 2)
+					MultiplyDense(below[i], below[i + 1], level[i / 2]);
+				if (below.size() & 1)
+					level.back() = below.back();
+				levels.push_back(std::move(level));
+			}
+		}
+		uint32_t Size() const {
+			return (uint32_t) points.size();
+		}
+		// Product of all (x - points[i])
+		const std::vector<T> & Product() const {
+			return levels.back()[0];
+		}
+		// Values of a at every point, a can be of any degree
+		std::vector<T> Evaluate(std::vector<T> a) const {
+			ReduceMonic(a, Product());
+			uint32_t leaf_level = std::min<uint32_t>(LEAF_LEVEL, (uint32_t) levels.size() - 1);
+			std::vector<std::vector<T>> remainders(1), next;
+			remainders[0] = std::move(a);
+			for (uint32_t level = (uint32_t) levels.size() - 1; level-- > leaf_level;) {
+				CheckCancellation();
+				const std::vector<std::vector<T>> & nodes = levels[level];
+				next.assign(nodes.size(), std::vector<T>());
+				for (size_t i = 0; i < nodes.size(); ++i) {
+					// the second child is the last one to need its parent's remainder
+					next[i] = (i & 1) ? std::move(remainders[i / 2]) : remainders[i / 2];
+					ReduceMonic(next[i], nodes[i]);
+				}
+				remainders.swap(next);
+			}
+			std::vector<T> values(points.size());
+			for (size_t i = 0; i < points.size(); ++i) {
+				const std::vector<T> & r = remainders[i >> leaf_level];
+				W value = 0;
+				for (size_t j = r.size(); j-- > 0;)
+					value = value * (W) points[i] + (W) r[j];
+				values[i] = (T) value;
+			}
+			return values;
+		}
+		// Polynomial of degree below Size() taking values[i] at points[i], by Lagrange's formula
+		// sum of values[i] / M'(points[i]) * M(x) / (x - points[i]) where M is the product: the weights come
+		// from evaluating M', the sum is built bottom up. False if some weight isn't exact in T.
+		// Throws std::invalid_argument when points repeat
+		bool Interpolate(const std::vector<T> & values, std::vector<T> & res) const {
+			if (values.size() != points.size())
+				throw std::invalid_argument("Interpolation needs as many values as points.");
+			const std::vector<T> & product = Product();
+			std::vector<T> derivative(product.size() - 1);
+			for (uint32_t i = 1; i < product.size(); ++i)
+				derivative[i - 1] = (T) ((W) product[i] * W(i));
+			std::vector<T> weights = Evaluate(std::move(derivative));
+			std::vector<std::vector<T>> sums(points.size()), next;
+			for (size_t i = 0; i < points.size(); ++i) {
+				if (weights[i] == T(0))
+					throw std::invalid_argument("Interpolation points have to be distinct.");
+				sums[i].resize(1);
+				if (!CoefficientTraits<T>::DivideExact(values[i], weights[i], sums[i][0]))
+					return false;
+			}
+			std::vector<T> left, right;
+			for (size_t level = 0; level + 1 < levels.size(); ++level) {
+				CheckCancellation();
+				const std::vector<std::vector<T>> & nodes = levels[level];
+				next.assign((nodes.size() + 1) / 2, std::vector<T>());
+				for (size_t i = 0; i + 1 < nodes.size(); i += 2) {
+					MultiplyDense(sums[i], nodes[i + 1], left);
+					MultiplyDense(sums[i + 1], nodes[i], right);
+					if (left.size() < right.size())
+						left.swap(right);
+					for (size_t j = 0; j < right.size(); ++j)
+						left[j] = (T) ((W) left[j] + (W) right[j]);
+					next[i / 2] = std::move(left);
+				}
+				if (nodes.size() & 1)
+					next.back() = std::move(sums.back());
+				sums.swap(next);
+			}
+			res = std::move(sums[0]);
+			return true;
+		}
+	};
+
+	// Sparse product as a k-way merge: every term of the shorter operand produces a stream
+	// of products sorted by degree, a heap keeps the streams' heads, so equal degrees come out together.
+	// The head is advanced in place and sifted down, one pass per product instead of a pop and a push.
+	// Streams are dropped once they pass max_degree. Throws std::overflow_error if the product's degree
+	// doesn't fit in 64 bits
+	template<typename T>
+	void MultiplySparse(const std::vector<uint64_t> & ld, const std::vector<T> & lc,
+						const std::vector<uint64_t> & rd, const std::vector<T> & rc,
+						std::vector<uint64_t> & res_degrees, std::vector<T> & res_coeffs, uint64_t max_degree = UINT64_MAX) {
+		if (ld.size() > rd.size()) {
+			MultiplySparse(rd, rc, ld, lc, res_degrees, res_coeffs, max_degree);
+			return;
+		}
+		res_degrees.clear();
+		res_coeffs.clear();
+		if (ld.empty()) return;
+		if (max_degree == UINT64_MAX && ld.back() > UINT64_MAX - rd.back())
+			throw std::overflow_error("Degree of the product doesn't fit in 64 bits.");
+		using W = typename WrappingType<T>::type;
+		struct Entry {
+			uint64_t degree;
+			uint32_t i, j;
+		};
+		// a + b <= max_degree without computing a + b
+		auto fits = [max_degree](uint64_t a, uint64_t b) {
+			return b <= max_degree && a <= max_degree - b;
+		};
+		std::vector<Entry> heap;
+		heap.reserve(ld.size());
+		// streams start sorted by degree, which already is a heap
+		for (uint32_t i = 0; i < ld.size(); ++i)
+			if (fits(ld[i], rd[0]))
+				heap.push_back(Entry{ ld[i] + rd[0], i, 0 });
+		auto sift_down = [&heap]() {
+			size_t pos = 0, size = heap.size();
+			Entry entry = heap[0];
+			for (size_t child = 1; child < size; child = 2 * pos + 1) {
+				if (child + 1 < size && heap[child + 1].degree < heap[child].degree) ++child;
+				if (heap[child].degree >= entry.degree) break;
+				heap[pos] = heap[child];
+				pos = child;
+			}
+			heap[pos] = entry;
+		};
+		for (uint32_t steps = 0; !heap.empty(); ++steps) {
+			if (!(steps & 1023)) CheckCancellation();
+			uint64_t degree = heap[0].degree;
+			W sum = W(0);
+			do {
+				Entry & top = heap[0];
+				sum += (W) lc[top.i] * (W) rc[top.j];
+				if (++top.j < rd.size() && fits(ld[top.i], rd[top.j])) {
+					top.degree = ld[top.i] + rd[top.j];
+				} else {
+					top = heap.back();
+					heap.pop_back();
+				}
+				if (!heap.empty()) sift_down();
+			} while (!heap.empty() && heap[0].degree == degree);
+			if (sum != W(0)) {
+				res_degrees.push_back(degree);
+				res_coeffs.push_back((T) sum);
+			}
+		}
+	}
+	// Batch evaluation. Points are processed in blocks of EVAL_LANES independent accumulators,
+	// which the compiler keeps in vector registers, hand written AVX2/AVX-512 versions are used for double
+	// (and for int64_t with AVX-512DQ) when the build enables them. Remaining points are done one by one
+	static constexpr uint32_t EVAL_LANES = 8;
+
+	// coeffs[i] is the coefficient of x^i, count > 0
+	template<typename T>
+	void HornerMany(const T *coeffs, uint32_t count, const T *xs, T *out, size_t n) {
+		using W = typename WrappingType<T>::type;
+		size_t i = 0;
+		for (; i + EVAL_LANES <= n; i += EVAL_LANES) {
+			W acc[EVAL_LANES], x[EVAL_LANES];
+			for (uint32_t k = 0; k < EVAL_LANES; ++k) {
+				x[k] = W(xs[i + k]);
+				acc[k] = W(coeffs[count - 1]);
+			}
+			for (uint32_t d = count - 1; d-- > 0;) {
+				W c = W(coeffs[d]);
+				for (uint32_t k = 0; k < EVAL_LANES; ++k)
+					acc[k] = acc[k] * x[k] + c;
+			}
+			for (uint32_t k = 0; k < EVAL_LANES; ++k)
+				out[i + k] = T(acc[k]);
+		}
+		for (; i < n; ++i) {
+			W acc = W(coeffs[count - 1]), x = W(xs[i]);
+			for (uint32_t d = count - 1; d-- > 0;)
+				acc = acc * x + W(coeffs[d]);
+			out[i] = T(acc);
+		}
+	}
+#if defined(__AVX512F__) || defined(__AVX2__)
+	// Multiplication and addition are kept separate (no FMA), so results are bit-identical to the scalar loop
+	inline void HornerMany(const double *coeffs, uint32_t count, const double *xs, double *out, size_t n) {
+		size_t i = 0;
+#if defined(__AVX512F__)
+		for (; i + 8 <= n; i += 8) {
+			__m512d x = _mm512_loadu_pd(xs + i);
+			__m512d acc = _mm512_set1_pd(coeffs[count - 1]);
+			for (uint32_t d = count - 1; d-- > 0;)
+				acc = _mm512_add_pd(_mm512_mul_pd(acc, x), _mm512_set1_pd(coeffs[d]));
+			_mm512_storeu_pd(out + i, acc);
+		}
+#else
+		// two independent vectors per iteration to hide the latency of the dependency chain
+		for (; i + 8 <= n; i += 8) {
+			__m256d x0 = _mm256_loadu_pd(xs + i), x1 = _mm256_loadu_pd(xs + i + 4);
+			__m256d acc0 = _mm256_set1_pd(coeffs[count - 1]), acc1 = acc0;
+			for (uint32_t d = count - 1; d-- > 0;) {
+				__m256d c = _mm256_set1_pd(coeffs[d]);
+				acc0 = _mm256_add_pd(_mm256_mul_pd(acc0, x0), c);
+				acc1 = _mm256_add_pd(_mm256_mul_pd(acc1, x1), c);
+			}
+			_mm256_storeu_pd(out + i, acc0);
+			_mm256_storeu_pd(out + i + 4, acc1);
+		}
+#endif
+		for (; i < n; ++i) {
+			double acc = coeffs[count - 1];
+			for (uint32_t d = count - 1; d-- > 0;)
+				acc = acc * xs[i] + coeffs[d];
+			out[i] = acc;
+		}
+	}
+#endif
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+	inline void HornerMany(const int64_t *coeffs, uint32_t count, const int64_t *xs, int64_t *out, size_t n) {
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m512i x = _mm512_loadu_si512(xs + i);
+			__m512i acc = _mm512_set1_epi64(coeffs[count - 1]);
+			for (uint32_t d = count - 1; d-- > 0;)
+				acc = _mm512_add_epi64(_mm512_mullo_epi64(acc, x), _mm512_set1_epi64(coeffs[d]));
+			_mm512_storeu_si512(out + i, acc);
+		}
+		for (; i < n; ++i) {
+			uint64_t acc = (uint64_t) coeffs[count - 1];
+			for (uint32_t d = count - 1; d-- > 0;)
+				acc = acc * (uint64_t) xs[i] + (uint64_t) coeffs[d];
+			out[i] = (int64_t) acc;
+		}
+	}
+#endif
+
+	// Same for sparse polynomials: Horner's scheme over the gaps between degrees,
+	// so the work depends on the number of terms and not on the degree. Powers of every point are raised
+	// from one table of repeated squarings shared by all gaps (see PowerTable)
+	template<typename T>
+	void SparseHornerMany(const uint64_t *degrees, const T *coeffs, uint32_t count, const T *xs, T *out, size_t n) {
+		using W = typename WrappingType<T>::type;
+		uint64_t max_exponent = degrees[0];
+		for (uint32_t j = 1; j < count; ++j)
+			max_exponent = std::max(max_exponent, degrees[j] - degrees[j - 1]);
+		uint32_t levels = 1;
+		for (uint64_t e = max_exponent >> 1; e; e >>= 1) ++levels;
+		// squares[b * EVAL_LANES + k] is the k-th point to the power 2^b
+		std::vector<W> squares((size_t) levels * EVAL_LANES);
+		size_t i = 0;
+		for (; i + EVAL_LANES <= n; i += EVAL_LANES) {
+			W acc[EVAL_LANES], power[EVAL_LANES];
+			for (uint32_t k = 0; k < EVAL_LANES; ++k) {
+				squares[k] = W(xs[i + k]);
+				acc[k] = W(coeffs[count - 1]);
+			}
+			for (uint32_t b = 1; b < levels; ++b)
+				for (uint32_t k = 0; k < EVAL_LANES; ++k)
+					squares[b * EVAL_LANES + k] = squares[(b - 1) * EVAL_LANES + k] * squares[(b - 1) * EVAL_LANES + k];
+			auto raise = [&squares, &power](uint64_t e) {
+				for (uint32_t k = 0; k < EVAL_LANES; ++k)
+					power[k] = W(1);
+				for (uint32_t b = 0; e; ++b, e >>= 1)
+					if (e & 1)
+						for (uint32_t k = 0; k < EVAL_LANES; ++k)
+							power[k] *= squares[b * EVAL_LANES + k];
+			};
+			for (uint32_t j = count - 1; j-- > 0;) {
+				raise(degrees[j + 1] - degrees[j]);
+				W c = W(coeffs[j]);
+				for (uint32_t k = 0; k < EVAL_LANES; ++k)
+					acc[k] = acc[k] * power[k] + c;
+			}
+			raise(degrees[0]);
+			for (uint32_t k = 0; k < EVAL_LANES; ++k)
+				out[i + k] = T(acc[k] * power[k]);
+		}
+		for (; i < n; ++i) {
+			PowerTable<W> powers(W(xs[i]), max_exponent);
+			W acc = W(coeffs[count - 1]);
+			for (uint32_t j = count - 1; j-- > 0;)
+				acc = acc * powers.Power(degrees[j + 1] - degrees[j]) + W(coeffs[j]);
+			out[i] = T(acc * powers.Power(degrees[0]));
+		}
+	}
+
+	// Root finding.
+	// Integer roots: x^k is factored out first, candidates are divisors of the constant term
+	// within Cauchy's bound, they are filtered by precomputed root tables modulo small primes,
+	// then by evaluation modulo three large primes, and survivors are confirmed
+	// (and deflated to get multiplicities) by exact synthetic division.
+	// Real roots: Sturm sequence of the square-free part, bisection down to intervals with one root each
+	struct IntegerRoot {
+		int64_t value;
+		uint64_t multiplicity;
+	};
+	// Exactly one distinct real root lies in (left, right]
+	struct RootInterval {
+		Rational left, right;
+	};
+
+	inline uint64_t MulMod(uint64_t a, uint64_t b, uint64_t m) {
+		return (uint64_t) ((unsigned __int128) a * b % m);
+	}
+	inline uint64_t PowMod(uint64_t a, uint64_t p, uint64_t m) {
+		uint64_t result = 1 % m;
+		a %= m;
+		while (p) {
+			if (p & 1) result = MulMod(result, a, m);
+			a = MulMod(a, a, m);
+			p >>= 1;
+		}
+		return result;
+	}
+	// Deterministic Miller-Rabin for 64-bit numbers
+	inline bool IsPrime(uint64_t n) {
+		if (n < 2) return false;
+		for (uint64_t p : { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 })
+			if (n % p == 0) return n == p;
+		uint64_t d = n - 1;
+		uint32_t s = 0;
+		for (; !(d & 1); d >>= 1) ++s;
+		for (uint64_t a : { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 }) {
+			uint64_t x = PowMod(a, d, n);
+			if (x == 0 || x == 1 || x == n - 1) continue;
+			bool composite = true;
+			for (uint32_t i = 1; i < s && composite; ++i) {
+				x = MulMod(x, x, n);
+				if (x == n - 1) composite = false;
+			}
+			if (composite) return false;
+		}
+		return true;
+	}
+	// a + b mod m for a, b < m, without wrapping around 2^64
+	inline uint64_t AddMod(uint64_t a, uint64_t b, uint64_t m) {
+		return a >= m - b ? a - (m - b) : a + b;
+	}
+	// Pollard's rho with Brent's cycle detection, n is an odd composite.
+	// Differences are multiplied together and the gcd is taken once per BATCH steps,
+	// if the batch overshoots to n it's replayed one step at a time
+	inline uint64_t PollardRho(uint64_t n) {
+		static constexpr uint64_t BATCH = 128;
+		for (uint64_t c = 1;; ++c) {
+			auto f = [n, c](uint64_t x) { return AddMod(MulMod(x, x, n), c, n); };
+			uint64_t y = 2, x = 2, saved = 2, q = 1, d = 1;
+			for (uint64_t r = 1; d == 1; r <<= 1) {
+				x = y;
+				for (uint64_t i = 0; i < r; ++i)
+					y = f(y);
+				for (uint64_t k = 0; k < r && d == 1; k += BATCH) {
+					CheckCancellation();
+					saved = y;
+					for (uint64_t i = 0; i < std::min(BATCH, r - k); ++i) {
+						y = f(y);
+						q = MulMod(q, x > y ? x - y : y - x, n);
+					}
+					d = std::gcd(q, n);
+				}
+			}
+			if (d == n) {
+				do {
+					saved = f(saved);
+					d = std::gcd(x > saved ? x - saved : saved - x, n);
+				} while (d == 1);
+			}
+			if (d != n) return d;
+		}
+	}
+	inline void Factorize(uint64_t n, std::vector<uint64_t> & primes) {
+		if (n < 2) return;
+		for (uint64_t p : { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 }) {
+			while (n % p == 0) {
+				primes.push_back(p);
+				n /= p;
+			}
+		}
+		if (n < 2) return;
+		if (IsPrime(n)) {
+			primes.push_back(n);
+			return;
+		}
+		uint64_t d = PollardRho(n);
+		Factorize(d, primes);
+		Factorize(n / d, primes);
+	}
+	// All divisors not exceeding limit of the product of primes (with repeats), sorted
+	inline std::vector<uint64_t> Divisors(std::vector<uint64_t> primes, uint64_t limit) {
+		std::sort(primes.begin(), primes.end());
+		std::vector<uint64_t> result = { 1 };
+		for (uint32_t i = 0; i < primes.size();) {
+			uint32_t j = i;
+			while (j < primes.size() && primes[j] == primes[i]) ++j;
+			uint32_t current = (uint32_t) result.size();
+			for (uint32_t k = 0; k < current; ++k) {
+				uint64_t divisor = result[k];
+				for (uint32_t e = i; e < j; ++e) {
+					if (divisor > limit / primes[i]) break;
+					divisor *= primes[i];
+					result.push_back(divisor);
+				}
+			}
+			i = j;
+		}
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+	// All divisors of n not exceeding limit, sorted
+	inline std::vector<uint64_t> Divisors(uint64_t n, uint64_t limit) {
+		std::vector<uint64_t> primes;
+		Factorize(n, primes);
+		return Divisors(std::move(primes), limit);
+	}
+
+	// Dense polynomials with exact integer coefficients, [i] is the coefficient of x^i, no trailing zeros
+	using IntegerPolynomial = std::vector<BigInt>;
+
+	inline void TrimIntegerPolynomial(IntegerPolynomial & p) {
+		while (!p.empty() && p.back().IsZero()) p.pop_back();
+	}
+	inline IntegerPolynomial IntegerDerivative(const IntegerPolynomial & p) {
+		IntegerPolynomial result;
+		for (uint32_t i = 1; i < p.size(); ++i)
+			result.push_back(p[i] * BigInt((int64_t) i));
+		TrimIntegerPolynomial(result);
+		return result;
+	}
+	// Divides by the gcd of coefficients, leading coefficient is made positive
+	inline void MakePrimitive(IntegerPolynomial & p) {
+		if (p.empty()) return;
+		BigInt content = 0;
+		for (const BigInt & c : p) {
+			content = BigInt::Gcd(content, c);
+			if (content == BigInt(1)) break;
+		}
+		if (p.back().IsNegative()) content = -content;
+		if (content == BigInt(1)) return;
+		for (BigInt & c : p)
+			c = c / content;
+	}
+	// Positive multiple of the remainder of a divided by b, b is not zero.
+	// Every step multiplies by |lc(b)| so signs are preserved, which Sturm sequences need
+	inline IntegerPolynomial PseudoRemainder(IntegerPolynomial a, const IntegerPolynomial & b) {
+		BigInt lead = b.back().Abs();
+		bool lead_negative = b.back().IsNegative();
+		while (a.size() >= b.size()) {
+			CheckCancellation();
+			BigInt factor = lead_negative ? -a.back() : a.back();
+			uint32_t shift = (uint32_t) (a.size() - b.size());
+			for (BigInt & c : a)
+				c *= lead;
+			for (uint32_t i = 0; i < b.size(); ++i)
+				a[shift + i] -= factor * b[i];
+			TrimIntegerPolynomial(a);
+		}
+		return a;
+	}
+	// lc(b)^(deg a - deg b + 1) * a modulo b, the exact multiple subresultant sequences rely on
+	// (PseudoRemainder above skips steps when a coefficient cancels)
+	inline IntegerPolynomial FullPseudoRemainder(IntegerPolynomial a, const IntegerPolynomial & b) {
+		if (a.size() < b.size()) return a;
+		const BigInt & lead = b.back();
+		uint32_t m = (uint32_t) b.size() - 1;
+		for (uint32_t shift = (uint32_t) (a.size() - b.size()) + 1; shift-- > 0;) {
+			CheckCancellation();
+			BigInt factor = a.back();
+			a.pop_back();
+			for (BigInt & c : a)
+				c *= lead;
+			if (factor.IsZero()) continue;
+			for (uint32_t i = 0; i < m; ++i)
+				a[shift + i] -= factor * b[i];
+		}
+		TrimIntegerPolynomial(a);
+		return a;
+	}
+	// Primitive gcd with positive leading coefficient through the subresultant sequence:
+	// remainders are divided by known factors (g * h^delta) instead of their contents,
+	// which keeps coefficients polynomial in size without a gcd of coefficients at every step
+	inline IntegerPolynomial IntegerGcd(IntegerPolynomial a, IntegerPolynomial b) {
+		if (a.size() < b.size()) std::swap(a, b);
+		if (b.empty()) {
+			MakePrimitive(a);
+			return a;
+		}
+		MakePrimitive(a);
+		MakePrimitive(b);
+		BigInt g = 1, h = 1;
+		for (;;) {
+			uint32_t delta = (uint32_t) (a.size() - b.size());
+			IntegerPolynomial r = FullPseudoRemainder(a, b);
+			if (r.empty()) break;
+			if (r.size() == 1) {
+				b = IntegerPolynomial(1, BigInt(1));
+				break;
+			}
+			BigInt divisor = g;
+			for (uint32_t i = 0; i < delta; ++i)
+				divisor *= h;
+			for (BigInt & c : r)
+				c = c / divisor;
+			a = std::move(b);
+			b = std::move(r);
+			g = a.back();
+			// h = g^delta / h^(delta - 1)
+			if (delta == 1) {
+				h = g;
+			} else if (delta > 1) {
+				BigInt numerator = 1, denominator = 1;
+				for (uint32_t i = 0; i < delta; ++i)
+					numerator *= g;
+				for (uint32_t i = 1; i < delta; ++i)
+					denominator *= h;
+				h = numerator / denominator;
+			}
+		}
+		MakePrimitive(b);
+		return b;
+	}
+	// Integer polynomials by degree, for the ones with far apart degrees which can't be held densely
+	using SparseIntegerPolynomial = std::map<uint64_t, BigInt>;
+
+	inline void MakePrimitive(SparseIntegerPolynomial & p) {
+		if (p.empty()) return;
+		BigInt content = 0;
+		for (const auto & term : p) {
+			content = BigInt::Gcd(content, term.second);
+			if (content == BigInt(1)) break;
+		}
+		if (p.rbegin()->second.IsNegative()) content = -content;
+		if (content == BigInt(1)) return;
+		for (auto & term : p)
+			term.second = term.second / content;
+	}
+	// Remainder of c * a divided by b for some nonzero constant c, b is not zero. Every step only scales a
+	// by lc(b) / gcd(lc(b), lc(a)), the number of steps depends on the degrees, not on their gaps
+	inline SparseIntegerPolynomial SparsePseudoRemainder(SparseIntegerPolynomial a, const SparseIntegerPolynomial & b) {
+		uint64_t m = b.rbegin()->first;
+		const BigInt & lead = b.rbegin()->second;
+		for (uint64_t steps = 0; !a.empty() && a.rbegin()->first >= m; ++steps) {
+			if (!(steps & 255)) CheckCancellation();
+			auto top = std::prev(a.end());
+			uint64_t shift = top->first - m;
+			BigInt common = BigInt::Gcd(top->second, lead);
+			BigInt factor = top->second / common, scale = lead / common;
+			a.erase(top);
+			if (scale != BigInt(1))
+				for (auto & term : a)
+					term.second *= scale;
+			for (auto it = b.begin(); it->first != m; ++it) {
+				BigInt & c = a[shift + it->first];
+				c -= factor * it->second;
+				if (c.IsZero()) a.erase(shift + it->first);
+			}
+		}
+		return a;
+	}
+	// Exact quotient of a divided by b, b has to divide a over the integers
+	inline IntegerPolynomial IntegerDivideExact(IntegerPolynomial a, const IntegerPolynomial & b) {
+		if (a.size() < b.size()) return IntegerPolynomial();
+		IntegerPolynomial quotient(a.size() - b.size() + 1);
+		for (uint32_t i = (uint32_t) quotient.size(); i-- > 0;) {
+			quotient[i] = a[i + b.size() - 1] / b.back();
+			for (uint32_t j = 0; j < b.size(); ++j)
+				a[i + j] -= quotient[i] * b[j];
+		}
+		return quotient;
+	}
+	// Divides p by (x - r) with synthetic division from the lowest degree up,
+	// so intermediate values stay as small as the quotient's coefficients.
+	// Returns false if (x - r) doesn't divide p, r is not zero and p(0) is not zero
+	inline bool DivideByLinear(const IntegerPolynomial & p, int64_t r, IntegerPolynomial & quotient) {
+		if (p.size() < 2) return false;
+		BigInt root(r), q, rem;
+		quotient.assign(p.size() - 1, BigInt());
+		BigInt::DivMod(-p[0], root, q, rem);
+		if (!rem.IsZero()) return false;
+		quotient[0] = q;
+		for (uint32_t i = 1; i < quotient.size(); ++i) {
+			BigInt::DivMod(quotient[i - 1] - p[i], root, q, rem);
+			if (!rem.IsZero()) return false;
+			quotient[i] = q;
+		}
+		return quotient.back() == p.back();
+	}
+	// Sign of p(num / den), den > 0
+	inline int32_t SignAt(const IntegerPolynomial & p, const Rational & point) {
+		if (p.empty()) return 0;
+		// den^n * p(num / den) through homogenized Horner's scheme
+		const BigInt & num = point.Numerator(), & den = point.Denominator();
+		BigInt value = p.back(), den_power = 1;
+		for (uint32_t i = (uint32_t) p.size() - 1; i-- > 0;) {
+			den_power *= den;
+			value = value * num + p[i] * den_power;
+		}
+		return value.IsZero() ? 0 : value.IsNegative() ? -1 : 1;
+	}
+	inline uint32_t SignVariations(const std::vector<IntegerPolynomial> & sturm, const Rational & point) {
+		uint32_t variations = 0;
+		int32_t last = 0;
+		for (const IntegerPolynomial & p : sturm) {
+			int32_t sign = SignAt(p, point);
+			if (!sign) continue;
+			if (last && sign != last) ++variations;
+			last = sign;
+		}
+		return variations;
+	}
+	// Isolates distinct real roots, every interval contains exactly one of them
+	inline std::vector<RootInterval> IsolateRealRoots(const IntegerPolynomial & p) {
+		std::vector<RootInterval> result;
+		if (p.size() < 2) return result;
+		IntegerPolynomial square_free = IntegerDivideExact(p, IntegerGcd(p, IntegerDerivative(p)));
+		MakePrimitive(square_free);
+		std::vector<IntegerPolynomial> sturm = { square_free, IntegerDerivative(square_free) };
+		MakePrimitive(sturm.back());
+		while (sturm.back().size() > 1) {
+			IntegerPolynomial r = PseudoRemainder(sturm[sturm.size() - 2], sturm.back());
+			if (r.empty()) break;
+			for (BigInt & c : r)
+				c = -c;
+			// content is divided out without touching the sign
+			BigInt content = 0;
+			for (const BigInt & c : r)
+				content = BigInt::Gcd(content, c);
+			for (BigInt & c : r)
+				c = c / content;
+			sturm.push_back(std::move(r));
+		}
+		// Cauchy's bound: every root is below 1 + max|a_i| / |a_n| in absolute value
+		BigInt max = 0;
+		for (uint32_t i = 0; i + 1 < square_free.size(); ++i)
+			if (max < square_free[i].Abs()) max = square_free[i].Abs();
+		BigInt bound = max / square_free.back().Abs() + BigInt(2);
+		struct Interval {
+			Rational left, right;
+			uint32_t left_variations, right_variations;
+		};
+		std::vector<Interval> stack = { Interval{ Rational(-bound), Rational(bound),
+												  SignVariations(sturm, Rational(-bound)), SignVariations(sturm, Rational(bound)) } };
+		while (!stack.empty()) {
+			CheckCancellation();
+			Interval current = stack.back();
+			stack.pop_back();
+			uint32_t roots = current.left_variations - current.right_variations;
+			if (!roots) continue;
+			if (roots == 1) {
+				result.push_back(RootInterval{ current.left, current.right });
+				continue;
+			}
+			Rational middle = (current.left + current.right) * Rational(BigInt(1), BigInt(2));
+			uint32_t middle_variations = SignVariations(sturm, middle);
+			stack.push_back(Interval{ middle, current.right, middle_variations, current.right_variations });
+			stack.push_back(Interval{ current.left, middle, current.left_variations, middle_variations });
+		}
+		return result;
+	}
+
+	// Lacunary polynomials. If f = g + x^u h and u - deg g exceeds the bit length of |g|_1, then
+	// |g(r)| < |r^u h(r)| for every integer |r| >= 2 with h(r) != 0, so such roots of f are the common roots
+	// of g and h. The same goes for every (x d/dx)^j f, whose coefficients are c_i d_i^j, and a nonzero root
+	// of a polynomial with t terms has multiplicity below t, so with (t - 1) * bits(deg g) more bits
+	// of gap the multiplicity of a root in f is its least multiplicity over the blocks.
+	// Returns the first term of every block
+	inline std::vector<uint32_t> LacunaryBlocks(const std::vector<uint64_t> & degrees, const std::vector<BigInt> & coeffs) {
+		uint32_t count = (uint32_t) degrees.size();
+		std::vector<uint32_t> starts = { 0 };
+		BigInt norm = 0;
+		for (uint32_t i = 0; i + 1 < count; ++i) {
+			norm += coeffs[i].Abs();
+			uint64_t degree_bits = 0;
+			for (uint64_t d = degrees[i]; d; d >>= 1) ++degree_bits;
+			uint64_t bits = norm.BitLength() + (uint64_t) (count - 1) * degree_bits + 1;
+			if (degrees[i + 1] - degrees[i] > bits) starts.push_back(i + 1);
+		}
+		return starts;
+	}
+
+	// Whether the sparse polynomial vanishes at r != 0, exactly, degrees are sorted.
+	// Synthetic division by (x - r) from the lowest degree up, as in DivideByLinear, but without storing the quotient:
+	// its coefficients stay below the sum of |coeffs|, and over a run of zero coefficients the running value is only
+	// divided by r, so a run longer than its bit length can only be crossed by zero
+	inline bool VanishesAt(const std::vector<uint64_t> & degrees, const std::vector<BigInt> & coeffs, int64_t r) {
+		BigInt root(r), q, quotient, rem;
+		uint64_t root_bits = 0;
+		for (uint64_t magnitude = r < 0 ? 0 - (uint64_t) r : (uint64_t) r; magnitude; magnitude >>= 1) ++root_bits;
+		// q / r^steps, false if it isn't exact
+		auto divide = [&](uint64_t steps) {
+			if (q.IsZero() || !steps) return true;
+			if (root_bits == 1) {
+				if (r < 0 && (steps & 1)) q = -q;
+				return true;
+			}
+			// |r|^steps >= 2^(steps * (root_bits - 1)) > |q|
+			if (steps > q.BitLength() / (root_bits - 1)) return false;
+			for (; steps; --steps) {
+				BigInt::DivMod(q, root, quotient, rem);
+				if (!rem.IsZero()) return false;
+				q = std::move(quotient);
+			}
+			return true;
+		};
+		// q is the quotient coefficient of degree next - 1
+		uint64_t next = 0;
+		uint32_t top = (uint32_t) degrees.size() - 1;
+		for (uint32_t i = 0; i < top; ++i) {
+			if (!divide(degrees[i] - next)) return false;
+			BigInt::DivMod(q - coeffs[i], root, quotient, rem);
+			if (!rem.IsZero()) return false;
+			q = std::move(quotient);
+			next = degrees[i] + 1;
+		}
+		return divide(degrees[top] - next) && q == coeffs[top];
+	}
+
+	// Integer roots of a sparse polynomial with exact coefficients, degrees are sorted.
+	// Throws std::domain_error when the constant term can't be factored far enough to list the candidates
+	inline std::vector<IntegerRoot> FindIntegerRoots(std::vector<uint64_t> degrees, std::vector<BigInt> coeffs) {
+		// above this degree span quotients aren't built densely, candidates that pass the large primes
+		// are confirmed with VanishesAt, on (x d/dx)^j p for the multiplicity
+		static constexpr uint32_t DEFLATION_LIMIT = 1 << 20;
+		static constexpr uint32_t TRIAL_DIVISION_LIMIT = 1 << 24;
+		static constexpr uint32_t SMALL_PRIMES[] = { 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47 };
+		static constexpr uint32_t LARGE_PRIMES[] = { 2147483647, 2147483629, 2147483587 };
+		std::vector<IntegerRoot> result;
+		if (coeffs.empty()) return result;
+		if (degrees[0]) {
+			result.push_back(IntegerRoot{ 0, degrees[0] });
+			uint64_t shift = degrees[0];
+			for (uint64_t & degree : degrees)
+				degree -= shift;
+		}
+		if (degrees.size() == 1) return result;
+		std::vector<uint32_t> starts;
+		if (degrees.back() > DEFLATION_LIMIT && (starts = LacunaryBlocks(degrees, coeffs)).size() > 1) {
+			// the gaps say nothing about -1 and 1: (x d/dx)^j f at them is exactly sum of c_i d_i^j (+-1)^d_i
+			for (int64_t r : { -1, 1 }) {
+				std::vector<BigInt> scaled = coeffs;
+				uint64_t multiplicity = 0;
+				for (;; ++multiplicity) {
+					CheckCancellation();
+					BigInt value = 0;
+					for (uint32_t i = 0; i < scaled.size(); ++i)
+						value += r < 0 && (degrees[i] & 1) ? -scaled[i] : scaled[i];
+					if (!value.IsZero()) break;
+					for (uint32_t i = 0; i < scaled.size(); ++i)
+						scaled[i] *= BigInt::FromUnsigned(degrees[i]);
+				}
+				if (multiplicity)
+					result.push_back(IntegerRoot{ r, multiplicity });
+			}
+			// the rest is solved block by block, each shifted down to its lowest degree
+			std::map<int64_t, uint64_t> common;
+			for (uint32_t b = 0; b < starts.size(); ++b) {
+				uint32_t begin = starts[b], end = b + 1 < starts.size() ? starts[b + 1] : (uint32_t) degrees.size();
+				std::vector<uint64_t> block_degrees;
+				std::vector<BigInt> block_coeffs;
+				for (uint32_t i = begin; i < end; ++i) {
+					block_degrees.push_back(degrees[i] - degrees[begin]);
+					block_coeffs.push_back(coeffs[i]);
+				}
+				std::map<int64_t, uint64_t> roots;
+				for (const IntegerRoot & root : FindIntegerRoots(std::move(block_degrees), std::move(block_coeffs))) {
+					if (root.value >= -1 && root.value <= 1) continue;
+					if (!b) {
+						roots[root.value] = root.multiplicity;
+					} else {
+						auto found = common.find(root.value);
+						if (found != common.end())
+							roots[root.value] = std::min(found->second, root.multiplicity);
+					}
+				}
+				common = std::move(roots);
+				// a block with one term has no nonzero roots
+				if (common.empty()) break;
+			}
+			for (const auto & [value, multiplicity] : common)
+				result.push_back(IntegerRoot{ value, multiplicity });
+			std::sort(result.begin(), result.end(), [](const IntegerRoot & a, const IntegerRoot & b) {
+				return a.value < b.value;
+			});
+			return result;
+		}
+		uint32_t count = (uint32_t) degrees.size();
+		auto residues = [&](uint32_t modulus) {
+			std::vector<uint64_t> r(count);
+			for (uint32_t i = 0; i < count; ++i)
+				r[i] = coeffs[i].Residue(modulus);
+			return r;
+		};
+		// value of the j-th derivative at x modulo m, falling factorials are reduced as well
+		auto evaluate = [&](const std::vector<uint64_t> & r, uint64_t x, uint64_t m, uint32_t derivative) {
+			uint64_t acc = 0;
+			uint64_t previous = degrees.back();
+			for (uint32_t i = count; i-- > 0;) {
+				if (degrees[i] < derivative) break;
+				acc = MulMod(acc, PowMod(x, previous - degrees[i], m), m);
+				uint64_t c = r[i];
+				for (uint32_t k = 0; k < derivative; ++k)
+					c = MulMod(c, (degrees[i] - k) % m, m);
+				acc = (acc + c) % m;
+				previous = degrees[i];
+			}
+			return MulMod(acc, PowMod(x, previous - derivative, m), m);
+		};
+		// candidates: divisors of the constant term inside Cauchy's bound
+		double max = 0;
+		for (uint32_t i = 0; i + 1 < count; ++i)
+			max = std::max(max, std::abs((double) coeffs[i]));
+		double bound_real = max / std::abs((double) coeffs.back()) + 2;
+		uint64_t bound = bound_real >= 1.8e19 ? UINT64_MAX : (uint64_t) bound_real;
+		if (bound > (uint64_t) INT64_MAX) bound = (uint64_t) INT64_MAX;
+		std::vector<uint64_t> divisors;
+		uint64_t constant;
+		if (coeffs[0].MagnitudeToUint64(constant)) {
+			divisors = Divisors(constant, bound);
+		} else {
+			// wider constants lose their small prime factors by trial division until the rest fits 64 bits
+			// and goes to Factorize. A rest that stays wider only has primes above d, which matter below the bound
+			BigInt rest = coeffs[0].Abs();
+			std::vector<uint64_t> primes;
+			uint64_t limit = std::min<uint64_t>(bound, TRIAL_DIVISION_LIMIT), d = 2;
+			for (; !rest.MagnitudeToUint64(constant) && d <= limit; ++d) {
+				if (!(d & 65535)) CheckCancellation();
+				while (!rest.Residue((uint32_t) d)) {
+					primes.push_back(d);
+					rest = rest / BigInt((int64_t) d);
+				}
+			}
+			if (rest.MagnitudeToUint64(constant))
+				Factorize(constant, primes);
+			else if (d <= bound)
+				throw std::domain_error("Constant term has prime factors above 2^24 that together don't fit 64 bits, "
+										"integer roots can't be found.");
+			divisors = Divisors(std::move(primes), bound);
+		}
+		std::vector<int64_t> candidates;
+		for (uint64_t d : divisors) {
+			candidates.push_back(-(int64_t) d);
+			candidates.push_back((int64_t) d);
+		}
+		std::sort(candidates.begin(), candidates.end());
+		// cheap filter: a root modulo m has to be a root of p modulo m
+		if (candidates.size() > 64) {
+			for (uint32_t m : SMALL_PRIMES) {
+				std::vector<uint64_t> r = residues(m);
+				std::vector<bool> is_root(m);
+				CheckCancellation();
+				for (uint32_t x = 0; x < m; ++x)
+					is_root[x] = !evaluate(r, x, m, 0);
+				std::vector<int64_t> survivors;
+				for (int64_t c : candidates)
+					if (is_root[(uint32_t) ((c % (int64_t) m + m) % m)]) survivors.push_back(c);
+				candidates = std::move(survivors);
+			}
+		}
+		std::vector<std::vector<uint64_t>> large_residues;
+		for (uint32_t m : LARGE_PRIMES)
+			large_residues.push_back(residues(m));
+		auto vanishes = [&](int64_t c, uint32_t derivative) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint64_t m = LARGE_PRIMES[k];
+				if (evaluate(large_residues[k], (uint64_t) ((c % (int64_t) m + (int64_t) m) % (int64_t) m), m, derivative))
+					return false;
+			}
+			return true;
+		};
+		IntegerPolynomial dense;
+		bool deflate = degrees.back() <= DEFLATION_LIMIT;
+		if (deflate) {
+			dense.assign((size_t) degrees.back() + 1, BigInt());
+			for (uint32_t i = 0; i < count; ++i)
+				dense[degrees[i]] = coeffs[i];
+		}
+		for (int64_t c : candidates) {
+			CheckCancellation();
+			if (!vanishes(c, 0)) continue;
+			uint64_t multiplicity = 0;
+			if (deflate) {
+				IntegerPolynomial quotient;
+				while (DivideByLinear(dense, c, quotient)) {
+					dense = std::move(quotient);
+					++multiplicity;
+				}
+			} else {
+				// (x d/dx)^j p vanishes at c != 0 for every j below the multiplicity, its coefficients are c_i d_i^j.
+				// A nonzero root of a polynomial with count terms has multiplicity below count
+				std::vector<BigInt> scaled = coeffs;
+				while (multiplicity + 1 < count && vanishes(c, (uint32_t) multiplicity) && VanishesAt(degrees, scaled, c)) {
+					++multiplicity;
+					for (uint32_t i = 0; i < count; ++i)
+						scaled[i] *= BigInt::FromUnsigned(degrees[i]);
+				}
+			}
+			if (multiplicity)
+				result.push_back(IntegerRoot{ c, multiplicity });
+		}
+		std::sort(result.begin(), result.end(), [](const IntegerRoot & a, const IntegerRoot & b) {
+			return a.value < b.value;
+		});
+		return result;
+	}
+
+	// Character classes of the polynomial text format, same order as FA columns. OTHER isn't allowed anywhere
+	enum class CharType : uint8_t {
+		DIGIT = 0,
+		LETTER = 1,
+		POWER = 2,
+		SIGN = 3,
+		SPACE = 4,
+		OTHER = 5
+	};
+	constexpr std::array<CharType, 256> MakeCharTypes() {
+		std::array<CharType, 256> types{};
+		for (uint32_t i = 0; i < 256; ++i)
+			types[i] = CharType::OTHER;
+		for (uint32_t i = (uint32_t) '0'; i <= (uint32_t) '9'; ++i)
+			types[i] = CharType::DIGIT;
+		for (uint32_t i = (uint32_t) 'A'; i <= (uint32_t) 'Z'; ++i)
+			types[i] = CharType::LETTER;
+		for (uint32_t i = (uint32_t) 'a'; i <= (uint32_t) 'z'; ++i)
+			types[i] = CharType::LETTER;
+		types[(uint32_t) '^'] = CharType::POWER;
+		types[(uint32_t) '+'] = types[(uint32_t) '-'] = CharType::SIGN;
+		types[(uint32_t) ' '] = CharType::SPACE;
+		return types;
+	}
+
+	// Grammar of the polynomial text format, shared by every coefficient type
+	class PolynomialGrammar {
+	public:
+		enum ErrorType : uint8_t {
+			OK = 0,
+			UNKNOWN_CHARACTERS = 1, // 4(x^2)
+			MULTIPLE_VARIABLES = 2, // x^2 + 4y^2
+			EXPECTED_COEFFICIENT = 3, // x^2 +
+			EXPECTED_VARIABLE = 4, // 4^3
+			EXPECTED_POWER_SYMBOL = 5, // 4x3
+			EXPECTED_DEGREE = 6, // 4x^x
+			DEGREE_TOO_LARGE = 7, // x^18446744073709551616
+			TOO_MANY_VARIABLES = 8 // more letters than a monomial word holds, only for multivariate polynomials
+		};
+	protected:
+		static constexpr uint32_t Q = 8;
+		static constexpr uint32_t Q0 = 0;
+		static constexpr uint32_t SIGMA = 5;
+		static constexpr uint32_t FA[Q][SIGMA] = {
+			{ 2, 3, Q, 1, 0 },
+			{ 2, 3, Q, Q, 1 },
+			{ 2, 3, Q, 1, 6 },
+			{ Q, Q, 4, 1, 3 },
+			{ 5, Q, Q, Q, 4 },
+			{ 5, Q, Q, 1, 7 },
+			{ Q, 3, Q, 1, 6 },
+			{ Q, Q, Q, 1, 7 }
+		};
+		static constexpr ErrorType ERROR_ON_LEAVE[Q] = {
+			OK,
+			EXPECTED_COEFFICIENT,
+			OK,
+			OK,
+			EXPECTED_DEGREE,
+			OK,
+			OK,
+			OK
+		};
+		static constexpr ErrorType ERROR_ON_FAIL[Q] = {
+			EXPECTED_COEFFICIENT,
+			EXPECTED_COEFFICIENT,
+			EXPECTED_VARIABLE,
+			EXPECTED_POWER_SYMBOL,
+			EXPECTED_DEGREE,
+			EXPECTED_COEFFICIENT,
+			EXPECTED_VARIABLE,
+			EXPECTED_COEFFICIENT
+		};
+		static constexpr std::array<CharType, 256> CHAR_TYPES = MakeCharTypes();
+
+		// One pass over str: validates, finds the variable and reports every term as
+		// on_term(negative, coefficient digits (empty if omitted), degree)
+		// Terms are only reported while the string is still valid, so the caller has to discard them on error
+		// Errors are prioritized like they always were: unknown characters anywhere first,
+		// then the automaton, then multiple variables, then degrees past 64 bits
+		template<typename OnTerm>
+		static std::pair<ErrorType, uint32_t> Scan(std::string_view str, char & varLetter, OnTerm && on_term) {
+			varLetter = '\0';
+			uint32_t state = Q0, n = (uint32_t) str.size(), i = 0;
+			std::pair<ErrorType, uint32_t> variable_error(OK, 0), degree_error(OK, 0);
+			// Current term
+			bool in_term = false, negative = false, has_var = false, has_power = false;
+			uint32_t digits_begin = 0, digits_end = 0;
+			uint64_t degree = 0;
+			auto flush = [&]() {
+				if (!in_term) return;
+				uint64_t term_degree = has_var ? (has_power ? degree : 1) : 0;
+				on_term(negative, str.substr(digits_begin, digits_end - digits_begin), term_degree);
+			};
+			for (; i < n; ++i) {
+				CharType type = CHAR_TYPES[(uint8_t) str[i]];
+				if (type == CharType::OTHER)
+					return std::make_pair(UNKNOWN_CHARACTERS, i);
+				uint32_t next = FA[state][(uint32_t) type];
+				if (next == Q)
+					break;
+				switch (type) {
+				case CharType::DIGIT:
+					if (has_power) {
+						if ((__builtin_mul_overflow(degree, 10, &degree)
+							 || __builtin_add_overflow(degree, (uint64_t) (str[i] - '0'), &degree)) && degree_error.first == OK)
+							degree_error = std::make_pair(DEGREE_TOO_LARGE, i);
+					} else {
+						if (digits_begin == digits_end) digits_begin = i;
+						digits_end = i + 1;
+					}
+					break;
+				case CharType::LETTER:
+					if (varLetter == '\0')
+						varLetter = str[i];
+					else if (varLetter != str[i] && variable_error.first == OK)
+						variable_error = std::make_pair(MULTIPLE_VARIABLES, i);
+					has_var = true;
+					break;
+				case CharType::POWER:
+					has_power = true;
+					break;
+				case CharType::SIGN:
+					flush();
+					negative = str[i] == '-';
+					has_var = has_power = false;
+					digits_begin = digits_end = 0;
+					degree = 0;
+					break;
+				default:
+					break;
+				}
+				// Any non-space character outside of a term opens one
+				if (type != CharType::SPACE) in_term = true;
+				state = next;
+			}
+			if (i < n) {
+				// Automaton failed, but unknown characters further on still take priority
+				for (uint32_t j = i + 1; j < n; ++j)
+					if (CHAR_TYPES[(uint8_t) str[j]] == CharType::OTHER)
+						return std::make_pair(UNKNOWN_CHARACTERS, j);
+				return std::make_pair(ERROR_ON_FAIL[state], i);
+			}
+			if (ERROR_ON_LEAVE[state] != OK)
+				return std::make_pair(ERROR_ON_LEAVE[state], n);
+			if (variable_error.first != OK)
+				return variable_error;
+			if (degree_error.first != OK)
+				return degree_error;
+			flush();
+			if (varLetter == '\0') varLetter = 'x';
+			return std::make_pair(OK, 0);
+		}
+		static std::pair<ErrorType, uint32_t> CheckForErrors(std::string_view str, char & varLetter) {
+			return Scan(str, varLetter, [](bool, std::string_view, uint64_t) {});
+		}
+	};
+
+	enum class MonomialOrder : uint8_t {
+		LEX = 0, // by the exponent of the first variable, then of the second and so on: x^2 > xy^5 > y
+		GRADED_LEX = 1 // by total degree first, ties like in LEX: xy^5 > x^2 > y
+	};
+	// Exponents of a monomial packed into one 64-bit word, so comparing words compares monomials in the order
+	// and adding words multiplies monomials. Fields go from the top bits down: total degree (graded order only),
+	// then one per variable, all of the same width. The top bit of every field is kept clear, so a sum of two words
+	// can't carry from one field into another, and a set top bit in a sum means that exponent got too large
+	class MonomialLayout {
+	public:
+		static constexpr uint32_t MAX_VARIABLES = 16;
+	private:
+		uint32_t variables = 0;
+		MonomialOrder order = MonomialOrder::GRADED_LEX;
+		uint32_t graded = 1;
+		uint32_t bits = 64;
+		uint64_t guard = (uint64_t) 1 << 63;
+
+		uint32_t Shift(uint32_t field) const {
+			return 64 - bits * (field + 1);
+		}
+	public:
+		MonomialLayout() {}
+		MonomialLayout(uint32_t variables, MonomialOrder order): variables(variables), order(order) {
+			if (variables > MAX_VARIABLES)
+				throw std::invalid_argument("Monomials can't have more than " + std::to_string(MAX_VARIABLES) + " variables.");
+			graded = order == MonomialOrder::GRADED_LEX ? 1 : 0;
+			uint32_t fields = std::max(1u, variables + graded);
+			bits = 64 / fields;
+			guard = 0;
+			for (uint32_t field = 0; field < fields; ++field)
+				guard |= (uint64_t) 1 << (Shift(field) + bits - 1);
+		}
+		uint32_t Variables() const {
+			return variables;
+		}
+		MonomialOrder Order() const {
+			return order;
+		}
+		// Largest exponent and, in graded order, total degree
+		uint64_t MaxExponent() const {
+			return ((uint64_t) 1 << (bits - 1)) - 1;
+		}
+		bool Overflows(uint64_t monomial) const {
+			return (monomial & guard) != 0;
+		}
+		uint64_t Exponent(uint64_t monomial, uint32_t variable) const {
+			return (monomial >> Shift(variable + graded)) & MaxExponent();
+		}
+		uint64_t Degree(uint64_t monomial) const {
+			if (graded) return monomial >> Shift(0);
+			uint64_t degree = 0;
+			for (uint32_t i = 0; i < variables; ++i)
+				degree += Exponent(monomial, i);
+			return degree;
+		}
+		// Word of variable^exponent, exponent can't be above MaxExponent()
+		uint64_t Power(uint32_t variable, uint64_t exponent) const {
+			uint64_t word = exponent << Shift(variable + graded);
+			if (graded) word += exponent << Shift(0);
+			return word;
+		}
+		// False if an exponent or the total degree doesn't fit
+		bool Pack(const uint64_t *exponents, uint64_t & monomial) const {
+			uint64_t degree = 0;
+			monomial = 0;
+			for (uint32_t i = 0; i < variables; ++i) {
+				if (exponents[i] > MaxExponent()) return false;
+				degree += exponents[i];
+				monomial |= exponents[i] << Shift(i + graded);
+			}
+			if (graded) {
+				if (degree > MaxExponent()) return false;
+				monomial |= degree << Shift(0);
+			}
+			return true;
+		}
+		void Unpack(uint64_t monomial, uint64_t *exponents) const {
+			for (uint32_t i = 0; i < variables; ++i)
+				exponents[i] = Exponent(monomial, i);
+		}
+		bool operator==(const MonomialLayout & other) const {
+			return variables == other.variables && order == other.order;
+		}
+		bool operator!=(const MonomialLayout & other) const {
+			return !(*this == other);
+		}
+	};
+
+	// Grammar of polynomials in several variables: a term is a coefficient and any product of powers, like 3x^2yz.
+	// The automaton is PolynomialGrammar's with a letter allowed right after a variable or a degree
+	class MultivariateGrammar : public PolynomialGrammar {
+	protected:
+		using Automaton = std::array<std::array<uint32_t, SIGMA>, Q>;
+		static constexpr Automaton MakeMultivariateFA() {
+			Automaton fa{};
+			for (uint32_t q = 0; q < Q; ++q)
+				for (uint32_t c = 0; c < SIGMA; ++c)
+					fa[q][c] = FA[q][c];
+			// xy, x^2y, x^2 y
+			fa[3][(uint32_t) CharType::LETTER] = 3;
+			fa[5][(uint32_t) CharType::LETTER] = 3;
+			fa[7][(uint32_t) CharType::LETTER] = 3;
+			return fa;
+		}
+		static const Automaton MULTIVARIATE_FA;
+
+		// Variable in a term, repeated letters are separate factors
+		struct Factor {
+			char letter;
+			uint64_t degree;
+			uint32_t position;
+		};
+		// Same as PolynomialGrammar::Scan, terms are reported as on_term(negative, coefficient digits, factors).
+		// Errors: unknown characters, then the automaton, then too many variables, then degrees past 64 bits
+		template<typename OnTerm>
+		static std::pair<ErrorType, uint32_t> ScanMultivariate(std::string_view str, OnTerm && on_term) {
+			uint32_t state = Q0, n = (uint32_t) str.size(), i = 0, letters = 0;
+			std::array<bool, 128> seen{};
+			std::pair<ErrorType, uint32_t> variable_error(OK, 0), degree_error(OK, 0);
+			bool in_term = false, negative = false, has_power = false;
+			uint32_t digits_begin = 0, digits_end = 0;
+			std::vector<Factor> factors;
+			auto flush = [&]() {
+				if (!in_term) return;
+				on_term(negative, str.substr(digits_begin, digits_end - digits_begin), factors);
+			};
+			for (; i < n; ++i) {
+				CharType type = CHAR_TYPES[(uint8_t) str[i]];
+				if (type == CharType::OTHER)
+					return std::make_pair(UNKNOWN_CHARACTERS, i);
+				uint32_t next = MULTIVARIATE_FA[state][(uint32_t) type];
+				if (next == Q)
+					break;
+				switch (type) {
+				case CharType::DIGIT:
+					if (has_power) {
+						uint64_t & degree = factors.back().degree;
+						if ((__builtin_mul_overflow(degree, 10, &degree)
+							 || __builtin_add_overflow(degree, (uint64_t) (str[i] - '0'), &degree)) && degree_error.first == OK)
+							degree_error = std::make_pair(DEGREE_TOO_LARGE, i);
+					} else {
+						if (digits_begin == digits_end) digits_begin = i;
+						digits_end = i + 1;
+					}
+					break;
+				case CharType::LETTER:
+					if (!seen[(uint8_t) str[i]]) {
+						seen[(uint8_t) str[i]] = true;
+						if (++letters > MonomialLayout::MAX_VARIABLES && variable_error.first == OK)
+							variable_error = std::make_pair(TOO_MANY_VARIABLES, i);
+					}
+					factors.push_back(Factor{ str[i], 1, i });
+					has_power = false;
+					break;
+				case CharType::POWER:
+					factors.back().degree = 0;
+					has_power = true;
+					break;
+				case CharType::SIGN:
+					flush();
+					negative = str[i] == '-';
+					has_power = false;
+					digits_begin = digits_end = 0;
+					factors.clear();
+					break;
+				default:
+					break;
+				}
+				if (type != CharType::SPACE) in_term = true;
+				state = next;
+			}
+			if (i < n) {
+				for (uint32_t j = i + 1; j < n; ++j)
+					if (CHAR_TYPES[(uint8_t) str[j]] == CharType::OTHER)
+						return std::make_pair(UNKNOWN_CHARACTERS, j);
+				return std::make_pair(ERROR_ON_FAIL[state], i);
+			}
+			if (ERROR_ON_LEAVE[state] != OK)
+				return std::make_pair(ERROR_ON_LEAVE[state], n);
+			if (variable_error.first != OK)
+				return variable_error;
+			if (degree_error.first != OK)
+				return degree_error;
+			flush();
+			return std::make_pair(OK, 0);
+		}
+	};
+	inline constexpr MultivariateGrammar::Automaton MultivariateGrammar::MULTIVARIATE_FA = MultivariateGrammar::MakeMultivariateFA();
+	template<typename Coeff>
+	class BasicPolynomial : public PolynomialGrammar {
+	public:
+		using Coefficient = Coeff;
+		using Term = typename TermStorage<Coeff>::Term;
+	private:
+		using Traits = CoefficientTraits<Coeff>;
+		char var;
+		// Stored as sorted
+		TermStorage<Coeff> terms;
+		std::string string_view;
+		bool updated;
+
+
+		std::string TermToString(const Term & term, bool first) const {
+			std::string result;
+			if (!first)
+				result += ' ';
+			bool negative = Traits::IsNegative(term.coeff);
+			if (!first && !negative)
+				result += "+ ";
+			else if (negative)
+				result += "- ";
+			Coeff magnitude = Traits::Abs(term.coeff);
+			if (magnitude != Coeff(1) || term.degree == 0)
+				result += Traits::ToString(magnitude);
+			if (term.degree > 0)
+				result += var;
+			if (term.degree > 1)
+				result += '^' + std::to_string(term.degree);
+			return result;
+		}
+		// Schoolbook division of dense arrays, b.back() isn't zero. False if some step isn't exact in the ring
+		static bool DivideLong(std::vector<Coeff> a, const std::vector<Coeff> & b, std::vector<Coeff> & q, std::vector<Coeff> & r) {
+			using W = typename WrappingType<Coeff>::type;
+			uint32_t m = (uint32_t) b.size() - 1, k = (uint32_t) (a.size() - m);
+			q.assign(k, Coeff(0));
+			for (uint32_t i = k; i-- > 0;) {
+				if (m >= 1024 || !(i & 1023)) CheckCancellation();
+				if (a[i + m] == Coeff(0)) continue;
+				if (!Traits::DivideExact(a[i + m], b[m], q[i])) return false;
+				for (uint32_t j = 0; j < m; ++j)
+					if (b[j] != Coeff(0))
+						a[i + j] = (Coeff) ((W) a[i + j] - (W) q[i] * (W) b[j]);
+				a[i + m] = Coeff(0);
+			}
+			a.resize(m);
+			r = std::move(a);
+			return true;
+		}
+		// With a = rev(a), b = rev(b) (coefficients in reverse order) the quotient is rev(a) / rev(b) modulo x^k,
+		// where k is its length, rev(b) starts with lc(b) so it's invertible as a power series when lc(b) is a unit.
+		// Remainder is a - b * q, which only needs the lowest m coefficients
+		static void DivideNewton(const std::vector<Coeff> & a, const std::vector<Coeff> & b, const Coeff & inverse,
+								 std::vector<Coeff> & q, std::vector<Coeff> & r) {
+			using W = typename WrappingType<Coeff>::type;
+			uint32_t m = (uint32_t) b.size() - 1, k = (uint32_t) (a.size() - m);
+			std::vector<Coeff> reversed_a(a.rbegin(), a.rbegin() + k), reversed_b(b.rbegin(), b.rbegin() + std::min<size_t>(b.size(), k));
+			std::vector<Coeff> reciprocal;
+			InverseSeries(reversed_b, inverse, k, reciprocal);
+			MultiplyDenseTruncated(reversed_a, reciprocal, k, q);
+			q.resize(k, Coeff(0));
+			std::reverse(q.begin(), q.end());
+			std::vector<Coeff> low_b(b.begin(), b.begin() + m), low_q(q.begin(), q.begin() + std::min(k, m)), product;
+			MultiplyDenseTruncated(low_b, low_q, m, product);
+			product.resize(m, Coeff(0));
+			r.assign(a.begin(), a.begin() + m);
+			for (uint32_t i = 0; i < m; ++i)
+				r[i] = (Coeff) ((W) r[i] - (W) product[i]);
+		}
+		// Every step of the sparse division costs a few map operations per divisor term, the dense one
+		// goes over the whole divisor, so the sparse one is used when the divisor has fewer than 1/this of its slots filled
+		static constexpr uint32_t SPARSE_DIVISION_FILL = 32;
+		// Long division keeping the remainder in a map, for sparse divisors with far apart degrees
+		static bool DivideSparse(const TermStorage<Coeff> & a, const TermStorage<Coeff> & b, TermStorage<Coeff> & q, TermStorage<Coeff> & r) {
+			using W = typename WrappingType<Coeff>::type;
+			std::map<uint64_t, Coeff> rest;
+			for (Term term : a)
+				rest.emplace(term.degree, term.coeff);
+			std::vector<uint64_t> divisor_degrees;
+			std::vector<Coeff> divisor_coeffs;
+			b.ToSparse(divisor_degrees, divisor_coeffs);
+			uint64_t m = divisor_degrees.back();
+			std::vector<uint64_t> quotient_degrees;
+			std::vector<Coeff> quotient_coeffs;
+			for (uint64_t steps = 0; !rest.empty() && rest.rbegin()->first >= m; ++steps) {
+				if (!(steps & 255)) CheckCancellation();
+				auto top = std::prev(rest.end());
+				uint64_t shift = top->first - m;
+				Coeff factor;
+				if (!Traits::DivideExact(top->second, divisor_coeffs.back(), factor)) return false;
+				rest.erase(top);
+				for (uint32_t j = 0; j + 1 < divisor_degrees.size(); ++j) {
+					Coeff & c = rest[shift + divisor_degrees[j]];
+					c = (Coeff) ((W) c - (W) factor * (W) divisor_coeffs[j]);
+					if (c == Coeff(0)) rest.erase(shift + divisor_degrees[j]);
+				}
+				quotient_degrees.push_back(shift);
+				quotient_coeffs.push_back(factor);
+			}
+			std::reverse(quotient_degrees.begin(), quotient_degrees.end());
+			std::reverse(quotient_coeffs.begin(), quotient_coeffs.end());
+			q.AssignSparse(std::move(quotient_degrees), std::move(quotient_coeffs));
+			std::vector<uint64_t> remainder_degrees;
+			std::vector<Coeff> remainder_coeffs;
+			for (const auto & term : rest) {
+				remainder_degrees.push_back(term.first);
+				remainder_coeffs.push_back(term.second);
+			}
+			r.AssignSparse(std::move(remainder_degrees), std::move(remainder_coeffs));
+			return true;
+		}
+	public:
+		BasicPolynomial(): var('x'), updated(true) {}
+		// Copies share terms, the formatted string isn't copied, it's rebuilt on demand
+		BasicPolynomial(const BasicPolynomial & other): var(other.var), terms(other.terms), updated(true) {}
+		BasicPolynomial(BasicPolynomial &&) = default;
+		BasicPolynomial& operator=(const BasicPolynomial & other) {
+			var = other.var;
+			terms = other.terms;
+			string_view.clear();
+			updated = true;
+			return *this;
+		}
+		BasicPolynomial& operator=(BasicPolynomial &&) = default;
+		Coeff GetCoefficient(uint64_t degree) const {
+			return terms.Get(degree);
+		}
+		char GetVariable() const {
+			return var;
+		}
+		void SetVariable(char letter) {
+			var = letter;
+			updated = true;
+		}
+		void AddTerm(const Term & term) {
+			updated = true;
+			terms.Add(term.degree, term.coeff);
+		}
+		std::pair<ErrorType, uint32_t> InitFromString(std::string_view str) {
+			CORE_PROFILE(PARSE, str.size());
+			char varLetter;
+			std::vector<uint64_t> degrees;
+			std::vector<Coeff> coeffs;
+			std::pair<ErrorType, uint32_t> error = Scan(str, varLetter,
+				[&degrees, &coeffs](bool negative, std::string_view digits, uint64_t degree) {
+					Coeff coefficient(digits.empty() ? 1 : 0);
+					for (char digit : digits)
+						coefficient = coefficient * Coeff(10) + Coeff((int32_t) digit - (int32_t) '0');
+					if (negative) coefficient = -coefficient;
+					degrees.push_back(degree);
+					coeffs.push_back(std::move(coefficient));
+				});
+			if (error.first != OK)
+				return error;
+			var = varLetter;
+			terms.AssignUnsorted(std::move(degrees), std::move(coeffs));
+			updated = true;
+			return std::make_pair(OK, 0);
+		}
+		// Binary record: variable letter, term count, then delta-encoded degrees with coefficients
+		void Encode(ByteWriter & writer) const {
+			writer.WriteByte((uint8_t) var);
+			writer.WriteVarint(terms.Size());
+			uint64_t previous = 0;
+			bool first = true;
+			for (Term term : terms) {
+				writer.WriteVarint(first ? (uint64_t) term.degree : term.degree - previous - 1);
+				Traits::Encode(term.coeff, writer);
+				previous = term.degree;
+				first = false;
+			}
+		}
+		bool Decode(ByteReader & reader) {
+			uint8_t letter;
+			uint32_t count;
+			if (!reader.ReadByte(letter) || CHAR_TYPES[letter] != CharType::LETTER || !reader.ReadVarint(count))
+				return false;
+			std::vector<uint64_t> degrees;
+			std::vector<Coeff> coeffs;
+			// count comes from the file, so it's not trusted with a huge allocation
+			degrees.reserve(std::min(count, (uint32_t) 1 << 16));
+			coeffs.reserve(std::min(count, (uint32_t) 1 << 16));
+			uint64_t degree = 0;
+			for (uint32_t i = 0; i < count; ++i) {
+				uint64_t delta;
+				Coeff coefficient;
+				if (!reader.ReadVarint(delta) || (i && delta >= UINT64_MAX - degree) || !Traits::Decode(reader, coefficient))
+					return false;
+				degree = i ? degree + delta + 1 : delta;
+				degrees.push_back(degree);
+				coeffs.push_back(std::move(coefficient));
+			}
+			var = (char) letter;
+			terms.AssignUnsorted(std::move(degrees), std::move(coeffs));
+			updated = true;
+			return true;
+		}
+		// Formats without touching the cached string, stops with "..." once max_length is exceeded
+		std::string ToString(uint32_t max_length = UINT32_MAX) const {
+			if (terms.Empty()) return std::string("0");
+			std::string result;
+			// As terms are kept sorted in ascending order,
+			// And we want polynomial with descending powers,
+			// We have to go from back to front
+			auto current = terms.end(), first = terms.begin();
+			result = TermToString(*--current, true);
+			while (current != first && result.size() <= max_length)
+				result += TermToString(*--current, false);
+			if (result.size() > max_length) {
+				result.resize(max_length);
+				result += "...";
+			}
+			return result;
+		}
+		std::string ExportAsString() {
+			if (!updated)
+				return string_view;
+			if (terms.Empty()) return std::string("0");
+			updated = false;
+			return string_view = ToString();
+		}
+		uint32_t Size() const {
+			return terms.Size();
+		}
+		bool Empty() const {
+			return terms.Empty();
+		}
+		// 0 for the zero polynomial
+		uint64_t Degree() const {
+			return terms.Empty() ? 0 : terms.Back().degree;
+		}
+		// Structural hash of the variable and terms, cached until the terms change
+		uint64_t Hash() const {
+			uint64_t hash = terms.Hash([this]() {
+				uint64_t result = terms.Size();
+				for (Term term : terms)
+					result = HashMix(result ^ term.degree) ^ Traits::Hash(term.coeff);
+				return HashMix(result);
+			});
+			return HashMix(hash ^ (uint8_t) var);
+		}
+		// Copies share their terms until one of them is changed
+		bool SharesTermsWith(const BasicPolynomial & other) const {
+			return terms.SharesWith(other.terms);
+		}
+		// Makes an equal polynomial reuse other's terms, so only one copy is kept
+		void ShareTermsWith(const BasicPolynomial & other) {
+			if (SharesTermsWith(other)) return;
+			if (var != other.var || terms != other.terms)
+				throw std::invalid_argument("Only equal polynomials can share terms.");
+			terms.ShareWith(other.terms);
+		}
+		bool operator==(const BasicPolynomial & other) const {
+			return var == other.var && terms == other.terms;
+		}
+		bool operator!=(const BasicPolynomial & other) const {
+			return !(*this == other);
+		}
+		friend void Add(const BasicPolynomial &lhs, const BasicPolynomial &rhs, BasicPolynomial &res) {
+			CORE_PROFILE(ADD, lhs.terms.Size() + rhs.terms.Size());
+			res.var = lhs.var;
+			res.updated = true;
+			if (lhs.terms.IsDense() && rhs.terms.IsDense()) {
+				const std::vector<Coeff> &l = lhs.terms.Dense(), &r = rhs.terms.Dense();
+				std::vector<Coeff> sum;
+				// Reuse res buffers when it's a separate polynomial
+				if (&res != &lhs && &res != &rhs)
+					sum = res.terms.ReleaseDense();
+				sum.assign(std::max(l.size(), r.size()), Coeff(0));
+				for (uint32_t i = 0; i < l.size(); ++i)
+					sum[i] = l[i];
+				for (uint32_t i = 0; i < r.size(); ++i)
+					sum[i] = WrappingAdd(sum[i], r[i]);
+				res.terms.AssignDense(std::move(sum));
+				return;
+			}
+			TermStorage<Coeff> merged;
+			if (&res != &lhs && &res != &rhs) {
+				merged = std::move(res.terms);
+				merged.Clear();
+			}
+			merged.Reserve(lhs.terms.Size() + rhs.terms.Size());
+			auto lp = lhs.terms.begin(), rp = rhs.terms.begin();
+			auto lend = lhs.terms.end(), rend = rhs.terms.end();
+			while (lp != lend && rp != rend) {
+				Term l = *lp, r = *rp;
+				if (l.degree == r.degree) {
+					merged.PushBack(l.degree, WrappingAdd(l.coeff, r.coeff));
+					++lp;
+					++rp;
+				} else if (l.degree < r.degree) {
+					merged.PushBack(l.degree, l.coeff);
+					++lp;
+				} else {
+					merged.PushBack(r.degree, r.coeff);
+					++rp;
+				}
+			}
+			for (; lp != lend; ++lp)
+				merged.PushBack((*lp).degree, (*lp).coeff);
+			for (; rp != rend; ++rp)
+				merged.PushBack((*rp).degree, (*rp).coeff);
+			merged.Normalize();
+			// res may alias lhs or rhs, so it's only overwritten at the very end
+			res.terms = std::move(merged);
+		}
+		friend void MultiplyByTerm(const BasicPolynomial &lhs, const Term &term, BasicPolynomial &res) {
+			res.var = lhs.var;
+			res.updated = true;
+			TermStorage<Coeff> product;
+			if (&res != &lhs) {
+				product = std::move(res.terms);
+				product.Clear();
+			}
+			if (!lhs.terms.Empty() && lhs.terms.Back().degree > UINT64_MAX - term.degree)
+				throw std::overflow_error("Degree of the product doesn't fit in 64 bits.");
+			product.Reserve(lhs.terms.Size());
+			for (Term current : lhs.terms)
+				product.PushBack(current.degree + term.degree, WrappingMultiply(current.coeff, term.coeff));
+			product.Normalize();
+			res.terms = std::move(product);
+		}
+		friend void Multiply(const BasicPolynomial &lhs, const BasicPolynomial &rhs, BasicPolynomial &res) {
+			CORE_PROFILE(MULTIPLY, lhs.terms.Size() + rhs.terms.Size());
+			res.var = lhs.var;
+			res.updated = true;
+			if (lhs.terms.Empty() || rhs.terms.Empty()) {
+				res.terms.Clear();
+				return;
+			}
+			// Dense algorithms are used when the dense result isn't longer than the number of term pairs,
+			// so they never do more work than the sparse merge would
+			uint64_t pairs = (uint64_t) lhs.terms.Size() * rhs.terms.Size(), result_degree;
+			if (__builtin_add_overflow(lhs.terms.Back().degree, rhs.terms.Back().degree, &result_degree))
+				throw std::overflow_error("Degree of the product doesn't fit in 64 bits.");
+			if ((lhs.terms.IsDense() && rhs.terms.IsDense()) || result_degree < pairs) {
+				std::vector<Coeff> l, r, product;
+				lhs.terms.ToDense(l);
+				rhs.terms.ToDense(r);
+				MultiplyDense(l, r, product);
+				res.terms.AssignDense(std::move(product));
+			} else {
+				std::vector<uint64_t> ld, rd, product_degrees;
+				std::vector<Coeff> lc, rc, product_coeffs;
+				lhs.terms.ToSparse(ld, lc);
+				rhs.terms.ToSparse(rd, rc);
+				MultiplySparse(ld, lc, rd, rc, product_degrees, product_coeffs);
+				res.terms.AssignSparse(std::move(product_degrees), std::move(product_coeffs));
+			}
+		}
+		// n-th derivative, c x^d turns into c d (d - 1) ... (d - n + 1) x^(d - n). The falling factorial comes in closed
+		// form per term, dense arrays get it in vectorized passes. Wraps like the other operations, see CheckedDerivative
+		friend void Derivative(const BasicPolynomial & p, uint32_t n, BasicPolynomial & res) {
+			CORE_PROFILE(DERIVATIVE, p.terms.Size());
+			TermStorage<Coeff> derivative;
+			FallingFactorials<Coeff> factorials(n);
+			if (p.terms.IsDense() && p.Degree() >= n) {
+				const std::vector<Coeff> & dense = p.terms.Dense();
+				std::vector<Coeff> values(dense.begin() + n, dense.end());
+				factorials.TimesAll(values, n);
+				derivative.AssignDense(std::move(values));
+			} else if (!p.terms.IsDense()) {
+				uint32_t work = 0;
+				for (Term current : p.terms) {
+					if (current.degree < n) continue;
+					if (++work >= 1 << 12) {
+						CheckCancellation();
+						work = 0;
+					}
+					derivative.PushBack(current.degree - n, factorials.Times(current.coeff, current.degree));
+				}
+				derivative.Normalize();
+			}
+			// res may be p itself
+			res.var = p.var;
+			res.terms = std::move(derivative);
+			res.updated = true;
+		}
+		// Derivative that returns false instead of wrapping when some coefficient doesn't fit Coeff, res isn't touched then.
+		// Only fixed width types can overflow. Every factor is at least 1, so the check stops at the first overflow
+		friend bool CheckedDerivative(const BasicPolynomial & p, uint32_t n, BasicPolynomial & res) {
+			if constexpr (std::is_integral<Coeff>::value || std::is_same<Coeff, Int128>::value) {
+				for (Term current : p.terms) {
+					if (current.degree < n) continue;
+					Coeff c = current.coeff;
+					for (uint32_t i = 0; i < n; ++i) {
+						uint64_t factor = (uint64_t) current.degree - i;
+						if ((uint64_t) (Coeff) factor != factor || __builtin_mul_overflow(c, (Coeff) factor, &c))
+							return false;
+					}
+				}
+			}
+			Derivative(p, n, res);
+			return true;
+		}
+		// n-fold antiderivative with zero constants, exact over rationals (Zp coefficients are taken as their residues):
+		// c x^d turns into c / ((d + 1) ... (d + n)) x^(d + n). Throws std::overflow_error if degrees pass 64 bits
+		friend void Integral(const BasicPolynomial & p, uint32_t n, BasicPolynomial<Rational> & res) {
+			CORE_PROFILE(INTEGRAL, p.terms.Size());
+			if (!p.terms.Empty() && p.Degree() > UINT64_MAX - n)
+				throw std::overflow_error("Integral degree doesn't fit in 64 bits.");
+			BasicPolynomial<Rational> integral;
+			integral.SetVariable(p.var);
+			ConsecutiveProducts products(n);
+			uint32_t work = 0;
+			for (Term current : p.terms) {
+				if (++work >= 1 << 10) {
+					CheckCancellation();
+					work = 0;
+				}
+				const BigInt & product = products.From(current.degree + 1);
+				if constexpr (std::is_same<Coeff, Rational>::value)
+					integral.AddTerm({ current.degree + n, current.coeff / Rational(product) });
+				else
+					integral.AddTerm({ current.degree + n, Rational(Traits::ToBigInt(current.coeff), product) });
+			}
+			res = std::move(integral);
+		}
+		// Integral of p from a to b, exact
+		friend Rational DefiniteIntegral(const BasicPolynomial & p, const Rational & a, const Rational & b) {
+			BasicPolynomial<Rational> integral;
+			Integral(p, 1, integral);
+			return integral.Evaluate(b) - integral.Evaluate(a);
+		}
+		// Drops every term with degree above max_degree
+		friend void Truncate(const BasicPolynomial & p, uint64_t max_degree, BasicPolynomial & res) {
+			res.var = p.var;
+			res.updated = true;
+			if (p.terms.Empty() || p.terms.Back().degree <= max_degree) {
+				res.terms = p.terms;
+				return;
+			}
+			TermStorage<Coeff> truncated;
+			for (Term current : p.terms) {
+				if (current.degree > max_degree) break;
+				truncated.PushBack(current.degree, current.coeff);
+			}
+			truncated.Normalize();
+			res.terms = std::move(truncated);
+		}
+		// Product without the terms above max_degree. Only operand terms up to max_degree are looked at,
+		// so the cost depends on the window rather than on the whole product
+		friend void MultiplyTruncated(const BasicPolynomial &lhs, const BasicPolynomial &rhs, uint64_t max_degree, BasicPolynomial &res) {
+			CORE_PROFILE(MULTIPLY_TRUNCATED, lhs.terms.Size() + rhs.terms.Size());
+			res.var = lhs.var;
+			res.updated = true;
+			uint32_t l_count = lhs.terms.TermsUpTo(max_degree), r_count = rhs.terms.TermsUpTo(max_degree);
+			if (!l_count || !r_count) {
+				res.terms.Clear();
+				return;
+			}
+			uint64_t pairs = (uint64_t) l_count * r_count;
+			uint64_t l_degree = std::min(lhs.terms.Back().degree, max_degree), r_degree = std::min(rhs.terms.Back().degree, max_degree);
+			uint64_t result_degree = l_degree > max_degree - r_degree ? max_degree : l_degree + r_degree;
+			// Same choice as in Multiply
+			if ((lhs.terms.IsDense() && rhs.terms.IsDense()) || result_degree < pairs) {
+				std::vector<Coeff> l, r, product;
+				lhs.terms.ToDense(l, max_degree);
+				rhs.terms.ToDense(r, max_degree);
+				MultiplyDenseTruncated(l, r, (uint32_t) (result_degree + 1), product);
+				res.terms.AssignDense(std::move(product));
+			} else {
+				std::vector<uint64_t> ld, rd, product_degrees;
+				std::vector<Coeff> lc, rc, product_coeffs;
+				lhs.terms.ToSparse(ld, lc, max_degree);
+				rhs.terms.ToSparse(rd, rc, max_degree);
+				MultiplySparse(ld, lc, rd, rc, product_degrees, product_coeffs, max_degree);
+				res.terms.AssignSparse(std::move(product_degrees), std::move(product_coeffs));
+			}
+		}
+		// Quotient and remainder with deg remainder < deg rhs. Long division, or Newton's reciprocal of the reversed
+		// divisor for long dense operands. Over rings that aren't fields the leading coefficient of rhs has to divide
+		// every leading coefficient met on the way (always true for monic divisors), returns false if it doesn't.
+		// Throws std::domain_error for a zero divisor
+		friend bool Divide(const BasicPolynomial &lhs, const BasicPolynomial &rhs, BasicPolynomial &quotient, BasicPolynomial &remainder) {
+			CORE_PROFILE(DIVIDE, lhs.terms.Size() + rhs.terms.Size());
+			if (rhs.terms.Empty())
+				throw std::domain_error("Polynomial division by zero.");
+			char var = lhs.var;
+			TermStorage<Coeff> q, r;
+			uint64_t n = lhs.Degree(), m = rhs.Degree();
+			if (lhs.terms.Empty() || n < m) {
+				r = lhs.terms;
+			} else if (m >= (uint64_t) rhs.terms.Size() * SPARSE_DIVISION_FILL) {
+				if (!DivideSparse(lhs.terms, rhs.terms, q, r)) return false;
+			} else {
+				std::vector<Coeff> a, b, dense_q, dense_r;
+				lhs.terms.ToDense(a);
+				rhs.terms.ToDense(b);
+				uint64_t k = n - m + 1;
+				Coeff inverse;
+				if (std::min(k, m) >= NEWTON_DIVISION_THRESHOLD && Traits::DivideExact(Coeff(1), b.back(), inverse)) {
+					DivideNewton(a, b, inverse, dense_q, dense_r);
+				} else if (!DivideLong(a, b, dense_q, dense_r)) {
+					return false;
+				}
+				q.AssignDense(std::move(dense_q));
+				r.AssignDense(std::move(dense_r));
+			}
+			// Outputs may alias the inputs, so they're written at the very end
+			quotient.var = remainder.var = var;
+			quotient.updated = remainder.updated = true;
+			quotient.terms = std::move(q);
+			remainder.terms = std::move(r);
+			return true;
+		}
+		// Greatest common divisor. Over fields it's monic and comes from Euclid's algorithm,
+		// over integers it's the primitive gcd (positive leading coefficient) times the gcd of contents,
+		// computed through a subresultant sequence over BigInt so coefficients don't blow up
+		friend void Gcd(const BasicPolynomial &lhs, const BasicPolynomial &rhs, BasicPolynomial &res) {
+			CORE_PROFILE(GCD, lhs.terms.Size() + rhs.terms.Size());
+			char var = lhs.var;
+			if constexpr (Traits::IS_FIELD) {
+				BasicPolynomial a = lhs, b = rhs, q, r;
+				while (!b.Empty()) {
+					Divide(a, b, q, r);
+					a = std::move(b);
+					b = std::move(r);
+				}
+				if (!a.Empty()) {
+					Coeff inverse;
+					Traits::DivideExact(Coeff(1), a.terms.Back().coeff, inverse);
+					MultiplyByTerm(a, Term{ 0, inverse }, a);
+				}
+				res = std::move(a);
+			} else {
+				BigInt content = 0;
+				SparseIntegerPolynomial a, b;
+				for (Term term : lhs.terms) {
+					a.emplace(term.degree, Traits::ToBigInt(term.coeff));
+					content = BigInt::Gcd(content, a[term.degree]);
+				}
+				for (Term term : rhs.terms) {
+					b.emplace(term.degree, Traits::ToBigInt(term.coeff));
+					content = BigInt::Gcd(content, b[term.degree]);
+				}
+				content = content.Abs();
+				// Far apart degrees would make dense arrays of billions of coefficients, so the remainders are
+				// taken sparsely (a primitive sequence) until both sides are dense enough for the subresultant one
+				auto sparse = [](const SparseIntegerPolynomial & p) {
+					return !p.empty() && p.rbegin()->first >= (uint64_t) p.size() * SPARSE_DIVISION_FILL;
+				};
+				if (a.empty() || (!b.empty() && a.rbegin()->first < b.rbegin()->first)) std::swap(a, b);
+				MakePrimitive(a);
+				MakePrimitive(b);
+				while (!b.empty() && (sparse(a) || sparse(b))) {
+					SparseIntegerPolynomial r = SparsePseudoRemainder(std::move(a), b);
+					MakePrimitive(r);
+					a = std::move(b);
+					b = std::move(r);
+				}
+				TermStorage<Coeff> result;
+				if (b.empty()) {
+					for (const auto & term : a)
+						result.PushBack(term.first, Traits::FromBigInt(term.second * content));
+				} else {
+					auto dense = [](const SparseIntegerPolynomial & p) {
+						IntegerPolynomial result(DenseLength<BigInt>(p.rbegin()->first), BigInt(0));
+						for (const auto & term : p)
+							result[term.first] = term.second;
+						return result;
+					};
+					IntegerPolynomial gcd = IntegerGcd(dense(a), dense(b));
+					for (uint32_t i = 0; i < gcd.size(); ++i)
+						if (!gcd[i].IsZero())
+							result.PushBack(i, Traits::FromBigInt(gcd[i] * content));
+				}
+				result.Normalize();
+				res.terms = std::move(result);
+			}
+			res.var = var;
+			res.updated = true;
+		}
+		// Polynomial of degree below points.size() taking values[i] at points[i], through a subproduct tree.
+		// Over rings that aren't fields it's found over rationals, false if some coefficient isn't in the ring.
+		// Throws std::invalid_argument for repeated points or mismatched sizes
+		friend bool Interpolate(const std::vector<Coeff> & points, const std::vector<Coeff> & values, BasicPolynomial &res) {
+			CORE_PROFILE(INTERPOLATE, points.size());
+			if (points.size() != values.size())
+				throw std::invalid_argument("Interpolation needs as many values as points.");
+			std::vector<Coeff> coeffs;
+			if (points.empty()) {
+				res.terms.Clear();
+				res.updated = true;
+				return true;
+			}
+			if constexpr (Traits::IS_FIELD) {
+				if (!SubproductTree<Coeff>(points).Interpolate(values, coeffs)) return false;
+			} else {
+				std::vector<Rational> rational_points, rational_values, rational_coeffs;
+				for (uint32_t i = 0; i < points.size(); ++i) {
+					rational_points.emplace_back(Traits::ToBigInt(points[i]));
+					rational_values.emplace_back(Traits::ToBigInt(values[i]));
+				}
+				SubproductTree<Rational>(std::move(rational_points)).Interpolate(rational_values, rational_coeffs);
+				for (const Rational & c : rational_coeffs) {
+					if (c.Denominator() != BigInt(1)) return false;
+					coeffs.push_back(Traits::FromBigInt(c.Numerator()));
+				}
+			}
+			res.terms.AssignDense(std::move(coeffs));
+			res.updated = true;
+			return true;
+		}
+		// f(g) modulo the modulus, by baby steps and giant steps (Brent and Kung): powers g^0..g^(k-1) are
+		// reduced once, f is cut into blocks of k coefficients which are linear combinations of them,
+		// and blocks are put together by Horner's scheme in g^k. That's about 2 sqrt(deg f) products
+		// instead of deg f. Sparse f goes through Horner's scheme over its degree gaps instead, with g^gap
+		// from shared squarings of g, so the cost depends on the number of terms and the bits of the degree.
+		// Returns false if reducing by the modulus isn't possible in the ring (see Divide)
+		friend bool ComposeModulo(const BasicPolynomial &f, const BasicPolynomial &g, const BasicPolynomial &modulus, BasicPolynomial &res) {
+			CORE_PROFILE(COMPOSE, f.terms.Size() + g.terms.Size() + modulus.terms.Size());
+			if (modulus.terms.Empty())
+				throw std::domain_error("Polynomial division by zero.");
+			char var = g.var;
+			BasicPolynomial quotient, g_reduced, result;
+			if (!Divide(g, modulus, quotient, g_reduced)) return false;
+			if (!f.terms.Empty() && f.Degree() >= (uint64_t) f.terms.Size() * SPARSE_DIVISION_FILL) {
+				const std::vector<uint64_t> & degrees = f.terms.Degrees();
+				const std::vector<Coeff> & coeffs = f.terms.Coeffs();
+				uint64_t max_gap = degrees[0];
+				for (uint32_t j = 1; j < degrees.size(); ++j)
+					max_gap = std::max(max_gap, degrees[j] - degrees[j - 1]);
+				// squares[b] is g^(2^b) modulo the modulus
+				std::vector<BasicPolynomial> squares = { g_reduced };
+				for (max_gap >>= 1; max_gap; max_gap >>= 1) {
+					squares.emplace_back();
+					Multiply(squares[squares.size() - 2], squares[squares.size() - 2], squares.back());
+					if (!Divide(squares.back(), modulus, quotient, squares.back())) return false;
+				}
+				auto raise = [&](uint64_t e) {
+					for (uint32_t b = 0; e; ++b, e >>= 1) {
+						if (!(e & 1)) continue;
+						CheckCancellation();
+						Multiply(result, squares[b], result);
+						if (!Divide(result, modulus, quotient, result)) return false;
+					}
+					return true;
+				};
+				BasicPolynomial constant;
+				for (uint32_t j = (uint32_t) degrees.size(); j-- > 0;) {
+					if (j + 1 < degrees.size() && !raise(degrees[j + 1] - degrees[j])) return false;
+					constant.terms.Clear();
+					constant.AddTerm(Term{ 0, coeffs[j] });
+					Add(result, constant, result);
+					if (!Divide(result, modulus, quotient, result)) return false;
+				}
+				if (!raise(degrees[0])) return false;
+			} else if (!f.terms.Empty()) {
+				uint32_t n = (uint32_t) f.Degree() + 1, k = 1;
+				while ((uint64_t) k * k < n) ++k;
+				std::vector<BasicPolynomial> powers(k + 1);
+				powers[0].AddTerm(Term{ 0, Coeff(1) });
+				if (!Divide(powers[0], modulus, quotient, powers[0])) return false;
+				for (uint32_t i = 1; i <= k; ++i) {
+					Multiply(powers[i - 1], g_reduced, powers[i]);
+					if (!Divide(powers[i], modulus, quotient, powers[i])) return false;
+				}
+				for (uint32_t block = (n + k - 1) / k; block-- > 0;) {
+					CheckCancellation();
+					// Linear combination of the baby steps
+					std::vector<Coeff> sum;
+					for (uint32_t j = 0; j < k; ++j) {
+						Coeff c = f.terms.Get(block * k + j);
+						if (c == Coeff(0) || powers[j].terms.Empty()) continue;
+						std::vector<Coeff> power;
+						powers[j].terms.ToDense(power);
+						if (sum.size() < power.size()) sum.resize(power.size(), Coeff(0));
+						for (uint32_t i = 0; i < power.size(); ++i)
+							sum[i] += c * power[i];
+					}
+					BasicPolynomial combination;
+					combination.terms.AssignDense(std::move(sum));
+					Multiply(result, powers[k], result);
+					Add(result, combination, result);
+					if (!Divide(result, modulus, quotient, result)) return false;
+				}
+			}
+			res = std::move(result);
+			res.var = var;
+			res.updated = true;
+			return true;
+		}
+		// Coefficient of x^degree in lhs * rhs without the product: pairs of terms adding up to degree
+		// are found sweeping lhs terms up and rhs terms down
+		friend Coeff CoefficientOfProduct(const BasicPolynomial &lhs, const BasicPolynomial &rhs, uint64_t degree) {
+			CORE_PROFILE(COEFFICIENT_OF_PRODUCT, lhs.terms.Size() + rhs.terms.Size());
+			using W = typename WrappingType<Coeff>::type;
+			W result = W(0);
+			if (lhs.terms.Empty() || rhs.terms.Empty()) return Coeff(result);
+			if (lhs.terms.IsDense() && rhs.terms.IsDense()) {
+				const std::vector<Coeff> &l = lhs.terms.Dense(), &r = rhs.terms.Dense();
+				uint64_t begin = degree >= r.size() ? degree - r.size() + 1 : 0;
+				uint64_t end = std::min<uint64_t>(degree, l.size() - 1);
+				for (uint64_t i = begin; i <= end && begin <= end; ++i)
+					result += (W) l[i] * (W) r[degree - i];
+			} else if (lhs.terms.IsDense() || rhs.terms.IsDense()) {
+				const TermStorage<Coeff> &dense = lhs.terms.IsDense() ? lhs.terms : rhs.terms;
+				const TermStorage<Coeff> &sparse = lhs.terms.IsDense() ? rhs.terms : lhs.terms;
+				const std::vector<uint64_t> &degrees = sparse.Degrees();
+				const std::vector<Coeff> &coeffs = sparse.Coeffs();
+				for (uint32_t i = 0; i < degrees.size() && degrees[i] <= degree; ++i)
+					result += (W) coeffs[i] * (W) dense.Get(degree - degrees[i]);
+			} else {
+				const std::vector<uint64_t> &ld = lhs.terms.Degrees(), &rd = rhs.terms.Degrees();
+				const std::vector<Coeff> &lc = lhs.terms.Coeffs(), &rc = rhs.terms.Coeffs();
+				uint32_t i = 0, j = rhs.terms.TermsUpTo(degree);
+				// ld[i] + rd[j - 1] against degree without overflowing, rd[j - 1] <= degree
+				while (i < ld.size() && j > 0) {
+					uint64_t current = ld[i], rest = degree - rd[j - 1];
+					if (current == rest)
+						result += (W) lc[i] * (W) rc[j - 1];
+					if (current <= rest) ++i;
+					if (current >= rest) --j;
+				}
+			}
+			return Coeff(result);
+		}
+		template<typename T>
+		T Evaluate(T x) const {
+			T result = 0;
+			if (terms.IsDense()) {
+				// Horner's scheme over the coefficient array
+				const std::vector<Coeff> & dense = terms.Dense();
+				for (uint32_t i = (uint32_t) dense.size(); i-- > 0;)
+					result = result * x + static_cast<T>(dense[i]);
+				return result;
+			}
+			// x^d for every degree from the previous one, gap powers share x's squarings
+			const std::vector<uint64_t> & degrees = terms.Degrees();
+			const std::vector<Coeff> & coeffs = terms.Coeffs();
+			uint64_t degree = 0, max_gap = 0;
+			for (uint64_t d : degrees) {
+				max_gap = std::max(max_gap, d - degree);
+				degree = d;
+			}
+			PowerTable<T> powers(x, max_gap);
+			T power = 1;
+			degree = 0;
+			for (uint32_t i = 0; i < degrees.size(); ++i) {
+				power *= powers.Power(degrees[i] - degree);
+				degree = degrees[i];
+				result += static_cast<T>(coeffs[i]) * power;
+			}
+			return result;
+		}
+		// Evaluates at n points at once. Coefficients are converted to T once,
+		// dense polynomials go through Horner's scheme, sparse ones through Horner's scheme over degree gaps.
+		// Long dense polynomials at many points of the coefficient type go through subproduct trees
+		// over blocks of about as many points as coefficients, O(n log^2 n) per block instead of O(n^2)
+		template<typename T>
+		void EvaluateMany(const T *xs, T *out, size_t n) const {
+			CORE_PROFILE(EVALUATE, (uint64_t) terms.Size() * n);
+			if (terms.Empty()) {
+				std::fill(out, out + n, T(0));
+				return;
+			}
+			if constexpr (std::is_same<T, Coeff>::value) {
+				uint64_t degree = Degree(), length = degree + 1;
+				if (n >= SUBPRODUCT_TREE_THRESHOLD && degree >= SUBPRODUCT_TREE_THRESHOLD
+					&& degree < (uint64_t) terms.Size() * TermStorage<Coeff>::DENSE_FILL) {
+					std::vector<Coeff> dense;
+					terms.ToDense(dense);
+					for (size_t i = 0; i < n; i += length) {
+						SubproductTree<Coeff> tree(std::vector<Coeff>(xs + i, xs + std::min<size_t>(n, i + length)));
+						std::vector<Coeff> values = tree.Evaluate(dense);
+						std::copy(values.begin(), values.end(), out + i);
+					}
+					return;
+				}
+			}
+			if (terms.IsDense()) {
+				const std::vector<Coeff> & dense = terms.Dense();
+				std::vector<T> horner(dense.size());
+				for (uint32_t i = 0; i < dense.size(); ++i)
+					horner[i] = static_cast<T>(dense[i]);
+				HornerMany(horner.data(), (uint32_t) horner.size(), xs, out, n);
+				return;
+			}
+			const std::vector<Coeff> & coeffs = terms.Coeffs();
+			std::vector<T> converted(coeffs.size());
+			for (uint32_t i = 0; i < coeffs.size(); ++i)
+				converted[i] = static_cast<T>(coeffs[i]);
+			SparseHornerMany(terms.Degrees().data(), converted.data(), (uint32_t) converted.size(), xs, out, n);
+		}
+		template<typename T>
+		void EvaluateMany(const std::vector<T> & xs, std::vector<T> & out) const {
+			out.resize(xs.size());
+			EvaluateMany(xs.data(), out.data(), xs.size());
+		}
+		// Integer roots with multiplicities, sorted by value. Throws std::domain_error for constant terms
+		// wider than 64 bits that can't be factored (see FindIntegerRoots)
+		std::vector<IntegerRoot> GetRootsWithMultiplicity() const {
+			CORE_PROFILE(INTEGER_ROOTS, terms.Size());
+			std::vector<uint64_t> degrees;
+			std::vector<BigInt> coeffs;
+			degrees.reserve(terms.Size());
+			coeffs.reserve(terms.Size());
+			for (Term term : terms) {
+				degrees.push_back(term.degree);
+				coeffs.push_back(Traits::ToBigInt(term.coeff));
+			}
+			return FindIntegerRoots(std::move(degrees), std::move(coeffs));
+		}
+		// Distinct integer roots, sorted
+		std::vector<int64_t> GetRoots() const {
+			std::vector<int64_t> result;
+			for (const IntegerRoot & root : GetRootsWithMultiplicity())
+				result.push_back(root.value);
+			return result;
+		}
+		// Intervals with rational ends isolating every distinct real root
+		std::vector<RootInterval> IsolateRealRoots() const {
+			CORE_PROFILE(REAL_ROOTS, terms.Size());
+			if (terms.Empty()) return std::vector<RootInterval>();
+			IntegerPolynomial dense(DenseLength<BigInt>(terms.Back().degree));
+			for (Term term : terms)
+				dense[term.degree] = Traits::ToBigInt(term.coeff);
+			return Core::IsolateRealRoots(dense);
+		}
+		Term GetTerm(uint32_t index) const {
+			if (index >= terms.Size())
+				throw std::out_of_range("Term with index " + std::to_string(index) + " isn't present in the polynomial.");
+			if (!terms.IsDense())
+				return Term{ terms.Degrees()[index], terms.Coeffs()[index] };
+			auto current = terms.begin();
+			for (uint32_t i = 0; i < index; ++i)
+				++current;
+			return *current;
+		}
+	};
+	using Polynomial = BasicPolynomial<int32_t>;
+
+	// Lazy expression over polynomials. Building one only records the operation, the work is done
+	// when the polynomial, a coefficient or a value is asked for, and only as much of it as needed:
+	// - a coefficient or low terms of a product only use operand terms up to that degree
+	// - a derivative of a product or a sum is evaluated at a point by the Leibniz rule, without the product
+	// - derivatives of derivatives are merged
+	// Structurally equal subexpressions (also built separately) are computed once per request
+	template<typename Coeff>
+	class BasicExpression {
+	public:
+		using Polynomial = BasicPolynomial<Coeff>;
+		enum class Kind : uint8_t { POLYNOMIAL, ADD, MULTIPLY, DERIVATIVE };
+	private:
+		struct Node {
+			Kind kind;
+			// order of DERIVATIVE
+			uint32_t parameter = 0;
+			// POLYNOMIAL only, a copy sharing terms with the original
+			Polynomial polynomial;
+			std::shared_ptr<const Node> lhs, rhs;
+			// Structural hash, same for a + b and b + a
+			uint64_t hash;
+			// Upper bound of the degree
+			uint64_t degree;
+		};
+		std::shared_ptr<const Node> node;
+
+		explicit BasicExpression(std::shared_ptr<const Node> node): node(std::move(node)) {}
+		static BasicExpression Binary(Kind kind, const BasicExpression & lhs, const BasicExpression & rhs) {
+			auto result = std::make_shared<Node>();
+			result->kind = kind;
+			result->lhs = lhs.node;
+			result->rhs = rhs.node;
+			result->hash = HashMix((uint64_t) kind) ^ (HashMix(lhs.node->hash) + HashMix(rhs.node->hash));
+			// saturates, Multiply itself reports products past 64 bits
+			if (kind == Kind::ADD)
+				result->degree = std::max(lhs.node->degree, rhs.node->degree);
+			else if (__builtin_add_overflow(lhs.node->degree, rhs.node->degree, &result->degree))
+				result->degree = UINT64_MAX;
+			return BasicExpression(std::move(result));
+		}
+		static bool Same(const Node *a, const Node *b) {
+			if (a == b) return true;
+			if (a->hash != b->hash || a->kind != b->kind || a->parameter != b->parameter) return false;
+			switch (a->kind) {
+			case Kind::POLYNOMIAL:
+				return a->polynomial == b->polynomial;
+			case Kind::DERIVATIVE:
+				return Same(a->lhs.get(), b->lhs.get());
+			default:
+				return (Same(a->lhs.get(), b->lhs.get()) && Same(a->rhs.get(), b->rhs.get()))
+					|| (Same(a->lhs.get(), b->rhs.get()) && Same(a->rhs.get(), b->lhs.get()));
+			}
+		}
+
+		// Intermediate results of one request, keyed by the first of structurally equal nodes
+		class Context {
+		private:
+			std::unordered_multimap<uint64_t, const Node*> by_hash;
+			std::unordered_map<const Node*, const Node*> canonical;
+			std::map<std::pair<const Node*, uint64_t>, Polynomial> materialized;
+		public:
+			const Node* Canonical(const Node *node) {
+				auto found = canonical.find(node);
+				if (found != canonical.end()) return found->second;
+				const Node *result = node;
+				auto range = by_hash.equal_range(node->hash);
+				for (auto it = range.first; it != range.second; ++it)
+					if (Same(it->second, node)) {
+						result = it->second;
+						break;
+					}
+				if (result == node)
+					by_hash.emplace(node->hash, node);
+				canonical.emplace(node, result);
+				return result;
+			}
+			// Polynomial with at least the terms up to max_degree, leaves aren't copied
+			const Polynomial & Operand(const Node *node, uint64_t max_degree) {
+				node = Canonical(node);
+				if (node->kind == Kind::POLYNOMIAL) return node->polynomial;
+				return Materialize(node, max_degree);
+			}
+			// Terms up to max_degree
+			const Polynomial & Materialize(const Node *node, uint64_t max_degree) {
+				node = Canonical(node);
+				max_degree = std::min(max_degree, node->degree);
+				auto key = std::make_pair(node, max_degree);
+				auto found = materialized.find(key);
+				if (found != materialized.end()) return found->second;
+				Polynomial result;
+				switch (node->kind) {
+				case Kind::POLYNOMIAL:
+					Truncate(node->polynomial, max_degree, result);
+					break;
+				case Kind::ADD:
+					Add(Materialize(node->lhs.get(), max_degree), Materialize(node->rhs.get(), max_degree), result);
+					break;
+				case Kind::MULTIPLY:
+					if (max_degree < node->degree)
+						MultiplyTruncated(Operand(node->lhs.get(), max_degree), Operand(node->rhs.get(), max_degree), max_degree, result);
+					else
+						Multiply(Operand(node->lhs.get(), max_degree), Operand(node->rhs.get(), max_degree), result);
+					break;
+				case Kind::DERIVATIVE:
+					Derivative(Materialize(node->lhs.get(), max_degree > UINT64_MAX - node->parameter ? UINT64_MAX : max_degree + node->parameter),
+							   node->parameter, result);
+					break;
+				}
+				return materialized.emplace(key, std::move(result)).first->second;
+			}
+			Coeff Coefficient(const Node *node, uint64_t degree) {
+				node = Canonical(node);
+				if (degree > node->degree) return Coeff(0);
+				switch (node->kind) {
+				case Kind::POLYNOMIAL:
+					return node->polynomial.GetCoefficient(degree);
+				case Kind::ADD:
+					return Coefficient(node->lhs.get(), degree) + Coefficient(node->rhs.get(), degree);
+				case Kind::MULTIPLY:
+					return CoefficientOfProduct(Operand(node->lhs.get(), degree), Operand(node->rhs.get(), degree), degree);
+				case Kind::DERIVATIVE:
+					if (degree > UINT64_MAX - node->parameter) return Coeff(0);
+					return FallingFactorials<Coeff>(node->parameter).Times(Coefficient(node->lhs.get(), degree + node->parameter),
+																			degree + node->parameter);
+				}
+				return Coeff(0);
+			}
+			// Value of the order-th derivative at x
+			template<typename T>
+			T Evaluate(const Node *node, uint32_t order, T x, std::map<std::pair<const Node*, uint32_t>, T> & values) {
+				node = Canonical(node);
+				auto key = std::make_pair(node, order);
+				auto found = values.find(key);
+				if (found != values.end()) return found->second;
+				T result = T(0);
+				switch (node->kind) {
+				case Kind::POLYNOMIAL:
+					if (!order) {
+						result = node->polynomial.Evaluate(x);
+					} else {
+						Polynomial derivative;
+						Derivative(node->polynomial, order, derivative);
+						result = derivative.Evaluate(x);
+					}
+					break;
+				case Kind::ADD:
+					result = Evaluate(node->lhs.get(), order, x, values) + Evaluate(node->rhs.get(), order, x, values);
+					break;
+				case Kind::MULTIPLY: {
+					// (fg)^(n) = sum over k of C(n, k) f^(k) g^(n - k), binomials go row by row of Pascal's triangle
+					std::vector<T> binomials(1, T(1));
+					for (uint32_t n = 1; n <= order; ++n) {
+						binomials.push_back(T(1));
+						for (uint32_t k = n - 1; k > 0; --k)
+							binomials[k] = binomials[k] + binomials[k - 1];
+					}
+					for (uint32_t k = 0; k <= order; ++k)
+						result += binomials[k] * Evaluate(node->lhs.get(), k, x, values) * Evaluate(node->rhs.get(), order - k, x, values);
+					break;
+				}
+				case Kind::DERIVATIVE:
+					result = Evaluate(node->lhs.get(), order + node->parameter, x, values);
+					break;
+				}
+				return values.emplace(key, result).first->second;
+			}
+		};
+	public:
+		// Zero polynomial
+		BasicExpression(): BasicExpression(Polynomial()) {}
+		BasicExpression(const Polynomial & p) {
+			auto leaf = std::make_shared<Node>();
+			leaf->kind = Kind::POLYNOMIAL;
+			leaf->polynomial = p;
+			leaf->hash = p.Hash();
+			leaf->degree = p.Empty() ? 0 : p.Degree();
+			node = std::move(leaf);
+		}
+		Kind GetKind() const {
+			return node->kind;
+		}
+		// Degree of the result is at most this
+		uint64_t DegreeBound() const {
+			return node->degree;
+		}
+		uint64_t Hash() const {
+			return node->hash;
+		}
+		friend BasicExpression operator+(const BasicExpression & lhs, const BasicExpression & rhs) {
+			return Binary(Kind::ADD, lhs, rhs);
+		}
+		friend BasicExpression operator*(const BasicExpression & lhs, const BasicExpression & rhs) {
+			return Binary(Kind::MULTIPLY, lhs, rhs);
+		}
+		BasicExpression GetDerivative(uint32_t n) const {
+			if (!n) return *this;
+			if (node->kind == Kind::DERIVATIVE && (uint64_t) node->parameter + n <= UINT32_MAX)
+				return BasicExpression(node->lhs).GetDerivative(node->parameter + n);
+			auto result = std::make_shared<Node>();
+			result->kind = Kind::DERIVATIVE;
+			result->parameter = n;
+			result->lhs = node;
+			result->hash = HashMix(node->hash ^ ((uint64_t) Kind::DERIVATIVE << 32 | n));
+			result->degree = node->degree > n ? node->degree - n : 0;
+			return BasicExpression(std::move(result));
+		}
+		Polynomial Materialize() const {
+			return Context().Materialize(node.get(), UINT64_MAX);
+		}
+		// Terms of degree up to max_degree only
+		Polynomial Materialize(uint64_t max_degree) const {
+			return Context().Materialize(node.get(), max_degree);
+		}
+		Coeff GetCoefficient(uint64_t degree) const {
+			return Context().Coefficient(node.get(), degree);
+		}
+		// Several coefficients share intermediate results
+		std::vector<Coeff> GetCoefficients(const std::vector<uint64_t> & degrees) const {
+			Context context;
+			std::vector<Coeff> result;
+			result.reserve(degrees.size());
+			for (uint64_t degree : degrees)
+				result.push_back(context.Coefficient(node.get(), degree));
+			return result;
+		}
+		template<typename T>
+		T Evaluate(T x) const {
+			std::map<std::pair<const Node*, uint32_t>, T> values;
+			return Context().Evaluate(node.get(), 0, x, values);
+		}
+	};
+	using Expression = BasicExpression<int32_t>;
+
+	// Polynomial in up to MonomialLayout::MAX_VARIABLES variables. Variables are the letters it was parsed from,
+	// sorted by character code, so x comes before y and x > y in lex order. Monomials are packed words of a
+	// MonomialLayout, a polynomial is kept as TermStorage over these words, so adding merges sorted words and
+	// multiplying is the same heap merge as for sparse univariate polynomials.
+	// Operands with different variables are brought to the union of them first, the result takes lhs's order
+	template<typename Coeff>
+	class BasicMultivariatePolynomial : public MultivariateGrammar {
+	public:
+		using Coefficient = Coeff;
+		// monomial is a word of the polynomial's layout
+		struct Term {
+			uint64_t monomial;
+			Coeff coeff;
+		};
+	private:
+		using Traits = CoefficientTraits<Coeff>;
+		std::string variables;
+		MonomialLayout layout;
+		// Ascending in the order
+		TermStorage<Coeff> terms;
+
+		// Terms of p over new_variables (a superset of p's) in new_layout,
+		// throws std::overflow_error if some exponent doesn't fit the narrower fields
+		static TermStorage<Coeff> Repack(const BasicMultivariatePolynomial & p, const std::string & new_variables, const MonomialLayout & new_layout) {
+			std::vector<uint32_t> index(p.variables.size());
+			for (uint32_t i = 0; i < p.variables.size(); ++i)
+				index[i] = (uint32_t) new_variables.find(p.variables[i]);
+			std::vector<uint64_t> monomials;
+			std::vector<Coeff> coeffs;
+			monomials.reserve(p.terms.Size());
+			coeffs.reserve(p.terms.Size());
+			uint64_t exponents[MonomialLayout::MAX_VARIABLES], packed[MonomialLayout::MAX_VARIABLES];
+			for (typename TermStorage<Coeff>::Term term : p.terms) {
+				p.layout.Unpack(term.degree, exponents);
+				std::fill(packed, packed + new_layout.Variables(), 0);
+				for (uint32_t i = 0; i < index.size(); ++i)
+					packed[index[i]] = exponents[i];
+				uint64_t monomial;
+				if (!new_layout.Pack(packed, monomial))
+					throw std::overflow_error("Exponents don't fit a monomial of " + std::to_string(new_layout.Variables()) + " variables.");
+				monomials.push_back(monomial);
+				coeffs.push_back(term.coeff);
+			}
+			TermStorage<Coeff> result;
+			result.AssignUnsorted(std::move(monomials), std::move(coeffs));
+			return result;
+		}
+		// Terms of lhs and rhs over the same variables and layout, shared with the operands when nothing changes
+		static void Unify(const BasicMultivariatePolynomial & lhs, const BasicMultivariatePolynomial & rhs,
+			std::string & new_variables, MonomialLayout & new_layout, TermStorage<Coeff> & l, TermStorage<Coeff> & r) {
+			if (lhs.variables == rhs.variables && lhs.layout == rhs.layout) {
+				new_variables = lhs.variables;
+				new_layout = lhs.layout;
+				l = lhs.terms;
+				r = rhs.terms;
+				return;
+			}
+			new_variables.clear();
+			std::set_union(lhs.variables.begin(), lhs.variables.end(), rhs.variables.begin(), rhs.variables.end(),
+				std::back_inserter(new_variables));
+			new_layout = MonomialLayout((uint32_t) new_variables.size(), lhs.layout.Order());
+			l = lhs.variables == new_variables && lhs.layout == new_layout ? lhs.terms : Repack(lhs, new_variables, new_layout);
+			r = rhs.variables == new_variables && rhs.layout == new_layout ? rhs.terms : Repack(rhs, new_variables, new_layout);
+		}
+		uint32_t VariableIndex(char letter) const {
+			size_t index = variables.find(letter);
+			if (index == std::string::npos)
+				throw std::invalid_argument(std::string("Polynomial has no variable ") + letter + ".");
+			return (uint32_t) index;
+		}
+		std::string TermToString(const typename TermStorage<Coeff>::Term & term, bool first) const {
+			std::string result;
+			if (!first)
+				result += ' ';
+			bool negative = Traits::IsNegative(term.coeff);
+			if (!first && !negative)
+				result += "+ ";
+			else if (negative)
+				result += "- ";
+			Coeff magnitude = Traits::Abs(term.coeff);
+			if (magnitude != Coeff(1) || term.degree == 0)
+				result += Traits::ToString(magnitude);
+			for (uint32_t i = 0; i < variables.size(); ++i) {
+				uint64_t exponent = layout.Exponent(term.degree, i);
+				if (!exponent) continue;
+				result += variables[i];
+				if (exponent > 1)
+					result += '^' + std::to_string(exponent);
+			}
+			return result;
+		}
+
+	public:
+		BasicMultivariatePolynomial() {}
+		std::pair<ErrorType, uint32_t> InitFromString(std::string_view str, MonomialOrder order = MonomialOrder::GRADED_LEX) {
+			CORE_PROFILE(MULTIVARIATE_PARSE, str.size());
+			std::vector<Factor> factors;
+			std::vector<uint32_t> ends;
+			std::vector<Coeff> coeffs;
+			std::array<bool, 128> used{};
+			std::pair<ErrorType, uint32_t> error = ScanMultivariate(str,
+				[&factors, &ends, &coeffs, &used](bool negative, std::string_view digits, const std::vector<Factor> & term_factors) {
+					Coeff coefficient(digits.empty() ? 1 : 0);
+					for (char digit : digits)
+						coefficient = coefficient * Coeff(10) + Coeff((int32_t) digit - (int32_t) '0');
+					if (negative) coefficient = -coefficient;
+					for (const Factor & factor : term_factors)
+						used[(uint8_t) factor.letter] = true;
+					factors.insert(factors.end(), term_factors.begin(), term_factors.end());
+					ends.push_back((uint32_t) factors.size());
+					coeffs.push_back(std::move(coefficient));
+				});
+			if (error.first != OK)
+				return error;
+			std::string new_variables;
+			std::array<uint32_t, 128> index{};
+			for (uint32_t c = 0; c < 128; ++c)
+				if (used[c]) {
+					index[c] = (uint32_t) new_variables.size();
+					new_variables.push_back((char) c);
+				}
+			MonomialLayout new_layout((uint32_t) new_variables.size(), order);
+			std::vector<uint64_t> monomials(coeffs.size());
+			uint64_t exponents[MonomialLayout::MAX_VARIABLES];
+			for (uint32_t t = 0, begin = 0; t < coeffs.size(); begin = ends[t++]) {
+				std::fill(exponents, exponents + new_variables.size(), 0);
+				for (uint32_t f = begin; f < ends[t]; ++f) {
+					uint64_t & exponent = exponents[index[(uint8_t) factors[f].letter]];
+					if (__builtin_add_overflow(exponent, factors[f].degree, &exponent) || exponent > new_layout.MaxExponent())
+						return std::make_pair(DEGREE_TOO_LARGE, factors[f].position);
+				}
+				// Only a total degree can be too large here, it's reported at the last variable of the term
+				if (!new_layout.Pack(exponents, monomials[t]))
+					return std::make_pair(DEGREE_TOO_LARGE, factors[ends[t] - 1].position);
+			}
+			variables = std::move(new_variables);
+			layout = new_layout;
+			terms.AssignUnsorted(std::move(monomials), std::move(coeffs));
+			return std::make_pair(OK, 0);
+		}
+		// Stops with "..." once max_length is exceeded, highest terms first
+		std::string ToString(uint32_t max_length = UINT32_MAX) const {
+			if (terms.Empty()) return std::string("0");
+			auto current = terms.end(), first = terms.begin();
+			std::string result = TermToString(*--current, true);
+			while (current != first && result.size() <= max_length)
+				result += TermToString(*--current, false);
+			if (result.size() > max_length) {
+				result.resize(max_length);
+				result += "...";
+			}
+			return result;
+		}
+		std::string ExportAsString() const {
+			return ToString();
+		}
+		const std::string & Variables() const {
+			return variables;
+		}
+		const MonomialLayout & Layout() const {
+			return layout;
+		}
+		MonomialOrder Order() const {
+			return layout.Order();
+		}
+		// Same polynomial with monomials ordered differently
+		void SetOrder(MonomialOrder order) {
+			if (order == layout.Order()) return;
+			MonomialLayout new_layout((uint32_t) variables.size(), order);
+			terms = Repack(*this, variables, new_layout);
+			layout = new_layout;
+		}
+		uint32_t Size() const {
+			return terms.Size();
+		}
+		bool Empty() const {
+			return terms.Empty();
+		}
+		// Terms from the lowest in the order
+		Term GetTerm(uint32_t index) const {
+			if (index >= terms.Size())
+				throw std::out_of_range("Term with index " + std::to_string(index) + " isn't present in the polynomial.");
+			if (!terms.IsDense())
+				return Term{ terms.Degrees()[index], terms.Coeffs()[index] };
+			auto current = terms.begin();
+			for (uint32_t i = 0; i < index; ++i)
+				++current;
+			return Term{ (*current).degree, (*current).coeff };
+		}
+		// exponents[i] is the exponent of Variables()[i], 0 if the monomial can't be in this polynomial
+		Coeff GetCoefficient(const std::vector<uint64_t> & exponents) const {
+			if (exponents.size() != variables.size())
+				throw std::invalid_argument("Expected an exponent for every variable.");
+			uint64_t monomial;
+			if (!layout.Pack(exponents.data(), monomial)) return Coeff(0);
+			return terms.Get(monomial);
+		}
+		// Highest total degree, 0 for the zero polynomial
+		uint64_t TotalDegree() const {
+			if (terms.Empty()) return 0;
+			if (layout.Order() == MonomialOrder::GRADED_LEX)
+				return layout.Degree(terms.Back().degree);
+			uint64_t degree = 0;
+			for (typename TermStorage<Coeff>::Term term : terms)
+				degree = std::max(degree, layout.Degree(term.degree));
+			return degree;
+		}
+		// Highest exponent of the variable, 0 if there's no such variable
+		uint64_t Degree(char letter) const {
+			size_t index = variables.find(letter);
+			if (index == std::string::npos) return 0;
+			uint64_t degree = 0;
+			for (typename TermStorage<Coeff>::Term term : terms)
+				degree = std::max(degree, layout.Exponent(term.degree, (uint32_t) index));
+			return degree;
+		}
+		uint64_t Hash() const {
+			uint64_t hash = terms.Hash([this]() {
+				uint64_t result = terms.Size();
+				for (typename TermStorage<Coeff>::Term term : terms)
+					result = HashMix(result ^ term.degree) ^ Traits::Hash(term.coeff);
+				return HashMix(result);
+			});
+			for (char letter : variables)
+				hash = HashMix(hash ^ (uint8_t) letter);
+			return HashMix(hash ^ (uint64_t) layout.Order());
+		}
+		bool operator==(const BasicMultivariatePolynomial & other) const {
+			return variables == other.variables && layout == other.layout && terms == other.terms;
+		}
+		bool operator!=(const BasicMultivariatePolynomial & other) const {
+			return !(*this == other);
+		}
+		// values[i] is the value of Variables()[i]. Powers of every variable come from one table of squares
+		template<typename T>
+		T Evaluate(const std::vector<T> & values) const {
+			if (values.size() != variables.size())
+				throw std::invalid_argument("Expected a value for every variable.");
+			std::vector<PowerTable<T>> powers;
+			powers.reserve(variables.size());
+			for (uint32_t i = 0; i < variables.size(); ++i)
+				powers.emplace_back(values[i], Degree(variables[i]));
+			T result = T(0);
+			for (typename TermStorage<Coeff>::Term term : terms) {
+				T value = (T) term.coeff;
+				for (uint32_t i = 0; i < variables.size(); ++i)
+					if (uint64_t exponent = layout.Exponent(term.degree, i))
+						value *= powers[i].Power(exponent);
+				result += value;
+			}
+			return result;
+		}
+		friend void Add(const BasicMultivariatePolynomial &lhs, const BasicMultivariatePolynomial &rhs, BasicMultivariatePolynomial &res) {
+			CORE_PROFILE(MULTIVARIATE_ADD, lhs.terms.Size() + rhs.terms.Size());
+			std::string new_variables;
+			MonomialLayout new_layout;
+			TermStorage<Coeff> l, r, sum;
+			Unify(lhs, rhs, new_variables, new_layout, l, r);
+			sum.Reserve(l.Size() + r.Size());
+			auto lp = l.begin(), rp = r.begin(), lend = l.end(), rend = r.end();
+			while (lp != lend && rp != rend) {
+				typename TermStorage<Coeff>::Term lt = *lp, rt = *rp;
+				if (lt.degree == rt.degree) {
+					Coeff coeff = WrappingAdd(lt.coeff, rt.coeff);
+					if (coeff != Coeff(0))
+						sum.PushBack(lt.degree, std::move(coeff));
+					++lp;
+					++rp;
+				} else if (lt.degree < rt.degree) {
+					sum.PushBack(lt.degree, lt.coeff);
+					++lp;
+				} else {
+					sum.PushBack(rt.degree, rt.coeff);
+					++rp;
+				}
+			}
+			for (; lp != lend; ++lp)
+				sum.PushBack((*lp).degree, (*lp).coeff);
+			for (; rp != rend; ++rp)
+				sum.PushBack((*rp).degree, (*rp).coeff);
+			sum.Normalize();
+			res.variables = std::move(new_variables);
+			res.layout = new_layout;
+			res.terms = std::move(sum);
+		}
+		// Throws std::overflow_error when some exponent of the product doesn't fit the layout
+		friend void Multiply(const BasicMultivariatePolynomial &lhs, const BasicMultivariatePolynomial &rhs, BasicMultivariatePolynomial &res) {
+			CORE_PROFILE(MULTIVARIATE_MULTIPLY, lhs.terms.Size() + rhs.terms.Size());
+			std::string new_variables;
+			MonomialLayout new_layout;
+			TermStorage<Coeff> l, r, product;
+			Unify(lhs, rhs, new_variables, new_layout, l, r);
+			if (!l.Empty() && !r.Empty()) {
+				// Words have their guard bits clear, so their sums don't wrap. Same choice as for univariate products,
+				// a dense array over words only happens when there's about a term per word
+				if ((l.IsDense() && r.IsDense()) || l.Back().degree + r.Back().degree < (uint64_t) l.Size() * r.Size()) {
+					std::vector<Coeff> ld, rd, values;
+					l.ToDense(ld);
+					r.ToDense(rd);
+					MultiplyDense(ld, rd, values);
+					product.AssignDense(std::move(values));
+				} else {
+					std::vector<uint64_t> ld, rd, product_monomials;
+					std::vector<Coeff> lc, rc, product_coeffs;
+					l.ToSparse(ld, lc);
+					r.ToSparse(rd, rc);
+					MultiplySparse(ld, lc, rd, rc, product_monomials, product_coeffs);
+					product.AssignSparse(std::move(product_monomials), std::move(product_coeffs));
+				}
+				// Fields don't carry into each other, so an exponent that got too large stays visible in its guard bit
+				for (typename TermStorage<Coeff>::Term term : product)
+					if (new_layout.Overflows(term.degree))
+						throw std::overflow_error("Exponent of the product doesn't fit a monomial of "
+							+ std::to_string(new_layout.Variables()) + " variables.");
+			}
+			res.variables = std::move(new_variables);
+			res.layout = new_layout;
+			res.terms = std::move(product);
+		}
+		// n-th partial derivative by the variable, wraps like the univariate Derivative. Subtracting the same exponent
+		// from every monomial keeps them in order, so the terms stay sorted
+		friend void Derivative(const BasicMultivariatePolynomial & p, char letter, uint32_t n, BasicMultivariatePolynomial & res) {
+			CORE_PROFILE(MULTIVARIATE_DERIVATIVE, p.terms.Size());
+			uint32_t variable = p.VariableIndex(letter);
+			FallingFactorials<Coeff> factorials(n);
+			std::vector<uint64_t> monomials;
+			std::vector<Coeff> coeffs;
+			uint64_t shift = n <= p.layout.MaxExponent() ? p.layout.Power(variable, n) : 0;
+			for (typename TermStorage<Coeff>::Term term : p.terms) {
+				uint64_t exponent = p.layout.Exponent(term.degree, variable);
+				if (exponent < n) continue;
+				Coeff coeff = factorials.Times(term.coeff, exponent);
+				if (coeff == Coeff(0)) continue;
+				monomials.push_back(term.degree - shift);
+				coeffs.push_back(std::move(coeff));
+			}
+			TermStorage<Coeff> derivative;
+			derivative.AssignSparse(std::move(monomials), std::move(coeffs));
+			res.variables = p.variables;
+			res.layout = p.layout;
+			res.terms = std::move(derivative);
+		}
+		// Derivative that returns false instead of wrapping, res isn't touched then
+		friend bool CheckedDerivative(const BasicMultivariatePolynomial & p, char letter, uint32_t n, BasicMultivariatePolynomial & res) {
+			if constexpr (std::is_integral<Coeff>::value || std::is_same<Coeff, Int128>::value) {
+				uint32_t variable = p.VariableIndex(letter);
+				for (typename TermStorage<Coeff>::Term term : p.terms) {
+					uint64_t exponent = p.layout.Exponent(term.degree, variable);
+					if (exponent < n) continue;
+					Coeff c = term.coeff;
+					for (uint32_t i = 0; i < n; ++i) {
+						uint64_t factor = exponent - i;
+						if ((uint64_t) (Coeff) factor != factor || __builtin_mul_overflow(c, (Coeff) factor, &c))
+							return false;
+					}
+				}
+			}
+			Derivative(p, letter, n, res);
+			return true;
+		}
+	};
+	using MultivariatePolynomial = BasicMultivariatePolynomial<int32_t>;
+
+	// Work-stealing thread pool. Every worker owns a deque: it takes its own tasks from the back
+	// and steals from the front of the others' when it runs out. Threads waiting in ParallelFor
+	// steal as well, so nested parallel calls can't deadlock
+	class ThreadPool {
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+		std::atomic<uint32_t> pending{ 0 };
+		std::atomic<uint32_t> next_queue{ 0 };
+		bool stopping = false;
+
+		bool TakeOwn(uint32_t self, std::function<void()> & task) {
+			std::lock_guard<std::mutex> lock(queues[self]->mutex);
+			if (queues[self]->tasks.empty()) return false;
+			task = std::move(queues[self]->tasks.back());
+			queues[self]->tasks.pop_back();
+			--pending;
+			return true;
+		}
+		bool Steal(uint32_t self, std::function<void()> & task) {
+			for (uint32_t k = 1; k <= queues.size(); ++k) {
+				Queue & victim = *queues[(self + k) % queues.size()];
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (victim.tasks.empty()) continue;
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				--pending;
+				return true;
+			}
+			return false;
+		}
+		void WorkerLoop(uint32_t self) {
+			for (;;) {
+				std::function<void()> task;
+				if (TakeOwn(self, task) || Steal(self, task)) {
+					task();
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(sleep_mutex);
+				wake.wait(lock, [this] { return stopping || pending > 0; });
+				if (stopping && !pending) return;
+			}
+		}
+
+	public:
+		// 0 threads means one per hardware thread
+		explicit ThreadPool(uint32_t threads = 0) {
+			if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+			for (uint32_t i = 0; i < threads; ++i)
+				queues.push_back(std::make_unique<Queue>());
+			for (uint32_t i = 0; i < threads; ++i)
+				workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		}
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool& operator=(const ThreadPool &) = delete;
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (std::thread & worker : workers)
+				worker.join();
+		}
+		// Pool shared by everything that doesn't get one explicitly
+		static ThreadPool & Default() {
+			static ThreadPool pool;
+			return pool;
+		}
+		uint32_t Threads() const {
+			return (uint32_t) workers.size();
+		}
+		void Submit(std::function<void()> task) {
+			uint32_t queue = next_queue++ % (uint32_t) queues.size();
+			{
+				std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+				queues[queue]->tasks.push_back(std::move(task));
+			}
+			++pending;
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
 			}
-			updated = true;
-			return std::make_pair(OK, 0);
+			wake.notify_one();
 		}
-		std::string ExportAsString() {
-			if (!updated)
-				return string_view;
-			if (list.Empty()) return std::string("0");
-			std::string result;
-			// As list is kept sorted in ascending order,
-			// And we want polynomial with descending powers,
-			// We have to go from back to front
-			result = TermToString(list.Tail()->data, true);
-			List<Term>::Node* current = list.Tail()->prev;
-			while (current) {
-				result += TermToString(current->data, false);
-				current = current->prev;
+		// Calls body(i) for every i in [0, count) and returns when all calls are done.
+		// The range is cut into a few chunks per thread, the first exception is rethrown here
+		template<typename F>
+		void ParallelFor(uint32_t count, F body) {
+			if (!count) return;
+			uint32_t chunks = std::min(count, Threads() * 4);
+			// Guarded by done_mutex, the last chunk wakes the caller
+			uint32_t remaining = chunks;
+			std::mutex done_mutex;
+			std::condition_variable done;
+			std::exception_ptr error;
+			std::mutex error_mutex;
+			// Workers check the caller's token
+			const CancellationToken *token = CurrentCancellation();
+			for (uint32_t c = 0; c < chunks; ++c) {
+				uint32_t begin = (uint32_t) ((uint64_t) count * c / chunks);
+				uint32_t end = (uint32_t) ((uint64_t) count * (c + 1) / chunks);
+				Submit([&, begin, end, token] {
+					CancellationScope scope(token);
+					try {
+						for (uint32_t i = begin; i < end; ++i)
+							body(i);
+					} catch (...) {
+						std::lock_guard<std::mutex> lock(error_mutex);
+						if (!error) error = std::current_exception();
+					}
+					std::lock_guard<std::mutex> lock(done_mutex);
+					if (!--remaining)
+						done.notify_one();
+				});
 			}
-			updated = false;
-			return string_view = result;
+			// The caller helps while there's something to steal, then sleeps until the chunks still running finish.
+			// Nothing is queued once a steal fails, tasks submitted later are run by their own callers
+			for (std::function<void()> task; Steal(0, task); task = nullptr)
+				task();
+			{
+				std::unique_lock<std::mutex> lock(done_mutex);
+				done.wait(lock, [&remaining] { return !remaining; });
+			}
+			if (error) std::rethrow_exception(error);
 		}
-		uint32_t Size() const {
-			return list.Size();
+	};
+
+	// Read-only view of a whole file. Memory-mapped where possible, read into memory otherwise
+	class MappedFile {
+	private:
+		const char *data = nullptr;
+		uint64_t size = 0;
+		bool mapped = false;
+		std::string buffer;
+
+	public:
+		MappedFile() {}
+		explicit MappedFile(const std::string & path) {
+			Open(path);
 		}
-		bool Empty() const {
-			return list.Empty();
+		MappedFile(const MappedFile &) = delete;
+		MappedFile& operator=(const MappedFile &) = delete;
+		~MappedFile() {
+			Close();
 		}
-		friend void Add(const Polynomial &lhs, const Polynomial &rhs, Polynomial &res) {
-			res.var = lhs.var;
-			res.list.Clear();
-			auto lp = lhs.list.Head(), rp = rhs.list.Head();
-			while (lp && rp) {
-				if (lp->data.degree == rp->data.degree) {
-					res.list.InsertBack(lp->data);
-					res.list.Tail()->data.coeff += rp->data.coeff;
-					if (res.list.Tail()->data.coeff == 0)
-						res.list.Delete(res.list.Tail());
-					lp = lp->next;
-					rp = rp->next;
-				} else if (lp->data.degree < rp->data.degree) {
-					res.list.InsertBack(lp->data);
-					lp = lp->next;
-				} else {
-					res.list.InsertBack(rp->data);
-					rp = rp->next;
+		bool Open(const std::string & path) {
+			Close();
+#if defined(__unix__) || defined(__APPLE__)
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return false;
+			struct stat info;
+			if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+				void *memory = ::mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (memory != MAP_FAILED) {
+					::madvise(memory, (size_t) info.st_size, MADV_SEQUENTIAL);
+					data = static_cast<const char*>(memory);
+					size = (uint64_t) info.st_size;
+					mapped = true;
+					::close(fd);
+					return true;
 				}
 			}
-			while (lp) {
-				res.list.InsertBack(lp->data);
-				lp = lp->next;
+			::close(fd);
+#endif
+			std::ifstream input(path, std::ios::binary);
+			if (!input) return false;
+			buffer.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+			data = buffer.data();
+			size = buffer.size();
+			return true;
+		}
+		void Close() {
+#if defined(__unix__) || defined(__APPLE__)
+			if (mapped)
+				::munmap(const_cast<char*>(data), (size_t) size);
+#endif
+			mapped = false;
+			buffer.clear();
+			data = nullptr;
+			size = 0;
+		}
+		bool IsOpen() const {
+			return data != nullptr || mapped;
+		}
+		std::string_view View() const {
+			return std::string_view(data ? data : "", (size_t) size);
+		}
+	};
+
+	// A line of a .pln file that couldn't be parsed, line is 1-based, offset is where the line starts in the file
+	struct LoadError {
+		uint64_t line;
+		uint64_t offset;
+		PolynomialGrammar::ErrorType error;
+		uint32_t position;
+	};
+	struct LoadReport {
+		bool opened = true;
+		bool cancelled = false;
+		uint64_t loaded = 0;
+		// Lines with several variables, they go to the multivariate list of the base and aren't in loaded
+		uint64_t multivariate = 0;
+		std::vector<LoadError> errors;
+	};
+	// Gets bytes processed and total bytes, returning false cancels loading
+	using LoadProgress = std::function<bool(uint64_t, uint64_t)>;
+
+	// Binary .plnb layout, integers are little endian:
+	// header: "PLNB", version u16, reserved u16, coefficient tag u64
+	// records: 'P' and Polynomial::Encode for every polynomial
+	// index: 'I' and u64 offset of every record, for random access
+	// footer: index offset u64, count u64, CRC-32 of everything before the checksum u32, "PLNE"
+	struct BinaryFormat {
+		enum Error : uint8_t {
+			OK = 0,
+			CANT_OPEN = 1,
+			BAD_MAGIC = 2,
+			BAD_VERSION = 3,
+			WRONG_COEFFICIENT = 4, // file was written for another coefficient ring
+			CORRUPTED = 5,
+			BAD_CHECKSUM = 6
+		};
+		static constexpr char MAGIC[4] = { 'P', 'L', 'N', 'B' };
+		static constexpr char END_MAGIC[4] = { 'P', 'L', 'N', 'E' };
+		static constexpr uint16_t VERSION = 1;
+		static constexpr uint8_t RECORD = 'P', INDEX = 'I';
+		static constexpr uint32_t HEADER_SIZE = 16, FOOTER_SIZE = 24;
+	};
+
+	template<typename Coeff>
+	class BinaryPolynomialWriter {
+	private:
+		ByteWriter writer;
+		std::vector<uint64_t> offsets;
+		bool finished = false;
+
+	public:
+		explicit BinaryPolynomialWriter(std::ostream & output): writer(output) {
+			writer.Write(BinaryFormat::MAGIC, 4);
+			writer.WriteFixed(BinaryFormat::VERSION);
+			writer.WriteFixed((uint16_t) 0);
+			writer.WriteFixed(CoefficientTraits<Coeff>::BINARY_TAG);
+		}
+		~BinaryPolynomialWriter() {
+			Finish();
+		}
+		void Write(const BasicPolynomial<Coeff> & p) {
+			offsets.push_back(writer.Position());
+			writer.WriteByte(BinaryFormat::RECORD);
+			p.Encode(writer);
+		}
+		// Writes index and footer, nothing can be written after that
+		void Finish() {
+			if (finished) return;
+			finished = true;
+			uint64_t index_offset = writer.Position();
+			writer.WriteByte(BinaryFormat::INDEX);
+			for (uint64_t offset : offsets)
+				writer.WriteFixed(offset);
+			writer.WriteFixed(index_offset);
+			writer.WriteFixed((uint64_t) offsets.size());
+			writer.WriteFixed(writer.Checksum());
+			writer.Write(BinaryFormat::END_MAGIC, 4);
+			writer.Flush();
+		}
+	};
+
+	// Reads polynomials one by one with Next, or by index with Read once OpenIndex succeeded (needs a seekable stream)
+	template<typename Coeff>
+	class BinaryPolynomialReader {
+	private:
+		std::istream & input;
+		ByteReader reader;
+		std::vector<uint64_t> index;
+		bool header_read = false, done = false;
+
+		BinaryFormat::Error ReadHeader(ByteReader & from) {
+			char magic[4];
+			uint16_t version, reserved;
+			uint64_t tag;
+			if (!from.Read(magic, 4) || !std::equal(magic, magic + 4, BinaryFormat::MAGIC))
+				return BinaryFormat::BAD_MAGIC;
+			if (!from.ReadFixed(version) || !from.ReadFixed(reserved))
+				return BinaryFormat::CORRUPTED;
+			if (version != BinaryFormat::VERSION)
+				return BinaryFormat::BAD_VERSION;
+			if (!from.ReadFixed(tag))
+				return BinaryFormat::CORRUPTED;
+			if (tag != CoefficientTraits<Coeff>::BINARY_TAG)
+				return BinaryFormat::WRONG_COEFFICIENT;
+			return BinaryFormat::OK;
+		}
+
+	public:
+		explicit BinaryPolynomialReader(std::istream & input): input(input), reader(input) {}
+		// Sets end to true instead of reading a polynomial once the records are over,
+		// the checksum of the whole file is verified at that point
+		BinaryFormat::Error Next(BasicPolynomial<Coeff> & p, bool & end) {
+			end = false;
+			if (done) {
+				end = true;
+				return BinaryFormat::OK;
+			}
+			if (!header_read) {
+				BinaryFormat::Error error = ReadHeader(reader);
+				if (error != BinaryFormat::OK) return error;
+				header_read = true;
 			}
-			while (rp) {
-				res.list.InsertBack(rp->data);
-				rp = rp->next;
+			uint64_t position = reader.Position();
+			uint8_t tag;
+			if (!reader.ReadByte(tag))
+				return BinaryFormat::CORRUPTED;
+			if (tag == BinaryFormat::RECORD)
+				return p.Decode(reader) ? BinaryFormat::OK : BinaryFormat::CORRUPTED;
+			if (tag != BinaryFormat::INDEX)
+				return BinaryFormat::CORRUPTED;
+			// Every record starts before the index, so the first value equal to its offset is the footer
+			uint64_t value, entries = 0, count;
+			for (;;) {
+				if (!reader.ReadFixed(value))
+					return BinaryFormat::CORRUPTED;
+				if (value == position) break;
+				++entries;
 			}
+			if (!reader.ReadFixed(count) || count != entries)
+				return BinaryFormat::CORRUPTED;
+			uint32_t expected = reader.Checksum(), checksum;
+			char magic[4];
+			if (!reader.ReadFixed(checksum) || !reader.Read(magic, 4)
+				|| !std::equal(magic, magic + 4, BinaryFormat::END_MAGIC))
+				return BinaryFormat::CORRUPTED;
+			if (checksum != expected)
+				return BinaryFormat::BAD_CHECKSUM;
+			done = end = true;
+			return BinaryFormat::OK;
 		}
-		friend void MultiplyByTerm(const Polynomial &lhs, const Term &term, Polynomial &res) {
-			res.var = lhs.var;
-			res.list.Clear();
-			auto ptr = lhs.list.Head();
-			while (ptr) {
-				Term new_term;
-				new_term.degree = ptr->data.degree + term.degree;
-				new_term.coeff = ptr->data.coeff * term.coeff;
-				res.list.InsertBack(new_term);
-				ptr = ptr->next;
-			}
-		}
-		friend void Multiply(const Polynomial &lhs, const Polynomial &rhs, Polynomial &res) {
-			auto ptr = lhs.list.Head();
-			while (ptr) {
-				Polynomial temp_polynomial, temp_res;
-				MultiplyByTerm(rhs, ptr->data, temp_polynomial);
-				Add(res, temp_polynomial, temp_res);
-				res = temp_res;
-				ptr = ptr->next;
-			}
-		}
-		friend void Derivative(const Polynomial & p, uint32_t n, Polynomial & res) {
-			List<Term>::Node *current = p.list.Head();
-			while (current) {
-				if (current->data.degree >= n) {
-					Term new_term = current->data;
-					for (uint32_t i = 0; i < n; ++i) {
-						new_term.coeff *= new_term.degree;
-						--new_term.degree;
-					}
-					res.list.InsertBack(new_term);
+		BinaryFormat::Error OpenIndex() {
+			input.clear();
+			input.seekg(0, std::ios::end);
+			std::streamoff size = input.tellg();
+			if (size < (std::streamoff) (BinaryFormat::HEADER_SIZE + 1 + BinaryFormat::FOOTER_SIZE))
+				return BinaryFormat::CORRUPTED;
+			input.seekg(0);
+			ByteReader header(input);
+			BinaryFormat::Error error = ReadHeader(header);
+			if (error != BinaryFormat::OK) return error;
+			input.clear();
+			input.seekg(size - (std::streamoff) BinaryFormat::FOOTER_SIZE);
+			ByteReader footer(input, (uint64_t) size - BinaryFormat::FOOTER_SIZE);
+			uint64_t index_offset, count;
+			if (!footer.ReadFixed(index_offset) || !footer.ReadFixed(count)
+				|| index_offset + 1 + count * 8 + BinaryFormat::FOOTER_SIZE != (uint64_t) size)
+				return BinaryFormat::CORRUPTED;
+			input.clear();
+			input.seekg((std::streamoff) index_offset);
+			ByteReader entries(input, index_offset);
+			uint8_t tag;
+			if (!entries.ReadByte(tag) || tag != BinaryFormat::INDEX)
+				return BinaryFormat::CORRUPTED;
+			index.resize(count);
+			for (uint64_t & offset : index)
+				if (!entries.ReadFixed(offset) || offset >= index_offset)
+					return BinaryFormat::CORRUPTED;
+			return BinaryFormat::OK;
+		}
+		uint64_t Size() const {
+			return index.size();
+		}
+		BinaryFormat::Error Read(uint64_t i, BasicPolynomial<Coeff> & p) {
+			if (i >= index.size())
+				throw std::out_of_range("Polynomial with index " + std::to_string(i) + " isn't present in the file.");
+			input.clear();
+			input.seekg((std::streamoff) index[i]);
+			ByteReader record(input, index[i]);
+			uint8_t tag;
+			if (!record.ReadByte(tag) || tag != BinaryFormat::RECORD || !p.Decode(record))
+				return BinaryFormat::CORRUPTED;
+			return BinaryFormat::OK;
+		}
+	};
+
+	struct CacheStats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		uint32_t size = 0;
+		uint32_t capacity = 0;
+		CacheStats& operator+=(const CacheStats & other) {
+			hits += other.hits;
+			misses += other.misses;
+			evictions += other.evictions;
+			size += other.size;
+			capacity += other.capacity;
+			return *this;
+		}
+	};
+	// Bounded map which forgets the least recently used entries first.
+	// Key needs Hash() and ==, entries with equal hashes are told apart by comparing keys
+	template<typename Key, typename Value>
+	class LruCache {
+	public:
+		struct Entry {
+			Key key;
+			Value value;
+		};
+	private:
+		using Node = typename List<Entry>::Node;
+		// Front is the most recently used
+		List<Entry> entries;
+		std::unordered_multimap<uint64_t, Node*> index;
+		CacheStats stats;
+
+		Node* Lookup(const Key & key) const {
+			auto range = index.equal_range(key.Hash());
+			for (auto it = range.first; it != range.second; ++it)
+				if (it->second->data.key == key)
+					return it->second;
+			return nullptr;
+		}
+		void EvictLast() {
+			Node *last = entries.Tail();
+			auto range = index.equal_range(last->data.key.Hash());
+			for (auto it = range.first; it != range.second; ++it)
+				if (it->second == last) {
+					index.erase(it);
+					break;
 				}
-				current = current->next;
+			entries.Delete(last);
+			++stats.evictions;
+		}
+	public:
+		explicit LruCache(uint32_t capacity) {
+			stats.capacity = capacity;
+		}
+		// nullptr if there's no such key
+		const Value* Find(const Key & key) {
+			Node *node = Lookup(key);
+			if (!node) {
+				++stats.misses;
+				return nullptr;
 			}
+			++stats.hits;
+			entries.Splice(entries.Head(), entries, node);
+			return &node->data.value;
 		}
-		template<typename T>
-		T Evaluate(T x) const {
-			List<Term>::Node *current = list.Head();
-			T power = 1;
-			int32_t degree = 0;
-			T result = 0;
-			while (current) {
-				power *= Binpow(x, current->data.degree - degree);
-				degree = current->data.degree;
-				result += current->data.coeff * power;
-				current = current->next;
+		void Insert(Key key, Value value) {
+			if (!stats.capacity) return;
+			if (Node *node = Lookup(key)) {
+				node->data.value = std::move(value);
+				entries.Splice(entries.Head(), entries, node);
+				return;
 			}
+			uint64_t hash = key.Hash();
+			index.emplace(hash, entries.EmplaceFront(Entry{ std::move(key), std::move(value) }));
+			while (entries.Size() > stats.capacity)
+				EvictLast();
+		}
+		void SetCapacity(uint32_t capacity) {
+			stats.capacity = capacity;
+			while (entries.Size() > capacity)
+				EvictLast();
+		}
+		void Clear() {
+			entries.Clear();
+			index.clear();
+		}
+		CacheStats GetStats() const {
+			CacheStats result = stats;
+			result.size = entries.Size();
 			return result;
 		}
-		std::vector<int32_t> GetRoots() const {
-			if (list.Empty()) return std::vector<int32_t>();
-			std::vector<int32_t> result;
-			Term term = list.Head()->data;
-			int32_t free_coefficient = abs(term.coeff);
-			if (term.degree != 0)
-				result.push_back(0);
-			for (int32_t i = 1; i * i <= free_coefficient; ++i) {
-				if (free_coefficient % i == 0) {
-					if (Evaluate((int64_t) i) == 0) {
-						result.push_back(i);
-					}
-					if (Evaluate((int64_t) -i) == 0) {
-						result.push_back(-i);
-					}
-					if (Evaluate((int64_t) free_coefficient / (int64_t) i) == 0) {
-						result.push_back(free_coefficient / i);
-					}
-					if (Evaluate((int64_t) -free_coefficient / (int64_t) i) == 0) {
-						result.push_back(-free_coefficient / i);
-					}
-				}
+	};
+
+	// One slot per thread for the pointer it's about to take a reference to.
+	// Slots are reused after their thread exits and are never freed, so scanning them needs no lock
+	class HazardSlots {
+	public:
+		struct Slot {
+			std::atomic<const void*> pointer{ nullptr };
+			std::atomic<bool> used{ false };
+			Slot *next = nullptr;
+		};
+	private:
+		inline static std::atomic<Slot*> head{ nullptr };
+		struct Owner {
+			Slot *slot;
+			Owner(): slot(Acquire()) {}
+			~Owner() {
+				slot->pointer.store(nullptr, std::memory_order_relaxed);
+				slot->used.store(false, std::memory_order_release);
+			}
+		};
+		static Slot* Acquire() {
+			for (Slot *slot = head.load(std::memory_order_acquire); slot; slot = slot->next) {
+				bool expected = false;
+				if (!slot->used.load(std::memory_order_relaxed) && slot->used.compare_exchange_strong(expected, true, std::memory_order_acquire))
+					return slot;
+			}
+			Slot *slot = new Slot();
+			slot->used.store(true, std::memory_order_relaxed);
+			slot->next = head.load(std::memory_order_relaxed);
+			while (!head.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed));
+			return slot;
+		}
+	public:
+		static Slot & ThisThread() {
+			thread_local Owner owner;
+			return *owner.slot;
+		}
+		// Every pointer some thread is about to take right now
+		static std::vector<const void*> Announced() {
+			std::vector<const void*> result;
+			for (Slot *slot = head.load(std::memory_order_acquire); slot; slot = slot->next)
+				if (const void *pointer = slot->pointer.load(std::memory_order_seq_cst))
+					result.push_back(pointer);
+			return result;
+		}
+	};
+	// Shared pointer that writers replace and readers load without locks.
+	// A reader announces the raw pointer in its hazard slot before taking a reference, a writer keeps
+	// the values it replaced until no slot announces them. T has to derive from std::enable_shared_from_this.
+	// Store calls are serialized by a mutex
+	template<typename T>
+	class RcuPointer {
+	private:
+		std::atomic<const T*> current{ nullptr };
+		std::mutex mutex;
+		std::shared_ptr<const T> owned;
+		std::vector<std::shared_ptr<const T>> retired;
+
+		void Reclaim() {
+			std::vector<const void*> announced = HazardSlots::Announced();
+			retired.erase(std::remove_if(retired.begin(), retired.end(), [&announced](const std::shared_ptr<const T> & value) {
+				return std::find(announced.begin(), announced.end(), value.get()) == announced.end();
+			}), retired.end());
+		}
+	public:
+		RcuPointer() = default;
+		explicit RcuPointer(std::shared_ptr<const T> value): current(value.get()), owned(std::move(value)) {}
+		RcuPointer(const RcuPointer &) = delete;
+		RcuPointer& operator=(const RcuPointer &) = delete;
+		std::shared_ptr<const T> Load() const {
+			HazardSlots::Slot & slot = HazardSlots::ThisThread();
+			const T *value = current.load(std::memory_order_seq_cst);
+			for (;;) {
+				slot.pointer.store(value, std::memory_order_seq_cst);
+				const T *again = current.load(std::memory_order_seq_cst);
+				if (again == value) break;
+				value = again;
 			}
-			sort(result.begin(), result.end());
-			result.resize((uint32_t) (unique(result.begin(), result.end()) - result.begin()));
+			std::shared_ptr<const T> result = value ? value->shared_from_this() : nullptr;
+			slot.pointer.store(nullptr, std::memory_order_release);
 			return result;
 		}
-		Term& GetTerm(uint32_t index) {
-			if (index >= list.Size())
-				throw std::out_of_range("Polynomial with index " + std::to_string(index) + " isn't present in the base.");
-			return list.Get(index)->data;
+		void Store(std::shared_ptr<const T> value) {
+			std::lock_guard<std::mutex> lock(mutex);
+			current.store(value.get(), std::memory_order_seq_cst);
+			if (owned)
+				retired.push_back(std::move(owned));
+			owned = std::move(value);
+			Reclaim();
 		}
 	};
-	class Base {
+
+	template<typename Coeff>
+	class BasicBase {
+	public:
+		using Polynomial = BasicPolynomial<Coeff>;
+		using MultivariatePolynomial = BasicMultivariatePolynomial<Coeff>;
+		using ErrorType = PolynomialGrammar::ErrorType;
+		// Results of operations are memoized by operands, up to this many per kind of result
+		static constexpr uint32_t DEFAULT_CACHE_CAPACITY = 256;
+		// Changes that can be undone
+		static constexpr uint32_t DEFAULT_HISTORY_CAPACITY = 100;
+	private:
+		// Contents of the base at one moment, never changed after it's published
+		struct Version : std::enable_shared_from_this<Version> {
+			ChunkedSequence<Polynomial> polynomials;
+			// Polynomials in several variables, indexed separately
+			ChunkedSequence<MultivariatePolynomial> multivariate;
+			Version() = default;
+			Version(const Version & other): std::enable_shared_from_this<Version>(), polynomials(other.polynomials), multivariate(other.multivariate) {}
+		};
+	public:
+		// Immutable view of the base, later changes of the base don't show in it.
+		// References it gives stay valid while the snapshot lives, any thread can read it
+		class Snapshot {
+		private:
+			std::shared_ptr<const Version> version;
+		public:
+			explicit Snapshot(std::shared_ptr<const Version> version): version(std::move(version)) {}
+			uint32_t Size() const {
+				return version->polynomials.Size();
+			}
+			bool Empty() const {
+				return version->polynomials.Empty();
+			}
+			uint32_t MultivariateSize() const {
+				return version->multivariate.Size();
+			}
+			const Polynomial& GetPolynomial(uint32_t index) const {
+				if (index >= Size())
+					throw std::out_of_range("Polynomial with index " + std::to_string(index) + " isn't present in the base.");
+				return version->polynomials.Get(index);
+			}
+			const Polynomial& GetPolynomial(Handle handle) const {
+				const Polynomial *p = version->polynomials.Find(handle);
+				if (!p)
+					throw std::out_of_range("Polynomial was deleted from the base.");
+				return *p;
+			}
+			const MultivariatePolynomial& GetMultivariatePolynomial(uint32_t index) const {
+				if (index >= MultivariateSize())
+					throw std::out_of_range("Multivariate polynomial with index " + std::to_string(index) + " isn't present in the base.");
+				return version->multivariate.Get(index);
+			}
+			Handle GetHandle(uint32_t index) const {
+				if (index >= Size())
+					throw std::out_of_range("Polynomial with index " + std::to_string(index) + " isn't present in the base.");
+				return version->polynomials.HandleAt(index);
+			}
+			// Index of the polynomial in this snapshot, Size() if it isn't there
+			uint32_t IndexOf(Handle handle) const {
+				return version->polynomials.IndexOf(handle);
+			}
+			// Pointers to every polynomial in order, for random access during bulk operations
+			std::vector<const Polynomial*> Polynomials() const {
+				std::vector<const Polynomial*> result;
+				result.reserve(Size());
+				version->polynomials.ForEach([&result](const Polynomial & p) {
+					result.push_back(&p);
+				});
+				return result;
+			}
+			template<typename F>
+			void ForEach(F f) const {
+				version->polynomials.ForEach(f);
+			}
+			template<typename F>
+			void ForEachMultivariate(F f) const {
+				version->multivariate.ForEach(f);
+			}
+		};
 	private:
-		List<Polynomial> list;
+		// Readers load the current version without locks, writers copy it (chunks are shared),
+		// change the copy and publish it. Undo and redo publish a version from the history
+		RcuPointer<Version> current{ std::make_shared<const Version>() };
+		mutable std::mutex write_mutex;
+		std::deque<std::shared_ptr<const Version>> undo, redo;
+		uint32_t history_capacity = DEFAULT_HISTORY_CAPACITY;
+
+		enum class Operation : uint8_t { ADD, MULTIPLY, MULTIPLY_TRUNCATED, DERIVATIVE, INTEGER_ROOTS, GCD };
+		// Cache hits are counted for these
+		static constexpr ProfiledOperation PROFILED_OPERATIONS[] = {
+			ProfiledOperation::ADD, ProfiledOperation::MULTIPLY, ProfiledOperation::MULTIPLY_TRUNCATED,
+			ProfiledOperation::DERIVATIVE, ProfiledOperation::INTEGER_ROOTS, ProfiledOperation::GCD
+		};
+		// Operands are kept as copies (they share terms with the originals), so a changed
+		// or deleted polynomial can't give a stale result
+		struct OperationKey {
+			Operation operation;
+			uint64_t parameter;
+			Polynomial lhs, rhs;
+			uint64_t hash;
+			OperationKey(Operation operation, const Polynomial & lhs, const Polynomial & rhs, uint64_t parameter = 0)
+				: operation(operation), parameter(parameter), lhs(lhs), rhs(rhs),
+				hash(HashMix(HashMix(lhs.Hash() ^ (uint64_t) operation ^ HashMix(parameter)) ^ rhs.Hash())) {}
+			uint64_t Hash() const {
+				return hash;
+			}
+			bool operator==(const OperationKey & other) const {
+				return hash == other.hash && operation == other.operation && parameter == other.parameter
+					&& lhs == other.lhs && rhs == other.rhs;
+			}
+		};
+		mutable std::mutex cache_mutex;
+		mutable LruCache<OperationKey, Polynomial> results{ DEFAULT_CACHE_CAPACITY };
+		mutable LruCache<OperationKey, std::vector<IntegerRoot>> roots{ DEFAULT_CACHE_CAPACITY };
+
+		// The lock isn't held while computing, so concurrent misses on the same key compute it twice
+		template<typename Value, typename F>
+		Value Memoized(LruCache<OperationKey, Value> & cache, OperationKey && key, F compute) const {
+			{
+				std::lock_guard<std::mutex> lock(cache_mutex);
+				if (const Value *cached = cache.Find(key)) {
+					CORE_PROFILE_CACHE_HIT(PROFILED_OPERATIONS[(uint32_t) key.operation]);
+					return *cached;
+				}
+			}
+			Value result = compute();
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			cache.Insert(std::move(key), result);
+			return result;
+		}
+		// Derivatives in the base don't wrap, an overflow is an error
+		static Polynomial CheckedDerivativeOf(const Polynomial & p, uint32_t n) {
+			Polynomial result;
+			if (!CheckedDerivative(p, n, result))
+				throw std::overflow_error("Derivative coefficients don't fit the coefficient type.");
+			return result;
+		}
+		// Line of a .pln file. Text that isn't a univariate polynomial is tried as a multivariate one,
+		// if both fail the error is the one found further into the line
+		static std::pair<ErrorType, uint32_t> ParseLine(std::string_view text, Polynomial & p, MultivariatePolynomial & m, bool & is_multivariate) {
+			is_multivariate = false;
+			std::pair<ErrorType, uint32_t> error = p.InitFromString(text);
+			if (error.first == PolynomialGrammar::OK || error.first == PolynomialGrammar::UNKNOWN_CHARACTERS)
+				return error;
+			std::pair<ErrorType, uint32_t> multivariate_error = m.InitFromString(text);
+			if (multivariate_error.first == PolynomialGrammar::OK) {
+				is_multivariate = true;
+				return multivariate_error;
+			}
+			return multivariate_error.second > error.second ? multivariate_error : error;
+		}
+		// Commutative operations get operands in a canonical order so both orders hit the same entry
+		// (the result takes the variable of lhs, so only with the same variable)
+		static OperationKey CommutativeKey(Operation operation, const Polynomial & lhs, const Polynomial & rhs, uint64_t parameter = 0) {
+			if (lhs.GetVariable() == rhs.GetVariable() && rhs.Hash() < lhs.Hash())
+				return OperationKey(operation, rhs, lhs, parameter);
+			return OperationKey(operation, lhs, rhs, parameter);
+		}
+		// Copy of the current version to change, write_mutex has to be held
+		std::shared_ptr<Version> Draft() const {
+			return std::make_shared<Version>(*current.Load());
+		}
+		// Makes next the current version, write_mutex has to be held.
+		// The replaced version goes to the undo history if the change is one the user can see
+		void Publish(std::shared_ptr<Version> next, bool undoable = true) {
+			if (undoable) {
+				if (history_capacity) {
+					undo.push_back(current.Load());
+					if (undo.size() > history_capacity)
+						undo.pop_front();
+				}
+				redo.clear();
+			}
+			current.Store(std::move(next));
+		}
+		// Polynomials of both lists of added go after the current ones, in one step of the history
+		void Append(Version && added) {
+			if (added.polynomials.Empty() && added.multivariate.Empty()) return;
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			next->polynomials.Reserve(added.polynomials.Size());
+			added.polynomials.ForEach([&next](Polynomial & p) {
+				next->polynomials.PushBack(std::move(p));
+			});
+			added.multivariate.ForEach([&next](MultivariatePolynomial & p) {
+				next->multivariate.PushBack(std::move(p));
+			});
+			Publish(std::move(next));
+		}
 	public:
-		Base() {}
-		List<Polynomial> & GetList() {
-			return list;
+		// Polynomials read from a file but not added yet. Reading doesn't touch any base, so it can run
+		// on any thread, then AddLoaded adds everything in one step of the history
+		class Loaded {
+		private:
+			friend class BasicBase;
+			Version contents;
+		public:
+			uint32_t Size() const {
+				return contents.polynomials.Size();
+			}
+			uint32_t MultivariateSize() const {
+				return contents.multivariate.Size();
+			}
+		};
+
+		BasicBase() {}
+		// Queries below take a snapshot each, so all operands of one query come from the same version
+		Snapshot GetSnapshot() const {
+			return Snapshot(current.Load());
 		}
 		uint32_t Size() const {
-			return list.Size();
+			return GetSnapshot().Size();
 		}
 		bool Empty() const {
-			return list.Empty();
+			return GetSnapshot().Empty();
 		}
-		List<Polynomial>::Node* Head() const {
-			return list.Head();
+		std::pair<ErrorType, uint32_t> AddPolynomial(const std::string & str) {
+			return AddPolynomial(str, UINT32_MAX);
 		}
-		List<Polynomial>::Node* Tail() const {
-			return list.Tail();
+		// Inserts after the polynomial with given index, appends if there's no such polynomial
+		std::pair<ErrorType, uint32_t> AddPolynomial(const std::string & str, uint32_t index) {
+			Polynomial new_polynomial;
+			std::pair<ErrorType, uint32_t> error = new_polynomial.InitFromString(str);
+			if (error.first != PolynomialGrammar::OK)
+				return error;
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			uint32_t size = next->polynomials.Size();
+			next->polynomials.Insert(index < size ? index + 1 : size, std::move(new_polynomial));
+			Publish(std::move(next));
+			return std::make_pair(PolynomialGrammar::OK, 0);
 		}
-		std::pair<Polynomial::ErrorType, uint32_t> AddPolynomial(const std::string & str) {
-			return AddPolynomial(str, list.Tail());
+		Handle AddPolynomial(const Polynomial & p) {
+			return AddPolynomial(Polynomial(p));
 		}
-		std::pair<Polynomial::ErrorType, uint32_t> AddPolynomial(const std::string & str, uint32_t index) {
-			List<Polynomial>::Node *ptr = list.Get(index);
-			return AddPolynomial(str, ptr);
+		Handle AddPolynomial(Polynomial && p) {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			Handle handle = next->polynomials.PushBack(std::move(p));
+			Publish(std::move(next));
+			return handle;
 		}
-		std::pair<Polynomial::ErrorType, uint32_t> AddPolynomial(const std::string & str, List<Polynomial>::Node * node) {
-			Polynomial new_polynomial;
-			std::pair<Polynomial::ErrorType, uint32_t> error = new_polynomial.InitFromString(str);
-			if (error.first != Polynomial::ErrorType::OK)
-				return error;
-			if (node)
-				list.InsertAfter(node, new_polynomial);
-			else
-				list.InsertBack(new_polynomial);
-			return std::make_pair(Polynomial::ErrorType::OK, 0);
+		// Inserts after the polynomial with given index, does nothing if there's no such polynomial
+		Handle AddPolynomial(const Polynomial & p, uint32_t index) {
+			return AddPolynomial(Polynomial(p), index);
 		}
-		void AddPolynomial(const Polynomial & p) {
-			list.InsertBack(p);
+		Handle AddPolynomial(Polynomial && p, uint32_t index) {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			if (index >= next->polynomials.Size())
+				return Handle();
+			Handle handle = next->polynomials.Insert(index + 1, std::move(p));
+			Publish(std::move(next));
+			return handle;
 		}
-		void AddPolynomial(const Polynomial & p, uint32_t index) {
-			List<Polynomial>::Node *ptr = list.Get(index);
-			if (ptr)
-				list.InsertAfter(ptr, p);
+		// Copies share terms with the polynomial in the base, so they're cheap
+		Polynomial GetPolynomial(uint32_t index) const {
+			return GetSnapshot().GetPolynomial(index);
 		}
-		Polynomial& GetPolynomial(uint32_t index) const {
-			if (index >= list.Size())
-				throw std::out_of_range("Polynomial with index " + std::to_string(index) + " isn't present in the base.");
-			List<Polynomial>::Node *node = list.Get(index);
-			return node->data;
+		Polynomial GetPolynomial(Handle handle) const {
+			return GetSnapshot().GetPolynomial(handle);
+		}
+		// Lazy expression over a polynomial of the base, it keeps its own copy of the terms
+		BasicExpression<Coeff> GetExpression(uint32_t index) const {
+			return BasicExpression<Coeff>(GetPolynomial(index));
 		}
-		Polynomial& GetFirstPolynomial() const {
-			if (list.Empty())
+		Handle GetHandle(uint32_t index) const {
+			return GetSnapshot().GetHandle(index);
+		}
+		// Current index of the polynomial, Size() if it was deleted
+		uint32_t IndexOf(Handle handle) const {
+			return GetSnapshot().IndexOf(handle);
+		}
+		Polynomial GetFirstPolynomial() const {
+			Snapshot snapshot = GetSnapshot();
+			if (snapshot.Empty())
 				throw std::out_of_range("No polynomials are present in the base.");
-			return list.Head()->data;
+			return snapshot.GetPolynomial(0);
 		}
-		Polynomial& GetLastPolynomial() const {
-			if (list.Empty())
+		Polynomial GetLastPolynomial() const {
+			Snapshot snapshot = GetSnapshot();
+			if (snapshot.Empty())
 				throw std::out_of_range("No polynomials are present in the base.");
-			return list.Tail()->data;
+			return snapshot.GetPolynomial(snapshot.Size() - 1);
 		}
 		void DeletePolynomial(uint32_t index) {
-			List<Polynomial>::Node *node = list.Get(index);
-			list.Delete(node);
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			if (index >= next->polynomials.Size()) return;
+			next->polynomials.Erase(index);
+			Publish(std::move(next));
+		}
+		// Polynomials in the base can't be changed in place, this replaces one as a step of the history
+		void SetPolynomial(uint32_t index, Polynomial && p) {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			if (index >= next->polynomials.Size())
+				throw std::out_of_range("Polynomial with index " + std::to_string(index) + " isn't present in the base.");
+			next->polynomials.GetMutable(index) = std::move(p);
+			Publish(std::move(next));
+		}
+		void DeletePolynomial(Handle handle) {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			uint32_t index = next->polynomials.IndexOf(handle);
+			if (index >= next->polynomials.Size()) return;
+			next->polynomials.Erase(index);
+			Publish(std::move(next));
+		}
+		// Every change above and below is one step of the history, undo and redo only publish another version.
+		// A new change after an undo drops what could be redone
+		bool Undo() {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			if (undo.empty()) return false;
+			redo.push_back(current.Load());
+			current.Store(std::move(undo.back()));
+			undo.pop_back();
+			return true;
+		}
+		bool Redo() {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			if (redo.empty()) return false;
+			undo.push_back(current.Load());
+			current.Store(std::move(redo.back()));
+			redo.pop_back();
+			return true;
+		}
+		bool CanUndo() const {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			return !undo.empty();
+		}
+		bool CanRedo() const {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			return !redo.empty();
+		}
+		// Old versions share chunks with newer ones, so a step costs a chunk and the chunk index at most
+		void SetHistoryCapacity(uint32_t capacity) {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			history_capacity = capacity;
+			while (undo.size() > capacity)
+				undo.pop_front();
+		}
+		void ClearHistory() {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			undo.clear();
+			redo.clear();
 		}
 		Polynomial AddPolynomials(uint32_t lhs_ind, uint32_t rhs_ind) const {
+			Snapshot snapshot = GetSnapshot();
+			const Polynomial & lhs = snapshot.GetPolynomial(lhs_ind);
+			const Polynomial & rhs = snapshot.GetPolynomial(rhs_ind);
+			return Memoized(results, CommutativeKey(Operation::ADD, lhs, rhs), [&lhs, &rhs]() {
+				Polynomial result;
+				Add(lhs, rhs, result);
+				return result;
+			});
+		}
+		Polynomial MultiplyPolynomials(uint32_t lhs_ind, uint32_t rhs_ind) const {
+			Snapshot snapshot = GetSnapshot();
+			const Polynomial & lhs = snapshot.GetPolynomial(lhs_ind);
+			const Polynomial & rhs = snapshot.GetPolynomial(rhs_ind);
+			return Memoized(results, CommutativeKey(Operation::MULTIPLY, lhs, rhs), [&lhs, &rhs]() {
+				Polynomial result;
+				Multiply(lhs, rhs, result);
+				return result;
+			});
+		}
+		// Product without the terms above max_degree
+		Polynomial MultiplyPolynomialsTruncated(uint32_t lhs_ind, uint32_t rhs_ind, uint64_t max_degree) const {
+			Snapshot snapshot = GetSnapshot();
+			const Polynomial & lhs = snapshot.GetPolynomial(lhs_ind);
+			const Polynomial & rhs = snapshot.GetPolynomial(rhs_ind);
+			return Memoized(results, CommutativeKey(Operation::MULTIPLY_TRUNCATED, lhs, rhs, max_degree), [&lhs, &rhs, max_degree]() {
+				Polynomial result;
+				MultiplyTruncated(lhs, rhs, max_degree, result);
+				return result;
+			});
+		}
+		Coeff GetCoefficientOfProduct(uint32_t lhs_ind, uint32_t rhs_ind, uint64_t degree) const {
+			Snapshot snapshot = GetSnapshot();
+			return CoefficientOfProduct(snapshot.GetPolynomial(lhs_ind), snapshot.GetPolynomial(rhs_ind), degree);
+		}
+		// Quotient and remainder, throws std::domain_error for a zero divisor or when the division isn't exact in the ring
+		std::pair<Polynomial, Polynomial> DividePolynomials(uint32_t lhs_ind, uint32_t rhs_ind) const {
+			Snapshot snapshot = GetSnapshot();
+			std::pair<Polynomial, Polynomial> result;
+			if (!Divide(snapshot.GetPolynomial(lhs_ind), snapshot.GetPolynomial(rhs_ind), result.first, result.second))
+				throw std::domain_error("Leading coefficient of the divisor doesn't divide the dividend.");
+			return result;
+		}
+		Polynomial GcdOfPolynomials(uint32_t lhs_ind, uint32_t rhs_ind) const {
+			Snapshot snapshot = GetSnapshot();
+			const Polynomial & lhs = snapshot.GetPolynomial(lhs_ind);
+			const Polynomial & rhs = snapshot.GetPolynomial(rhs_ind);
+			return Memoized(results, CommutativeKey(Operation::GCD, lhs, rhs), [&lhs, &rhs]() {
+				Polynomial result;
+				Gcd(lhs, rhs, result);
+				return result;
+			});
+		}
+		// f(g) modulo modulus, throws std::domain_error if modulus is zero or its leading coefficient isn't invertible
+		Polynomial ComposePolynomials(uint32_t f_ind, uint32_t g_ind, uint32_t modulus_ind) const {
+			Snapshot snapshot = GetSnapshot();
 			Polynomial result;
-			Polynomial& lhs = GetPolynomial(lhs_ind);
-			Polynomial& rhs = GetPolynomial(rhs_ind);
-			Add(lhs, rhs, result);
+			if (!ComposeModulo(snapshot.GetPolynomial(f_ind), snapshot.GetPolynomial(g_ind), snapshot.GetPolynomial(modulus_ind), result))
+				throw std::domain_error("Leading coefficient of the modulus isn't invertible.");
 			return result;
 		}
-		Polynomial MultiplyPolynomials(uint32_t lhs_ind, uint32_t rhs_ind) const {
+		// Values at every point, through subproduct trees for long polynomials at many points
+		std::vector<Coeff> EvaluatePolynomialAt(uint32_t polynomial_ind, const std::vector<Coeff> & points) const {
+			std::vector<Coeff> values;
+			GetSnapshot().GetPolynomial(polynomial_ind).EvaluateMany(points, values);
+			return values;
+		}
+		// Polynomial of degree below points.size() through (points[i], values[i]), not added to the base.
+		// Throws std::invalid_argument for repeated points and std::domain_error when its coefficients aren't in the ring
+		Polynomial InterpolatePolynomial(const std::vector<Coeff> & points, const std::vector<Coeff> & values) const {
 			Polynomial result;
-			Polynomial& lhs = GetPolynomial(lhs_ind);
-			Polynomial& rhs = GetPolynomial(rhs_ind);
-			Multiply(lhs, rhs, result);
+			if (!Interpolate(points, values, result))
+				throw std::domain_error("Interpolating polynomial has coefficients outside of the ring.");
 			return result;
 		}
 		Polynomial GetDerivative(uint32_t polynomial_ind, uint32_t n) const {
-			Polynomial result;
-			Polynomial& polynomial = GetPolynomial(polynomial_ind);
-			Derivative(polynomial, n, result);
+			Snapshot snapshot = GetSnapshot();
+			const Polynomial & polynomial = snapshot.GetPolynomial(polynomial_ind);
+			return Memoized(results, OperationKey(Operation::DERIVATIVE, polynomial, Polynomial(), n), [&polynomial, n]() {
+				return CheckedDerivativeOf(polynomial, n);
+			});
+		}
+		// n-fold antiderivative with zero constants, its coefficients are rational so it can't go to the base
+		BasicPolynomial<Rational> GetIntegral(uint32_t polynomial_ind, uint32_t n) const {
+			BasicPolynomial<Rational> result;
+			Integral(GetSnapshot().GetPolynomial(polynomial_ind), n, result);
+			return result;
+		}
+		Rational GetDefiniteIntegral(uint32_t polynomial_ind, const Rational & a, const Rational & b) const {
+			return DefiniteIntegral(GetSnapshot().GetPolynomial(polynomial_ind), a, b);
+		}
+		std::vector<int64_t> GetIntegerRoots(uint32_t polynomial_ind) const {
+			std::vector<int64_t> result;
+			for (const IntegerRoot & root : GetIntegerRootsWithMultiplicity(polynomial_ind))
+				result.push_back(root.value);
+			return result;
+		}
+		std::vector<IntegerRoot> GetIntegerRootsWithMultiplicity(uint32_t polynomial_ind) const {
+			Snapshot snapshot = GetSnapshot();
+			const Polynomial & polynomial = snapshot.GetPolynomial(polynomial_ind);
+			return Memoized(roots, OperationKey(Operation::INTEGER_ROOTS, polynomial, Polynomial()), [&polynomial]() {
+				return polynomial.GetRootsWithMultiplicity();
+			});
+		}
+		uint32_t MultivariateSize() const {
+			return GetSnapshot().MultivariateSize();
+		}
+		std::pair<ErrorType, uint32_t> AddMultivariatePolynomial(const std::string & str, MonomialOrder order = MonomialOrder::GRADED_LEX) {
+			MultivariatePolynomial p;
+			std::pair<ErrorType, uint32_t> error = p.InitFromString(str, order);
+			if (error.first == PolynomialGrammar::OK)
+				AddMultivariatePolynomial(std::move(p));
+			return error;
+		}
+		Handle AddMultivariatePolynomial(MultivariatePolynomial && p) {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			Handle handle = next->multivariate.PushBack(std::move(p));
+			Publish(std::move(next));
+			return handle;
+		}
+		MultivariatePolynomial GetMultivariatePolynomial(uint32_t index) const {
+			return GetSnapshot().GetMultivariatePolynomial(index);
+		}
+		void DeleteMultivariatePolynomial(uint32_t index) {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			if (index >= next->multivariate.Size()) return;
+			next->multivariate.Erase(index);
+			Publish(std::move(next));
+		}
+		MultivariatePolynomial AddMultivariatePolynomials(uint32_t lhs_ind, uint32_t rhs_ind) const {
+			Snapshot snapshot = GetSnapshot();
+			MultivariatePolynomial result;
+			Add(snapshot.GetMultivariatePolynomial(lhs_ind), snapshot.GetMultivariatePolynomial(rhs_ind), result);
+			return result;
+		}
+		// Throws std::overflow_error if exponents of the product don't fit its monomial layout
+		MultivariatePolynomial MultiplyMultivariatePolynomials(uint32_t lhs_ind, uint32_t rhs_ind) const {
+			Snapshot snapshot = GetSnapshot();
+			MultivariatePolynomial result;
+			Multiply(snapshot.GetMultivariatePolynomial(lhs_ind), snapshot.GetMultivariatePolynomial(rhs_ind), result);
+			return result;
+		}
+		// n-th derivative by the variable, throws std::invalid_argument if the polynomial doesn't have it
+		MultivariatePolynomial GetPartialDerivative(uint32_t polynomial_ind, char variable, uint32_t n) const {
+			MultivariatePolynomial result;
+			if (!CheckedDerivative(GetSnapshot().GetMultivariatePolynomial(polynomial_ind), variable, n, result))
+				throw std::overflow_error("Derivative coefficients don't fit the coefficient type.");
+			return result;
+		}
+		// Makes equal polynomials share one copy of their terms, returns how many were merged.
+		// Contents don't change, so it isn't a step of the history
+		uint32_t Deduplicate() {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::shared_ptr<Version> next = Draft();
+			std::unordered_multimap<uint64_t, const Polynomial*> seen;
+			seen.reserve(next->polynomials.Size());
+			uint32_t merged = 0;
+			next->polynomials.ForEach([&seen, &merged](Polynomial & p) {
+				uint64_t hash = p.Hash();
+				auto range = seen.equal_range(hash);
+				for (auto it = range.first; it != range.second; ++it)
+					if (*it->second == p) {
+						if (!p.SharesTermsWith(*it->second)) {
+							p.ShareTermsWith(*it->second);
+							++merged;
+						}
+						return;
+					}
+				seen.emplace(hash, &p);
+			});
+			if (merged)
+				Publish(std::move(next), false);
+			return merged;
+		}
+		// Hits and misses of the memoized operations above, capacity 0 turns memoization off
+		CacheStats GetCacheStats() const {
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			CacheStats stats = results.GetStats();
+			stats += roots.GetStats();
+			return stats;
+		}
+		void SetCacheCapacity(uint32_t capacity) {
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			results.SetCapacity(capacity);
+			roots.SetCapacity(capacity);
+		}
+		void ClearCache() {
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			results.Clear();
+			roots.Clear();
+		}
+		std::vector<RootInterval> GetRealRootIntervals(uint32_t polynomial_ind) const {
+			return GetSnapshot().GetPolynomial(polynomial_ind).IsolateRealRoots();
+		}
+		// Bulk operations over the whole base, run on a thread pool.
+		// Every result goes to its own slot, so output is in index order and doesn't depend on the number of threads
+
+		// Evaluates every polynomial of the base at every point, result[i][j] is polynomial i at xs[j]
+		template<typename T>
+		std::vector<std::vector<T>> EvaluateAll(const std::vector<T> & xs, ThreadPool & pool = ThreadPool::Default()) const {
+			Snapshot snapshot = GetSnapshot();
+			std::vector<const Polynomial*> polynomials = snapshot.Polynomials();
+			std::vector<std::vector<T>> result(polynomials.size());
+			pool.ParallelFor((uint32_t) polynomials.size(), [&](uint32_t i) {
+				polynomials[i]->EvaluateMany(xs, result[i]);
+			});
+			return result;
+		}
+		template<typename T>
+		std::vector<T> EvaluateAllAt(T x, ThreadPool & pool = ThreadPool::Default()) const {
+			Snapshot snapshot = GetSnapshot();
+			std::vector<const Polynomial*> polynomials = snapshot.Polynomials();
+			std::vector<T> result(polynomials.size());
+			pool.ParallelFor((uint32_t) polynomials.size(), [&](uint32_t i) {
+				result[i] = polynomials[i]->Evaluate(x);
+			});
+			return result;
+		}
+		std::vector<Polynomial> GetAllDerivatives(uint32_t n, ThreadPool & pool = ThreadPool::Default()) const {
+			Snapshot snapshot = GetSnapshot();
+			std::vector<const Polynomial*> polynomials = snapshot.Polynomials();
+			std::vector<Polynomial> result(polynomials.size());
+			pool.ParallelFor((uint32_t) polynomials.size(), [&](uint32_t i) {
+				result[i] = CheckedDerivativeOf(*polynomials[i], n);
+			});
+			return result;
+		}
+		std::vector<std::vector<int64_t>> GetAllIntegerRoots(ThreadPool & pool = ThreadPool::Default()) const {
+			Snapshot snapshot = GetSnapshot();
+			std::vector<const Polynomial*> polynomials = snapshot.Polynomials();
+			std::vector<std::vector<int64_t>> result(polynomials.size());
+			pool.ParallelFor((uint32_t) polynomials.size(), [&](uint32_t i) {
+				result[i] = polynomials[i]->GetRoots();
+			});
+			return result;
+		}
+		// result[i * Size() + j] is the sum of polynomials i and j
+		std::vector<Polynomial> AddAllPairs(ThreadPool & pool = ThreadPool::Default()) const {
+			Snapshot snapshot = GetSnapshot();
+			std::vector<const Polynomial*> polynomials = snapshot.Polynomials();
+			uint32_t n = (uint32_t) polynomials.size();
+			std::vector<Polynomial> result((size_t) n * n);
+			pool.ParallelFor(n * n, [&](uint32_t k) {
+				Add(*polynomials[k / n], *polynomials[k % n], result[k]);
+			});
+			return result;
+		}
+		// result[i * Size() + j] is the product of polynomials i and j
+		std::vector<Polynomial> MultiplyAllPairs(ThreadPool & pool = ThreadPool::Default()) const {
+			Snapshot snapshot = GetSnapshot();
+			std::vector<const Polynomial*> polynomials = snapshot.Polynomials();
+			uint32_t n = (uint32_t) polynomials.size();
+			std::vector<Polynomial> result((size_t) n * n);
+			pool.ParallelFor(n * n, [&](uint32_t k) {
+				Multiply(*polynomials[k / n], *polynomials[k % n], result[k]);
+			});
 			return result;
 		}
-		std::vector<int> GetIntegerRoots(uint32_t polynomial_ind) const {
-			Polynomial polynomial = GetPolynomial(polynomial_ind);
-			return polynomial.GetRoots();
+		// Polynomials go after the current ones, multivariate ones after the current multivariate ones
+		void AddLoaded(Loaded && loaded) {
+			Append(std::move(loaded.contents));
+		}
+		// Parses newline separated polynomials in parallel into loaded, after the ones it has.
+		// Everything parsed before a cancellation is kept
+		static LoadReport ReadBuffer(std::string_view data, Loaded & loaded, ThreadPool & pool = ThreadPool::Default(), const LoadProgress & progress = nullptr) {
+			CORE_PROFILE(LOAD, data.size());
+			static constexpr uint64_t CHUNK_BYTES = 1 << 22;
+			struct Chunk {
+				uint64_t begin, end;
+				uint64_t lines = 0;
+				std::vector<Polynomial> parsed;
+				std::vector<MultivariatePolynomial> parsed_multivariate;
+				std::vector<LoadError> errors; // line is relative to the chunk here
+			};
+			LoadReport report;
+			Version & added = loaded.contents;
+			uint64_t total = data.size(), position = 0, line = 0;
+			// Chunks are parsed a batch at a time so memory stays bounded for huge files
+			uint32_t batch_size = pool.Threads() * 2;
+			while (position < total) {
+				std::vector<Chunk> batch;
+				while (position < total && batch.size() < batch_size) {
+					uint64_t end = std::min(total, position + CHUNK_BYTES);
+					if (end < total) {
+						size_t newline = data.find('\n', end - 1);
+						end = newline == std::string_view::npos ? total : newline + 1;
+					}
+					Chunk chunk;
+					chunk.begin = position;
+					chunk.end = end;
+					batch.push_back(std::move(chunk));
+					position = end;
+				}
+				pool.ParallelFor((uint32_t) batch.size(), [&data, &batch](uint32_t c) {
+					Chunk & chunk = batch[c];
+					uint64_t begin = chunk.begin;
+					while (begin < chunk.end) {
+						size_t newline = data.find('\n', begin);
+						uint64_t end = newline == std::string_view::npos || newline >= chunk.end ? chunk.end : newline;
+						std::string_view text = data.substr(begin, end - begin);
+						if (!text.empty() && text.back() == '\r')
+							text.remove_suffix(1);
+						Polynomial p;
+						MultivariatePolynomial m;
+						bool is_multivariate;
+						std::pair<ErrorType, uint32_t> error = ParseLine(text, p, m, is_multivariate);
+						if (is_multivariate)
+							chunk.parsed_multivariate.push_back(std::move(m));
+						else if (error.first == PolynomialGrammar::OK)
+							chunk.parsed.push_back(std::move(p));
+						else
+							chunk.errors.push_back(LoadError{ chunk.lines, begin, error.first, error.second });
+						++chunk.lines;
+						begin = end + 1;
+					}
+				});
+				uint32_t parsed = 0;
+				for (Chunk & chunk : batch)
+					parsed += (uint32_t) chunk.parsed.size();
+				added.polynomials.Reserve(parsed);
+				for (Chunk & chunk : batch) {
+					for (Polynomial & p : chunk.parsed)
+						added.polynomials.PushBack(std::move(p));
+					report.loaded += chunk.parsed.size();
+					for (MultivariatePolynomial & m : chunk.parsed_multivariate)
+						added.multivariate.PushBack(std::move(m));
+					report.multivariate += chunk.parsed_multivariate.size();
+					for (LoadError & error : chunk.errors) {
+						error.line += line + 1;
+						report.errors.push_back(error);
+					}
+					line += chunk.lines;
+				}
+				if (progress && !progress(position, total) && position < total) {
+					report.cancelled = true;
+					break;
+				}
+			}
+			return report;
+		}
+		// ReadBuffer that appends what it parsed in order, as one step of the history. The base isn't locked
+		// while parsing, changes made meanwhile end up before the loaded polynomials
+		LoadReport LoadFromBuffer(std::string_view data, ThreadPool & pool = ThreadPool::Default(), const LoadProgress & progress = nullptr) {
+			Loaded loaded;
+			LoadReport report = ReadBuffer(data, loaded, pool, progress);
+			AddLoaded(std::move(loaded));
+			return report;
+		}
+		// Multivariate polynomials aren't part of the binary format
+		void SaveToBinary(std::ostream & output) const {
+			Snapshot snapshot = GetSnapshot();
+			CORE_PROFILE(SAVE, snapshot.Size());
+			BinaryPolynomialWriter<Coeff> writer(output);
+			snapshot.ForEach([&writer](const Polynomial & p) {
+				writer.Write(p);
+			});
+			writer.Finish();
+		}
+		// Reads every polynomial of the file into loaded, or leaves loaded as it was if the file is damaged
+		static BinaryFormat::Error ReadBinary(std::istream & input, Loaded & loaded) {
+			BinaryPolynomialReader<Coeff> reader(input);
+			Loaded added;
+			for (;;) {
+				Polynomial p;
+				bool end;
+				BinaryFormat::Error error = reader.Next(p, end);
+				if (error != BinaryFormat::OK) return error;
+				if (end) break;
+				added.contents.polynomials.PushBack(std::move(p));
+			}
+			added.contents.polynomials.ForEach([&loaded](Polynomial & p) {
+				loaded.contents.polynomials.PushBack(std::move(p));
+			});
+			return BinaryFormat::OK;
+		}
+		// Appends every polynomial of the file, or nothing if it's damaged
+		BinaryFormat::Error LoadFromBinary(std::istream & input) {
+			Loaded loaded;
+			BinaryFormat::Error error = ReadBinary(input, loaded);
+			AddLoaded(std::move(loaded));
+			return error;
+		}
+		static LoadReport ReadFile(const std::string & path, Loaded & loaded, ThreadPool & pool = ThreadPool::Default(), const LoadProgress & progress = nullptr) {
+			MappedFile file;
+			if (!file.Open(path)) {
+				LoadReport report;
+				report.opened = false;
+				return report;
+			}
+			return ReadBuffer(file.View(), loaded, pool, progress);
+		}
+		LoadReport LoadFromFile(const std::string & path, ThreadPool & pool = ThreadPool::Default(), const LoadProgress & progress = nullptr) {
+			Loaded loaded;
+			LoadReport report = ReadFile(path, loaded, pool, progress);
+			AddLoaded(std::move(loaded));
+			return report;
+		}
+		// Reads one polynomial per line, returns the number of lines that couldn't be parsed
+		uint32_t LoadFromStream(std::istream & input) {
+			uint32_t rejected = 0;
+			Version added;
+			for (std::string line; std::getline(input, line);) {
+				Polynomial p;
+				MultivariatePolynomial m;
+				bool is_multivariate;
+				if (ParseLine(line, p, m, is_multivariate).first != PolynomialGrammar::OK)
+					++rejected;
+				else if (is_multivariate)
+					added.multivariate.PushBack(std::move(m));
+				else
+					added.polynomials.PushBack(std::move(p));
+			}
+			Append(std::move(added));
+			return rejected;
+		}
+		// Univariate polynomials first, then the multivariate ones
+		void SaveToStream(std::ostream & output) const {
+			Snapshot snapshot = GetSnapshot();
+			CORE_PROFILE(SAVE, snapshot.Size() + snapshot.MultivariateSize());
+			// ToString doesn't touch the cached string, snapshots may be read by other threads meanwhile
+			snapshot.ForEach([&output](const Polynomial & p) {
+				output << p.ToString() << '\n';
+			});
+			snapshot.ForEachMultivariate([&output](const MultivariatePolynomial & p) {
+				output << p.ExportAsString() << '\n';
+			});
 		}
 	};
+	using Base = BasicBase<int32_t>;
 }
 #endif // CORE_H
@@ -4,7 +4,10 @@
 #include <QFontDatabase>
 #include <QShortcut>
 #include <QFileDialog>
+#include <QMessageBox>
+#include <QRegularExpressionValidator>
 #include <fstream>
+#include <cstdio>
 
 #define DONT_ADD_NULL 0
 
@@ -17,6 +20,10 @@ MainWindow::MainWindow(QWidget *parent)
 	ui->AddButton->setFont(font);
 	ui->Input->setFont(font);
 	ui->BaseView->setFont(font);
+	model = new BaseModel(base, this);
+	ui->BaseView->setModel(model);
+	// Every row is one line, so the view doesn't have to measure them all
+	ui->BaseView->setUniformItemSizes(true);
 	ui->StatusLabel->setFont(font);
 	connect(ui->AddButton, &QPushButton::released, this, &MainWindow::AddPolynomial);
 	connect(ui->Input, &QLineEdit::returnPressed, this, &MainWindow::AddPolynomial);
@@ -28,8 +35,17 @@ MainWindow::MainWindow(QWidget *parent)
 	connect(ui->del_2, &QPushButton::released, this, &MainWindow::Delete);
 	connect(ui->actionLoad_from_file, &QAction::triggered, this, &MainWindow::LoadFromFile);
 	connect(ui->actionSave_to_file, &QAction::triggered, this, &MainWindow::SaveToFile);
-	ui->get_2->setValidator(new QIntValidator(0, 1000000000));
-	ui->der_2->setValidator(new QIntValidator(0, 10));
+	connect(ui->actionPerformance_stats, &QAction::triggered, this, &MainWindow::ShowStats);
+	connect(ui->actionUndo, &QAction::triggered, this, &MainWindow::Undo);
+	connect(ui->actionRedo, &QAction::triggered, this, &MainWindow::Redo);
+	ui->ActionStatus->setTextInteractionFlags(Qt::LinksAccessibleByMouse);
+	connect(ui->ActionStatus, &QLabel::linkActivated, this, &MainWindow::CancelOperation);
+	progress_timer = new QTimer(this);
+	progress_timer->setInterval(200);
+	connect(progress_timer, &QTimer::timeout, this, &MainWindow::ShowProgress);
+	// Degrees go up to 2^64 - 1, the range itself is checked when parsing
+	ui->get_2->setValidator(new QRegularExpressionValidator(QRegularExpression("[0-9]{1,20}"), this));
+	ui->der_2->setValidator(new QIntValidator(0, 1000000000));
 	SetValidators();
 	ui->Success->setVisible(false);
 	ui->Error->setVisible(false);
@@ -82,9 +98,10 @@ void MainWindow::SetValidators() {
 void MainWindow::AddPolynomial() {
 	std::string text = ui->Input->text().toStdString();
 	std::string status_text;
-	std::pair<Core::Polynomial::ErrorType, uint32_t> error = base.AddPolynomial(text);
+	Core::Polynomial p;
+	std::pair<Core::Polynomial::ErrorType, uint32_t> error = p.InitFromString(text);
 #if DONT_ADD_NULL
-	if (error.first != Core::Polynomial::ErrorType::OK || !base.GetLastPolynomial().Empty()) {
+	if (error.first != Core::Polynomial::ErrorType::OK || !p.Empty()) {
 #endif
 		std::string error_substring;
 		std::string error_offset;
@@ -96,7 +113,6 @@ void MainWindow::AddPolynomial() {
 		};
 		if (error.first != Core::Polynomial::OK) {
 			uint32_t offset_first = std::min(error.second, (uint32_t) 7);
-			std::cout << text << ' ' << text.size() << ' ' << offset_first;
 			error_substring = text.substr(error.second - offset_first, offset_first + 1);
 			if (offset_first + 1 < text.size()) {
 				uint32_t offset_last = std::min((uint32_t) text.size() - error.second, (uint32_t) 7);
@@ -148,8 +164,23 @@ void MainWindow::AddPolynomial() {
 				ui->Success->setVisible(false);
 				ui->Error->setVisible(true);
 				break;
+			case Core::Polynomial::ErrorType::TOO_MANY_VARIABLES:
+				status_text = "Too many variables: ";
+				error_offset = MakeOffset(status_text.size()) + error_offset;
+				status_text += error_substring + "\n" + error_offset;
+				ui->Success->setVisible(false);
+				ui->Error->setVisible(true);
+				break;
+			case Core::Polynomial::ErrorType::DEGREE_TOO_LARGE:
+				status_text = "Degree doesn't fit in 64 bits: ";
+				error_offset = MakeOffset(status_text.size()) + error_offset;
+				status_text += error_substring + "\n" + error_offset;
+				ui->Success->setVisible(false);
+				ui->Error->setVisible(true);
+				break;
 			case Core::Polynomial::ErrorType::OK:
-				Renumber();
+				model->Append(std::move(p));
+				SetValidators();
 				ui->Input->setText(QString());
 				status_text = "Polynomial was successfully added!";
 				ui->Success->setVisible(true);
@@ -158,7 +189,6 @@ void MainWindow::AddPolynomial() {
 		}
 #if DONT_ADD_NULL
 	} else {
-		base.DeletePolynomial(base.Size() - 1);
 		ui->Success->setVisible(false);
 		ui->Error->setVisible(false);
 		status_text = "Nothing to add";
@@ -167,16 +197,6 @@ void MainWindow::AddPolynomial() {
 	ui->StatusLabel->setText(QString::fromStdString(status_text));
 }
 
-void MainWindow::Renumber() {
-	SetValidators();
-	ui->BaseView->clear();
-	auto current = base.Head();
-	for (uint32_t i = 1; current; current = current->next, ++i) {
-		std::string to_print = std::to_string(i) + ". " + current->data.ExportAsString();
-		ui->BaseView->addItem(QString::fromStdString(to_print));
-	}
-}
-
 bool IsEmptyIgnoringSpaces(const std::string & str) {
 	for (char c : str)
 		if (c != ' ')
@@ -184,6 +204,75 @@ bool IsEmptyIgnoringSpaces(const std::string & str) {
 	return true;
 }
 
+// MainWindow's own Add, Multiply and Derivative hide the core ones inside its methods
+static void AddPolynomials(const Core::Polynomial & lhs, const Core::Polynomial & rhs, Core::Polynomial & res) {
+	Add(lhs, rhs, res);
+}
+static void MultiplyPolynomials(const Core::Polynomial & lhs, const Core::Polynomial & rhs, Core::Polynomial & res) {
+	Multiply(lhs, rhs, res);
+}
+static void DerivativeOf(const Core::Polynomial & p, uint32_t n, Core::Polynomial & res) {
+	if (!CheckedDerivative(p, n, res))
+		throw std::overflow_error("Derivative coefficients don't fit in 32 bits");
+}
+
+void MainWindow::RunAsync(std::function<void()> compute, std::function<void()> done) {
+	if (operation.valid() && operation.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		ui->ActionStatus->setText(QString::fromStdString(std::string("Another operation is still running")));
+		return;
+	}
+	cancellation = Core::CancellationToken();
+	progress_percent = -1;
+	auto finished = std::make_shared<std::promise<void>>();
+	operation = finished->get_future().share();
+	operation_start = std::chrono::steady_clock::now();
+	ShowProgress();
+	progress_timer->start();
+	Core::ThreadPool::Default().Submit([this, token = cancellation, compute, done, finished] {
+		bool cancelled = false;
+		std::string error;
+		try {
+			Core::CancellationScope scope(token);
+			compute();
+		} catch (const Core::OperationCancelled &) {
+			cancelled = true;
+		} catch (const std::exception & e) {
+			error = e.what();
+		}
+		// Result is handled on the GUI thread
+		QMetaObject::invokeMethod(this, [this, cancelled, error, done] {
+			progress_timer->stop();
+			if (cancelled)
+				ui->ActionStatus->setText(QString::fromStdString(std::string("Cancelled")));
+			else if (!error.empty())
+				ui->ActionStatus->setText(QString::fromStdString("Failed: " + error));
+			else
+				done();
+		}, Qt::QueuedConnection);
+		finished->set_value();
+	});
+}
+
+void MainWindow::ShowProgress() {
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - operation_start).count();
+	char elapsed[32];
+	std::snprintf(elapsed, sizeof(elapsed), "%.1f", seconds);
+	int percent = progress_percent;
+	std::string percent_text = percent < 0 ? std::string() : " " + std::to_string(percent) + "%";
+	ui->ActionStatus->setText(QString::fromStdString("Working..." + percent_text + " " + std::string(elapsed) + "s <a href=\"cancel\">Cancel</a>"));
+}
+
+void MainWindow::CancelOperation() {
+	cancellation.Cancel();
+}
+
+void MainWindow::ShowStats() {
+	if (!stats)
+		stats = new StatsDialog(base, this);
+	stats->show();
+	stats->raise();
+}
+
 void MainWindow::GetCoeff() {
 	if (IsEmptyIgnoringSpaces(ui->get_1->text().toStdString())) {
 		ui->ActionStatus->setText(QString::fromStdString(std::string("Index not specified")));
@@ -198,9 +287,14 @@ void MainWindow::GetCoeff() {
 		ui->ActionStatus->setText(QString::fromStdString(std::string("Index out of bounds")));
 		return;
 	}
-	uint32_t n = atoi(ui->get_2->text().toStdString().data());
-	int32_t result = base.GetPolynomial(ind - 1).GetCoefficient(n);
-	ui->ActionStatus->setText(QString::fromStdString(std::string("Coefficient: ") + std::to_string(result)));
+	bool degree_ok = false;
+	uint64_t n = ui->get_2->text().toULongLong(&degree_ok);
+	if (!degree_ok) {
+		ui->ActionStatus->setText(QString::fromStdString(std::string("Degree doesn't fit in 64 bits")));
+		return;
+	}
+	auto result = base.GetPolynomial(ind - 1).GetCoefficient(n);
+	ui->ActionStatus->setText(QString::fromStdString(std::string("Coefficient: ") + Core::CoefficientToString(result)));
 	ui->get_1->setText(QString());
 	ui->get_2->setText(QString());
 }
@@ -223,20 +317,23 @@ void MainWindow::Add() {
 		ui->ActionStatus->setText(QString::fromStdString(std::string("Second index out of bounds")));
 		return;
 	}
-	Core::Polynomial p = base.AddPolynomials(ind1-1, ind2-1);
+	// Operands are copied, so the base can change while the sum is computed
+	auto lhs = std::make_shared<Core::Polynomial>(base.GetPolynomial(ind1 - 1));
+	auto rhs = std::make_shared<Core::Polynomial>(base.GetPolynomial(ind2 - 1));
+	auto p = std::make_shared<Core::Polynomial>();
+	ui->add_1->setText(QString());
+	ui->add_2->setText(QString());
+	RunAsync([lhs, rhs, p] { AddPolynomials(*lhs, *rhs, *p); }, [this, p] {
 #if DONT_ADD_NULL
-	if (p.Empty()) {
-		ui->ActionStatus->setText(QString::fromStdString(std::string("Result was empty so nothing was added")));
-	} else {
+		if (p->Empty()) {
+			ui->ActionStatus->setText(QString::fromStdString(std::string("Result was empty so nothing was added")));
+			return;
+		}
 #endif
-		base.AddPolynomial(p);
+		model->Append(std::move(*p));
 		ui->ActionStatus->setText(QString::fromStdString(std::string("Success")));
-		Renumber();
-#if DONT_ADD_NULL
-	}
-#endif
-	ui->add_1->setText(QString());
-	ui->add_2->setText(QString());
+		SetValidators();
+	});
 }
 void MainWindow::Multiply() {
 	if (IsEmptyIgnoringSpaces(ui->mul_1->text().toStdString())) {
@@ -257,12 +354,16 @@ void MainWindow::Multiply() {
 		ui->ActionStatus->setText(QString::fromStdString(std::string("Second index out of bounds")));
 		return;
 	}
-	Core::Polynomial p = base.MultiplyPolynomials(ind1-1, ind2-1);
-	base.AddPolynomial(p);
-	Renumber();
-	ui->ActionStatus->setText(QString::fromStdString(std::string("Success")));
+	auto lhs = std::make_shared<Core::Polynomial>(base.GetPolynomial(ind1 - 1));
+	auto rhs = std::make_shared<Core::Polynomial>(base.GetPolynomial(ind2 - 1));
+	auto p = std::make_shared<Core::Polynomial>();
 	ui->mul_1->setText(QString());
 	ui->mul_2->setText(QString());
+	RunAsync([lhs, rhs, p] { MultiplyPolynomials(*lhs, *rhs, *p); }, [this, p] {
+		model->Append(std::move(*p));
+		SetValidators();
+		ui->ActionStatus->setText(QString::fromStdString(std::string("Success")));
+	});
 }
 void MainWindow::Roots() {
 	if (IsEmptyIgnoringSpaces(ui->roots_1->text().toStdString())) {
@@ -274,15 +375,20 @@ void MainWindow::Roots() {
 		ui->ActionStatus->setText(QString::fromStdString(std::string("Index out of bounds")));
 		return;
 	}
-	std::vector<int> roots = base.GetIntegerRoots(ind - 1);
-	std::string result = "Roots: ";
-	for (int32_t root : roots) {
-		result += std::to_string(root);
-		if (root != roots.back())
-			result += ", ";
-	}
-	ui->ActionStatus->setText(QString::fromStdString(result));
+	auto polynomial = std::make_shared<Core::Polynomial>(base.GetPolynomial(ind - 1));
+	auto roots = std::make_shared<std::vector<Core::IntegerRoot>>();
 	ui->roots_1->setText(QString());
+	RunAsync([polynomial, roots] { *roots = polynomial->GetRootsWithMultiplicity(); }, [this, roots] {
+		std::string result = "Roots: ";
+		for (uint32_t i = 0; i < roots->size(); ++i) {
+			result += std::to_string((*roots)[i].value);
+			if ((*roots)[i].multiplicity > 1)
+				result += " (x" + std::to_string((*roots)[i].multiplicity) + ")";
+			if (i + 1 < roots->size())
+				result += ", ";
+		}
+		ui->ActionStatus->setText(QString::fromStdString(result));
+	});
 }
 void MainWindow::Derivative() {
 	if (IsEmptyIgnoringSpaces(ui->der_1->text().toStdString())) {
@@ -299,20 +405,21 @@ void MainWindow::Derivative() {
 		return;
 	}
 	uint32_t n = atoi(ui->der_2->text().toStdString().data());
-	Core::Polynomial p = base.GetDerivative(ind - 1, n);
+	auto polynomial = std::make_shared<Core::Polynomial>(base.GetPolynomial(ind - 1));
+	auto p = std::make_shared<Core::Polynomial>();
+	ui->der_1->setText(QString());
+	ui->der_2->setText(QString());
+	RunAsync([polynomial, n, p] { DerivativeOf(*polynomial, n, *p); }, [this, p] {
 #if DONT_ADD_NULL
-	if (p.Empty()) {
-		ui->ActionStatus->setText(QString::fromStdString(std::string("Result was empty so nothing was added")));
-	} else {
+		if (p->Empty()) {
+			ui->ActionStatus->setText(QString::fromStdString(std::string("Result was empty so nothing was added")));
+			return;
+		}
 #endif
-		base.AddPolynomial(p);
-		Renumber();
+		model->Append(std::move(*p));
+		SetValidators();
 		ui->ActionStatus->setText(QString::fromStdString(std::string("Success")));
-#if DONT_ADD_NULL
-	}
-#endif
-	ui->der_1->setText(QString());
-	ui->der_2->setText(QString());
+	});
 }
 void MainWindow::Delete() {
 	if (IsEmptyIgnoringSpaces(ui->del_1->text().toStdString())) {
@@ -324,38 +431,130 @@ void MainWindow::Delete() {
 		ui->ActionStatus->setText(QString::fromStdString(std::string("Index out of bounds")));
 		return;
 	}
-	base.DeletePolynomial(ind - 1);
-	Renumber();
+	model->Remove(ind - 1);
+	SetValidators();
 	ui->del_1->setText(QString());
 }
 
+void MainWindow::Undo() {
+	ui->ActionStatus->setText(QString::fromStdString(std::string(model->Undo() ? "Undone" : "Nothing to undo")));
+	SetValidators();
+}
+
+void MainWindow::Redo() {
+	ui->ActionStatus->setText(QString::fromStdString(std::string(model->Redo() ? "Redone" : "Nothing to redo")));
+	SetValidators();
+}
+
+static bool IsBinaryFile(const std::string & path) {
+	static const std::string extension = ".plnb";
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+static std::string ErrorDescription(Core::PolynomialGrammar::ErrorType error) {
+	switch (error) {
+		case Core::PolynomialGrammar::UNKNOWN_CHARACTERS:
+			return "Unknown character";
+		case Core::PolynomialGrammar::MULTIPLE_VARIABLES:
+			return "Multiple variables aren't allowed";
+		case Core::PolynomialGrammar::EXPECTED_COEFFICIENT:
+			return "Expected coefficient";
+		case Core::PolynomialGrammar::EXPECTED_VARIABLE:
+			return "Expected variable";
+		case Core::PolynomialGrammar::EXPECTED_POWER_SYMBOL:
+			return "Expected the '^' symbol after variable";
+		case Core::PolynomialGrammar::EXPECTED_DEGREE:
+			return "Expected degree";
+		case Core::PolynomialGrammar::DEGREE_TOO_LARGE:
+			return "Degree doesn't fit in 64 bits";
+		case Core::PolynomialGrammar::TOO_MANY_VARIABLES:
+			return "Too many variables";
+		default:
+			return "No error";
+	}
+}
+
+// Lines that couldn't be parsed, the first one in the message and the rest under details
+void MainWindow::ShowLoadErrors(const std::vector<Core::LoadError> & errors) {
+	static constexpr size_t MAX_SHOWN_ERRORS = 1000;
+	auto Describe = [](const Core::LoadError & error) {
+		return "line " + std::to_string(error.line) + " (byte " + std::to_string(error.offset) + "), position "
+			+ std::to_string(error.position + 1) + ": " + ErrorDescription(error.error);
+	};
+	QMessageBox box(QMessageBox::Warning, tr("Load Polynomials"), QString::fromStdString(std::to_string(errors.size())
+			+ (errors.size() == 1 ? " line was" : " lines were") + " rejected, first on " + Describe(errors.front())), QMessageBox::Ok, this);
+	std::string details;
+	for (size_t i = 0; i < errors.size() && i < MAX_SHOWN_ERRORS; ++i)
+		details += Describe(errors[i]) + "\n";
+	if (errors.size() > MAX_SHOWN_ERRORS)
+		details += "and " + std::to_string(errors.size() - MAX_SHOWN_ERRORS) + " more\n";
+	box.setDetailedText(QString::fromStdString(details));
+	box.exec();
+}
+
 void MainWindow::LoadFromFile() {
-	std::string path = QFileDialog::getOpenFileName(this, tr("Load Polynomials"), "/home/secondson/Desktop", tr("Polynomial File (*.pln)"))
-			.toStdString();
-	std::ifstream input(path);
-	for (std::string polynomial; getline(input, polynomial);) {
-		std::pair<Core::Polynomial::ErrorType, uint32_t> error = base.AddPolynomial(polynomial);
-		if (error.first != Core::Polynomial::ErrorType::OK) {
-			std::cerr << "ээээ обещали файл нормальный а это че" << std::endl;
-		}
+	std::string path = QFileDialog::getOpenFileName(this, tr("Load Polynomials"), "/home/secondson/Desktop",
+			tr("Polynomial File (*.pln *.plnb)")).toStdString();
+	// Files are read in the background like other operations, what was read is added here through the model
+	auto loaded = std::make_shared<Core::Base::Loaded>();
+	if (IsBinaryFile(path)) {
+		auto error = std::make_shared<Core::BinaryFormat::Error>(Core::BinaryFormat::OK);
+		RunAsync([path, loaded, error] {
+			std::ifstream input(path, std::ios::binary);
+			*error = input ? Core::Base::ReadBinary(input, *loaded) : Core::BinaryFormat::CANT_OPEN;
+		}, [this, loaded, error] {
+			model->Append(std::move(*loaded));
+			ui->ActionStatus->setText(QString::fromStdString(*error == Core::BinaryFormat::OK ? std::string("Success")
+					: "Couldn't load binary file, error " + std::to_string((int) *error)));
+			SetValidators();
+		});
+		return;
 	}
-	input.close();
-	Renumber();
+	// Cancel stops reading after the current batch of lines, what was parsed so far is still added
+	auto report = std::make_shared<Core::LoadReport>();
+	RunAsync([this, path, loaded, report] {
+		const Core::CancellationToken *token = Core::CurrentCancellation();
+		*report = Core::Base::ReadFile(path, *loaded, Core::ThreadPool::Default(), [this, token](uint64_t done, uint64_t total) {
+			progress_percent = (int) (total ? done * 100 / total : 100);
+			return !token->IsCancelled();
+		});
+	}, [this, loaded, report] {
+		if (!report->opened) {
+			ui->ActionStatus->setText(QString::fromStdString(std::string("Couldn't open file")));
+			return;
+		}
+		model->Append(std::move(*loaded));
+		std::string status = (report->cancelled ? "Cancelled, loaded " : "Loaded ") + std::to_string(report->loaded)
+			+ ", rejected " + std::to_string(report->errors.size());
+		// They aren't shown in the list, but operations on the base can use them
+		if (report->multivariate)
+			status += ", multivariate " + std::to_string(report->multivariate);
+		ui->ActionStatus->setText(QString::fromStdString(status));
+		SetValidators();
+		if (!report->errors.empty())
+			ShowLoadErrors(report->errors);
+	});
 }
 
 void MainWindow::SaveToFile() {
-	std::string path = QFileDialog::getSaveFileName(this, tr("Save Polynomials"), "/home/secondson/Desktop", tr("Polynomial File (*.pln)"))
-			.toStdString();
-	std::ofstream output(path);
-	for (auto current = base.Head(); current; current = current->next) {
-		std::string polynomial = current->data.ExportAsString();
-		output << polynomial << std::endl;
+	std::string path = QFileDialog::getSaveFileName(this, tr("Save Polynomials"), "/home/secondson/Desktop",
+			tr("Polynomial File (*.pln);;Binary Polynomial File (*.plnb)")).toStdString();
+	if (IsBinaryFile(path)) {
+		std::ofstream output(path, std::ios::binary);
+		base.SaveToBinary(output);
+		output.close();
+		return;
 	}
+	std::ofstream output(path);
+	base.SaveToStream(output);
 	output.close();
-	Renumber();
 }
 
 MainWindow::~MainWindow() {
+	// Background operation may still post its result here
+	cancellation.Cancel();
+	if (operation.valid())
+		operation.wait();
 	delete ui;
 }
 
@@ -1,10 +1,17 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
-#include "QtWidgets/qlistwidget.h"
+#include "QtWidgets/qlistview.h"
 #include "core.h"
+#include "basemodel.h"
+#include "statsdialog.h"
 #include <QMainWindow>
 #include <QPushButton>
+#include <QTimer>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -18,7 +25,6 @@ public:
 	~MainWindow();
 	Core::Base base;
 	void AddPolynomial();
-	void Renumber();
 	void LoadFromFile();
 	void SaveToFile();
 	void SetValidators();
@@ -28,7 +34,23 @@ public:
 	void Roots();
 	void Derivative();
 	void Delete();
+	void Undo();
+	void Redo();
+	void ShowProgress();
+	void CancelOperation();
+	void ShowStats();
 private:
 	Ui::MainWindow *ui;
+	BaseModel *model;
+	// One background operation at a time, its result is applied on the GUI thread
+	Core::CancellationToken cancellation;
+	std::shared_future<void> operation;
+	std::chrono::steady_clock::time_point operation_start;
+	// Set by operations that know how far they are, -1 if they don't
+	std::atomic<int> progress_percent{ -1 };
+	QTimer *progress_timer;
+	StatsDialog *stats = nullptr;
+	void RunAsync(std::function<void()> compute, std::function<void()> done);
+	void ShowLoadErrors(const std::vector<Core::LoadError> & errors);
 };
 #endif // MAINWINDOW_H
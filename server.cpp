@@ -0,0 +1,636 @@
+#include "core.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Query server over one shared Core::Base, and a client for it. POSIX only, see Usage() for the protocol
+
+static void Usage() {
+	std::cerr <<
+		"Usage: polynomials-server [options] [input.pln | input.plnb]...\n"
+		"       polynomials-server --client [options] [-n N] < requests\n"
+		"Options:\n"
+		"  -u, --unix PATH     listen on (or connect to) a Unix domain socket, polynomials.sock by default\n"
+		"  -p, --port N        listen on (or connect to) 127.0.0.1:N instead\n"
+		"  -t, --threads N     worker threads for batches\n"
+		"  -b, --batch N       most requests run as one batch, 256 by default\n"
+		"  -c, --client        send stdin lines to a running server and print the responses\n"
+		"  -n N                client sends its input N times, pipelined, and prints the throughput\n"
+		"Protocol: one request per line, one response line per request in the same order.\n"
+		"Requests can be pipelined, a response starts with 'ok ' or 'error '. Indexes start from 1:\n"
+		"  add I J     the sum, not added to the base\n"
+		"  mul I J     the product\n"
+		"  der I N     the N-th derivative\n"
+		"  roots I     integer roots as value:multiplicity\n"
+		"  coeff I D   coefficient at degree D\n"
+		"  eval I X... values at every X\n"
+		"  push P      appends polynomial P to the base, responds with its index\n"
+		"  size        number of polynomials\n"
+		"  stats       request count and latency of every operation\n"
+		"Requests between writes (push) run as one batch in parallel, evaluations of one polynomial\n"
+		"in a batch are done together through multipoint evaluation.\n";
+}
+
+// Request latencies in power of two buckets of microseconds
+class LatencyHistogram {
+public:
+	static constexpr uint32_t BUCKETS = 40;
+private:
+	// bucket b holds latencies below 2^b microseconds
+	std::array<uint64_t, BUCKETS> buckets{};
+	uint64_t count = 0, total = 0, max = 0;
+public:
+	void Add(uint64_t microseconds) {
+		uint32_t bucket = microseconds ? 64 - (uint32_t) __builtin_clzll(microseconds) : 0;
+		++buckets[std::min(bucket, BUCKETS - 1)];
+		++count;
+		total += microseconds;
+		max = std::max(max, microseconds);
+	}
+	uint64_t Count() const {
+		return count;
+	}
+	// Upper bound of the bucket holding quantile q
+	uint64_t Quantile(double q) const {
+		uint64_t rank = std::max<uint64_t>(1, (uint64_t) std::ceil(q * (double) count)), seen = 0;
+		for (uint32_t b = 0; b < BUCKETS; ++b) {
+			seen += buckets[b];
+			if (seen >= rank)
+				return std::min(max, (uint64_t) 1 << b);
+		}
+		return max;
+	}
+	std::string Summary() const {
+		std::ostringstream result;
+		result << "n=" << count << " mean=" << (count ? total / count : 0) << "us p50<=" << Quantile(0.5)
+			<< "us p90<=" << Quantile(0.9) << "us p99<=" << Quantile(0.99) << "us max=" << max << "us";
+		return result.str();
+	}
+	void Write(std::ostream & output) const {
+		for (uint32_t b = 0; b < BUCKETS; ++b)
+			if (buckets[b])
+				output << "  <" << ((uint64_t) 1 << b) << "us\t" << buckets[b] << '\n';
+	}
+};
+
+struct Address {
+	std::string unix_path = "polynomials.sock";
+	uint16_t port = 0;
+};
+
+// -1 and errno set on failure
+static int OpenSocket(const Address & address, bool listening) {
+	int fd;
+	if (address.port) {
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0) return -1;
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(address.port);
+		// Local only, there's no authentication
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		if (listening) {
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+			if (bind(fd, (sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+				close(fd);
+				return -1;
+			}
+		} else if (connect(fd, (sockaddr *) &addr, sizeof(addr)) < 0) {
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	if (address.unix_path.size() >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	std::strcpy(addr.sun_path, address.unix_path.c_str());
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+	if (listening) {
+		unlink(address.unix_path.c_str());
+		if (bind(fd, (sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+			close(fd);
+			return -1;
+		}
+	} else if (connect(fd, (sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool WriteAll(int fd, const char *data, size_t size) {
+	while (size) {
+		ssize_t written = write(fd, data, size);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		data += written;
+		size -= (size_t) written;
+	}
+	return true;
+}
+
+static int wake_pipe[2] = { -1, -1 };
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void OnSignal(int) {
+	interrupted = 1;
+	char byte = 0;
+	ssize_t ignored = write(wake_pipe[1], &byte, 1);
+	(void) ignored;
+}
+
+class Server {
+private:
+	using Coeff = Core::Polynomial::Coefficient;
+	// Longer lines close the connection
+	static constexpr size_t MAX_LINE = 1 << 24;
+
+	struct Connection {
+		int fd;
+		// Only the I/O loop touches input and eof. After the client's end of file the connection
+		// stays open until every request is answered
+		std::string input;
+		bool eof = false;
+		// Responses the dispatcher queued, the I/O loop sends them
+		std::mutex mutex;
+		std::string output;
+		uint32_t pending = 0;
+		bool closed = false;
+		explicit Connection(int fd): fd(fd) {}
+		bool Finished() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return eof && !pending && output.empty();
+		}
+	};
+	struct Request {
+		std::shared_ptr<Connection> connection;
+		std::vector<std::string> args;
+		std::chrono::steady_clock::time_point received;
+		std::string response;
+		// Parsed operands of eval
+		uint32_t polynomial = 0;
+		std::vector<Coeff> points;
+	};
+
+	Core::Base & base;
+	Core::ThreadPool & pool;
+	uint32_t max_batch;
+	std::mutex queue_mutex;
+	std::condition_variable queue_ready;
+	std::deque<Request> queue;
+	bool stopping = false;
+	// Only the dispatcher thread touches these while serving
+	std::map<std::string, LatencyHistogram> latency;
+	uint64_t batches = 0, batched = 0;
+
+	static bool IsRead(const std::string & op) {
+		return op == "add" || op == "mul" || op == "der" || op == "roots" || op == "coeff" || op == "eval";
+	}
+	static void Expect(const std::vector<std::string> & args, size_t count) {
+		if (args.size() != count + 1)
+			throw std::invalid_argument(args[0] + " expects " + std::to_string(count) + " arguments");
+	}
+	static uint32_t ParseIndex(const std::string & token, uint32_t size) {
+		char *end = nullptr;
+		unsigned long long value = std::strtoull(token.c_str(), &end, 10);
+		if (token.empty() || *end || !value || value > size)
+			throw std::out_of_range("Index " + token + " is out of bounds");
+		return (uint32_t) value - 1;
+	}
+	static uint32_t ParseNumber(const std::string & token) {
+		char *end = nullptr;
+		unsigned long long value = std::strtoull(token.c_str(), &end, 10);
+		if (token.empty() || *end || value > UINT32_MAX)
+			throw std::invalid_argument("Expected a number, got '" + token + "'");
+		return (uint32_t) value;
+	}
+	static uint64_t ParseDegree(const std::string & token) {
+		char *end = nullptr;
+		errno = 0;
+		unsigned long long value = std::strtoull(token.c_str(), &end, 10);
+		if (token.empty() || !std::isdigit((unsigned char) token[0]) || *end || errno)
+			throw std::invalid_argument("Expected a degree, got '" + token + "'");
+		return (uint64_t) value;
+	}
+	static Coeff ParseCoefficient(const std::string & token) {
+		char *end = nullptr;
+		errno = 0;
+		long long value = std::strtoll(token.c_str(), &end, 10);
+		if (token.empty() || *end || errno || value < INT32_MIN || value > INT32_MAX)
+			throw std::invalid_argument("Expected a coefficient, got '" + token + "'");
+		return (Coeff) value;
+	}
+	static std::string Error(const std::exception & e) {
+		std::string message = e.what();
+		std::replace(message.begin(), message.end(), '\n', ' ');
+		return "error " + message;
+	}
+
+	// Reads, any thread of the pool
+	std::string Execute(const Core::Base::Snapshot & snapshot, const std::vector<std::string> & args) const {
+		const std::string & op = args[0];
+		uint32_t size = snapshot.Size();
+		if (op == "add" || op == "mul") {
+			Expect(args, 2);
+			uint32_t lhs = ParseIndex(args[1], size), rhs = ParseIndex(args[2], size);
+			return "ok " + (op == "add" ? base.AddPolynomials(lhs, rhs) : base.MultiplyPolynomials(lhs, rhs)).ExportAsString();
+		} else if (op == "der") {
+			Expect(args, 2);
+			return "ok " + base.GetDerivative(ParseIndex(args[1], size), ParseNumber(args[2])).ExportAsString();
+		} else if (op == "roots") {
+			Expect(args, 1);
+			std::string result = "ok";
+			for (const Core::IntegerRoot & root : base.GetIntegerRootsWithMultiplicity(ParseIndex(args[1], size)))
+				result += ' ' + std::to_string(root.value) + ':' + std::to_string(root.multiplicity);
+			return result;
+		} else if (op == "coeff") {
+			Expect(args, 2);
+			return "ok " + Core::CoefficientToString(snapshot.GetPolynomial(ParseIndex(args[1], size)).GetCoefficient(ParseDegree(args[2])));
+		}
+		throw std::invalid_argument("Unknown operation '" + op + "'");
+	}
+	// Writes and control requests, the dispatcher thread only
+	std::string ExecuteAlone(const std::vector<std::string> & args) {
+		const std::string & op = args[0];
+		if (op == "push") {
+			if (args.size() < 2)
+				throw std::invalid_argument("push expects a polynomial");
+			std::string text = args[1];
+			for (size_t i = 2; i < args.size(); ++i)
+				text += ' ' + args[i];
+			Core::Polynomial p;
+			std::pair<Core::Polynomial::ErrorType, uint32_t> error = p.InitFromString(text);
+			if (error.first != Core::PolynomialGrammar::OK)
+				return "error parse error " + std::to_string((int) error.first) + " at " + std::to_string(error.second);
+			base.AddPolynomial(std::move(p));
+			return "ok " + std::to_string(base.Size());
+		} else if (op == "size") {
+			Expect(args, 0);
+			return "ok " + std::to_string(base.Size());
+		} else if (op == "stats") {
+			Expect(args, 0);
+			std::string result = "ok batches=" + std::to_string(batches) + " batched=" + std::to_string(batched);
+			for (const auto & entry : latency)
+				result += "; " + entry.first + ' ' + entry.second.Summary();
+			return result;
+		}
+		throw std::invalid_argument("Unknown operation '" + op + "'");
+	}
+	// Requests of a batch don't depend on each other, they run in parallel on one snapshot
+	void RunBatch(std::vector<Request> & batch) {
+		Core::Base::Snapshot snapshot = base.GetSnapshot();
+		std::vector<std::function<void()>> tasks;
+		// polynomial -> eval requests, answered by one multipoint evaluation
+		std::map<uint32_t, std::vector<Request*>> evaluations;
+		for (Request & request : batch) {
+			if (request.args[0] != "eval") {
+				tasks.push_back([this, &snapshot, &request] {
+					try {
+						request.response = Execute(snapshot, request.args);
+					} catch (const std::exception & e) {
+						request.response = Error(e);
+					}
+				});
+				continue;
+			}
+			try {
+				if (request.args.size() < 3)
+					throw std::invalid_argument("eval expects an index and points");
+				request.polynomial = ParseIndex(request.args[1], snapshot.Size());
+				for (size_t i = 2; i < request.args.size(); ++i)
+					request.points.push_back(ParseCoefficient(request.args[i]));
+				evaluations[request.polynomial].push_back(&request);
+			} catch (const std::exception & e) {
+				request.response = Error(e);
+			}
+		}
+		for (auto & entry : evaluations)
+			tasks.push_back([&snapshot, &entry] {
+				std::vector<Coeff> points, values;
+				for (Request *request : entry.second)
+					points.insert(points.end(), request->points.begin(), request->points.end());
+				snapshot.GetPolynomial(entry.first).EvaluateMany(points, values);
+				size_t position = 0;
+				for (Request *request : entry.second) {
+					std::string result = "ok";
+					for (size_t i = 0; i < request->points.size(); ++i)
+						result += ' ' + Core::CoefficientToString(values[position++]);
+					request->response = std::move(result);
+				}
+			});
+		pool.ParallelFor((uint32_t) tasks.size(), [&tasks](uint32_t i) {
+			tasks[i]();
+		});
+	}
+	void Respond(Request & request) {
+		uint64_t elapsed = (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - request.received).count();
+		const std::string & op = request.args[0];
+		// Names clients make up don't get histograms of their own
+		latency[IsRead(op) || op == "push" || op == "size" || op == "stats" ? op : "unknown"].Add(elapsed);
+		std::lock_guard<std::mutex> lock(request.connection->mutex);
+		--request.connection->pending;
+		if (request.connection->closed) return;
+		request.connection->output += request.response;
+		request.connection->output += '\n';
+	}
+	void Dispatch() {
+		for (;;) {
+			std::vector<Request> batch;
+			{
+				std::unique_lock<std::mutex> lock(queue_mutex);
+				queue_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+				if (stopping) return;
+				// A maximal run of reads, or a single other request
+				do {
+					batch.push_back(std::move(queue.front()));
+					queue.pop_front();
+				} while (IsRead(batch.front().args[0]) && batch.size() < max_batch && !queue.empty() && IsRead(queue.front().args[0]));
+			}
+			if (IsRead(batch.front().args[0])) {
+				RunBatch(batch);
+				++batches;
+				batched += batch.size();
+			} else {
+				try {
+					batch.front().response = ExecuteAlone(batch.front().args);
+				} catch (const std::exception & e) {
+					batch.front().response = Error(e);
+				}
+			}
+			for (Request & request : batch)
+				Respond(request);
+			char byte = 0;
+			ssize_t ignored = write(wake_pipe[1], &byte, 1);
+			(void) ignored;
+		}
+	}
+	void Enqueue(const std::shared_ptr<Connection> & connection, std::string_view line) {
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+		Request request;
+		request.connection = connection;
+		request.received = std::chrono::steady_clock::now();
+		std::istringstream tokens{ std::string(line) };
+		for (std::string token; tokens >> token;)
+			request.args.push_back(token);
+		if (request.args.empty()) return;
+		{
+			std::lock_guard<std::mutex> lock(connection->mutex);
+			++connection->pending;
+		}
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		queue.push_back(std::move(request));
+		queue_ready.notify_one();
+	}
+	// false when the connection should be closed
+	bool ReadFrom(const std::shared_ptr<Connection> & connection) {
+		char buffer[1 << 16];
+		ssize_t count = read(connection->fd, buffer, sizeof(buffer));
+		if (count < 0) return errno == EINTR || errno == EAGAIN;
+		std::string & input = connection->input;
+		if (!count) {
+			// Last line may lack its newline
+			connection->eof = true;
+			if (!input.empty())
+				Enqueue(connection, input);
+			input.clear();
+			return true;
+		}
+		size_t done = 0, from = input.size();
+		input.append(buffer, (size_t) count);
+		for (size_t newline; (newline = input.find('\n', from)) != std::string::npos; from = done = newline + 1)
+			Enqueue(connection, std::string_view(input).substr(done, newline - done));
+		input.erase(0, done);
+		return input.size() <= MAX_LINE;
+	}
+	// false when the connection should be closed
+	bool WriteTo(Connection & connection) {
+		std::lock_guard<std::mutex> lock(connection.mutex);
+		while (!connection.output.empty()) {
+			ssize_t count = write(connection.fd, connection.output.data(), connection.output.size());
+			if (count < 0) return errno == EINTR || errno == EAGAIN;
+			connection.output.erase(0, (size_t) count);
+		}
+		return true;
+	}
+
+public:
+	Server(Core::Base & base, Core::ThreadPool & pool, uint32_t max_batch): base(base), pool(pool), max_batch(std::max(1u, max_batch)) {}
+
+	// Serves until SIGINT or SIGTERM
+	void Serve(int listener) {
+		std::thread dispatcher([this] { Dispatch(); });
+		std::map<int, std::shared_ptr<Connection>> connections;
+		fcntl(listener, F_SETFL, O_NONBLOCK);
+		while (!interrupted) {
+			for (auto it = connections.begin(); it != connections.end();)
+				if (it->second->Finished()) {
+					close(it->first);
+					it = connections.erase(it);
+				} else {
+					++it;
+				}
+			std::vector<pollfd> fds = { { wake_pipe[0], POLLIN, 0 }, { listener, POLLIN, 0 } };
+			for (auto & entry : connections) {
+				short events = entry.second->eof ? 0 : POLLIN;
+				std::lock_guard<std::mutex> lock(entry.second->mutex);
+				if (!entry.second->output.empty())
+					events |= POLLOUT;
+				fds.push_back({ entry.first, events, 0 });
+			}
+			if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+				break;
+			if (fds[0].revents & POLLIN) {
+				char drain[256];
+				while (read(wake_pipe[0], drain, sizeof(drain)) == (ssize_t) sizeof(drain));
+			}
+			if (fds[1].revents & POLLIN)
+				for (int fd; (fd = accept(listener, nullptr, nullptr)) >= 0;) {
+					fcntl(fd, F_SETFL, O_NONBLOCK);
+					connections[fd] = std::make_shared<Connection>(fd);
+				}
+			for (size_t i = 2; i < fds.size(); ++i) {
+				if (!fds[i].revents) continue;
+				std::shared_ptr<Connection> connection = connections[fds[i].fd];
+				bool open = true;
+				if (fds[i].revents & POLLOUT)
+					open = WriteTo(*connection);
+				if (open && !connection->eof && fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+					open = ReadFrom(connection);
+				else if (connection->eof && fds[i].revents & (POLLHUP | POLLERR))
+					open = false;
+				if (!open) {
+					{
+						std::lock_guard<std::mutex> lock(connection->mutex);
+						connection->closed = true;
+					}
+					close(connection->fd);
+					connections.erase(fds[i].fd);
+				}
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			stopping = true;
+			queue_ready.notify_one();
+		}
+		dispatcher.join();
+		for (auto & entry : connections)
+			close(entry.first);
+	}
+	void WriteReport(std::ostream & output) const {
+		output << "batches " << batches << ", " << batched << " requests in them\n";
+		for (const auto & entry : latency) {
+			output << entry.first << ": " << entry.second.Summary() << '\n';
+			entry.second.Write(output);
+		}
+	}
+};
+
+// Pipelines every input line (repeat times), prints responses to stdout and the throughput to stderr
+static int RunClient(const Address & address, uint32_t repeat) {
+	int fd = OpenSocket(address, false);
+	if (fd < 0) {
+		std::cerr << "Couldn't connect: " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	std::string requests;
+	uint64_t lines = 0;
+	for (std::string line; std::getline(std::cin, line);) {
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+		requests += line;
+		requests += '\n';
+		++lines;
+	}
+	auto start = std::chrono::steady_clock::now();
+	// Sending and receiving at once, a long pipeline would fill both socket buffers otherwise
+	std::thread sender([fd, &requests, repeat] {
+		for (uint32_t i = 0; i < repeat; ++i)
+			if (!WriteAll(fd, requests.data(), requests.size())) break;
+		shutdown(fd, SHUT_WR);
+	});
+	uint64_t expected = lines * repeat, received = 0, errors = 0;
+	std::string pending;
+	char buffer[1 << 16];
+	while (received < expected) {
+		ssize_t count = read(fd, buffer, sizeof(buffer));
+		if (count < 0 && errno == EINTR) continue;
+		if (count <= 0) break;
+		pending.append(buffer, (size_t) count);
+		size_t done = 0;
+		for (size_t newline; (newline = pending.find('\n', done)) != std::string::npos; done = newline + 1) {
+			if (pending.compare(done, 6, "error ") == 0)
+				++errors;
+			if (repeat == 1)
+				std::cout.write(pending.data() + done, (std::streamsize) (newline + 1 - done));
+			++received;
+		}
+		pending.erase(0, done);
+	}
+	sender.join();
+	close(fd);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (repeat > 1)
+		std::cerr << received << " responses, " << errors << " errors in " << seconds << "s, "
+			<< (seconds > 0 ? (double) received / seconds : 0) << " requests/s" << std::endl;
+	if (received < expected) {
+		std::cerr << "Connection closed after " << received << " of " << expected << " responses" << std::endl;
+		return 1;
+	}
+	return errors ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+	std::vector<std::string> inputs;
+	Address address;
+	uint32_t threads = 0, max_batch = 256, repeat = 1;
+	bool client = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) {
+				std::cerr << arg << " needs a value" << std::endl;
+				std::exit(2);
+			}
+			return argv[++i];
+		};
+		if (arg == "-u" || arg == "--unix") address.unix_path = value();
+		else if (arg == "-p" || arg == "--port") address.port = (uint16_t) std::atoi(value().c_str());
+		else if (arg == "-t" || arg == "--threads") threads = (uint32_t) std::atoi(value().c_str());
+		else if (arg == "-b" || arg == "--batch") max_batch = (uint32_t) std::atoi(value().c_str());
+		else if (arg == "-c" || arg == "--client") client = true;
+		else if (arg == "-n") repeat = (uint32_t) std::max(1, std::atoi(value().c_str()));
+		else if (arg == "-h" || arg == "--help") {
+			Usage();
+			return 0;
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			std::cerr << "Unknown option " << arg << std::endl;
+			Usage();
+			return 2;
+		} else inputs.push_back(arg);
+	}
+	std::signal(SIGPIPE, SIG_IGN);
+	if (client)
+		return RunClient(address, repeat);
+
+	Core::ThreadPool pool(threads);
+	Core::Base base;
+	for (const std::string & path : inputs) {
+		if (path.size() > 5 && path.compare(path.size() - 5, 5, ".plnb") == 0) {
+			std::ifstream input(path, std::ios::binary);
+			Core::BinaryFormat::Error error = input ? base.LoadFromBinary(input) : Core::BinaryFormat::CANT_OPEN;
+			if (error != Core::BinaryFormat::OK) {
+				std::cerr << "Couldn't load " << path << ", error " << (int) error << std::endl;
+				return 1;
+			}
+			continue;
+		}
+		Core::LoadReport report = base.LoadFromFile(path, pool);
+		if (!report.opened) {
+			std::cerr << "Couldn't open " << path << std::endl;
+			return 1;
+		}
+		for (const Core::LoadError & error : report.errors)
+			std::cerr << path << ':' << error.line << ':' << error.position + 1 << ": error " << (int) error.error << std::endl;
+	}
+	// Loading isn't something to undo, and the history would keep old versions alive
+	base.SetHistoryCapacity(0);
+	if (pipe(wake_pipe) < 0) {
+		std::cerr << "Couldn't create a pipe: " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+	int listener = OpenSocket(address, true);
+	if (listener < 0) {
+		std::cerr << "Couldn't listen: " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	std::signal(SIGINT, OnSignal);
+	std::signal(SIGTERM, OnSignal);
+	std::cerr << base.Size() << " polynomials, listening on "
+		<< (address.port ? "127.0.0.1:" + std::to_string(address.port) : address.unix_path) << std::endl;
+	Server server(base, pool, max_batch);
+	server.Serve(listener);
+	close(listener);
+	if (!address.port)
+		unlink(address.unix_path.c_str());
+	server.WriteReport(std::cerr);
+	return 0;
+}
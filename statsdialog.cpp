@@ -0,0 +1,91 @@
+#include "statsdialog.h"
+#include <QCheckBox>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <fstream>
+
+StatsDialog::StatsDialog(const Core::Base & base, QWidget *parent)
+	: QDialog(parent), base(base) {
+	setWindowTitle(tr("Performance stats"));
+	resize(640, 420);
+	table = new QTableWidget(0, 6, this);
+	table->setHorizontalHeaderLabels({ tr("Operation"), tr("Calls"), tr("Terms"), tr("Allocations"), tr("Time, ms"), tr("Cache hits") });
+	table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+	table->verticalHeader()->setVisible(false);
+	table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	cache_label = new QLabel(this);
+	tracing = new QCheckBox(tr("Record trace"), this);
+	auto *reset = new QPushButton(tr("Reset"), this);
+	auto *export_trace = new QPushButton(tr("Export trace..."), this);
+	auto *buttons = new QHBoxLayout();
+	buttons->addWidget(tracing);
+	buttons->addStretch();
+	buttons->addWidget(reset);
+	buttons->addWidget(export_trace);
+	auto *layout = new QVBoxLayout(this);
+	if (!Core::PROFILING) {
+		layout->addWidget(new QLabel(tr("Built without CORE_PROFILING, only the cache is counted"), this));
+		tracing->setDisabled(true);
+		export_trace->setDisabled(true);
+	}
+	layout->addWidget(table);
+	layout->addWidget(cache_label);
+	layout->addLayout(buttons);
+	connect(reset, &QPushButton::released, this, &StatsDialog::Reset);
+	connect(export_trace, &QPushButton::released, this, &StatsDialog::ExportTrace);
+	connect(tracing, &QCheckBox::toggled, this, [](bool enabled) {
+		Core::Profiler::Instance().SetTracing(enabled);
+	});
+	refresh_timer = new QTimer(this);
+	refresh_timer->setInterval(1000);
+	connect(refresh_timer, &QTimer::timeout, this, &StatsDialog::Refresh);
+}
+
+void StatsDialog::Refresh() {
+	std::array<Core::OperationStats, Core::Profiler::OPERATIONS> stats = Core::Profiler::Instance().Stats();
+	table->setRowCount(0);
+	for (uint32_t i = 0; i < Core::Profiler::OPERATIONS; ++i) {
+		const Core::OperationStats & operation = stats[i];
+		if (!operation.calls && !operation.cache_hits) continue;
+		int row = table->rowCount();
+		table->insertRow(row);
+		table->setItem(row, 0, new QTableWidgetItem(QString(Core::Profiler::Name((Core::ProfiledOperation) i))));
+		table->setItem(row, 1, new QTableWidgetItem(QString::number(operation.calls)));
+		table->setItem(row, 2, new QTableWidgetItem(QString::number(operation.terms)));
+		table->setItem(row, 3, new QTableWidgetItem(QString::number(operation.allocations)));
+		table->setItem(row, 4, new QTableWidgetItem(QString::number((double) operation.nanoseconds / 1e6, 'f', 3)));
+		table->setItem(row, 5, new QTableWidgetItem(QString::number(operation.cache_hits)));
+	}
+	Core::CacheStats cache = base.GetCacheStats();
+	cache_label->setText(tr("Result cache: %1 hits, %2 misses, %3 evictions, %4 of %5 entries")
+		.arg(cache.hits).arg(cache.misses).arg(cache.evictions).arg(cache.size).arg(cache.capacity));
+}
+
+void StatsDialog::Reset() {
+	Core::Profiler::Instance().Reset();
+	Refresh();
+}
+
+void StatsDialog::ExportTrace() {
+	std::string path = QFileDialog::getSaveFileName(this, tr("Export Trace"), QString(), tr("Chrome trace (*.json)")).toStdString();
+	if (path.empty()) return;
+	std::ofstream output(path);
+	Core::Profiler::Instance().WriteChromeTrace(output);
+}
+
+void StatsDialog::showEvent(QShowEvent *event) {
+	QDialog::showEvent(event);
+	Refresh();
+	refresh_timer->start();
+}
+
+void StatsDialog::hideEvent(QHideEvent *event) {
+	refresh_timer->stop();
+	QDialog::hideEvent(event);
+}
@@ -0,0 +1,34 @@
+#ifndef STATSDIALOG_H
+#define STATSDIALOG_H
+
+#include "core.h"
+#include <QDialog>
+
+class QTableWidget;
+class QLabel;
+class QCheckBox;
+class QTimer;
+
+// Per-operation counters of Core::Profiler and the base's result cache, refreshed while the dialog is shown.
+// Operation counters need a build with CORE_PROFILING, the cache is counted always
+class StatsDialog : public QDialog {
+	Q_OBJECT
+
+public:
+	StatsDialog(const Core::Base & base, QWidget *parent = nullptr);
+	void Refresh();
+	void Reset();
+	void ExportTrace();
+
+protected:
+	void showEvent(QShowEvent *event) override;
+	void hideEvent(QHideEvent *event) override;
+
+private:
+	const Core::Base & base;
+	QTableWidget *table;
+	QLabel *cache_label;
+	QCheckBox *tracing;
+	QTimer *refresh_timer;
+};
+#endif // STATSDIALOG_H
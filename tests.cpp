@@ -0,0 +1,111 @@
+#include "core.h"
+#include <cstdio>
+#include <cstdlib>
+
+// Correctness checks for edge cases of core.h, every check prints its result. Exits with 1 if one fails
+
+static bool failed = false;
+
+static void Check(const char *name, const std::string & result, const std::string & expected) {
+	bool ok = result == expected;
+	std::printf("%-50s %s\n", name, ok ? "ok" : "FAILED");
+	if (!ok) {
+		std::printf("    got      %s\n    expected %s\n", result.c_str(), expected.c_str());
+		failed = true;
+	}
+}
+
+template<typename C, typename P = Core::BasicPolynomial<C>>
+static P Parse(const char *text) {
+	P p;
+	if (p.InitFromString(text).first != Core::PolynomialGrammar::OK) {
+		std::fprintf(stderr, "can't parse %s\n", text);
+		std::exit(1);
+	}
+	return p;
+}
+
+// Degrees of 2^63 and more have to stay unsigned in every factor
+static void TopDegrees() {
+	Core::BasicPolynomial<Core::Rational> integral;
+	Integral(Parse<int32_t>("x^9223372036854775810"), 1, integral);
+	Check("Integral of x^(2^63 + 2)", integral.ToString(), "1/9223372036854775811x^9223372036854775811");
+	Check("DefiniteIntegral of x^(2^63 + 2) from 0 to 1",
+		DefiniteIntegral(Parse<int32_t>("x^9223372036854775810"), Core::Rational(0), Core::Rational(1)).ToString(),
+		"1/9223372036854775811");
+	// the last factor is 2^64 - 1, a loop up to it mustn't wrap around
+	Integral(Parse<int32_t>("3x^18446744073709551614"), 1, integral);
+	Check("Integral of 3x^(2^64 - 2)", integral.ToString(), "1/6148914691236517205x^18446744073709551615");
+	Core::BasicPolynomial<Core::BigInt> derivative;
+	Derivative(Parse<Core::BigInt>("x^9223372036854775810"), 1, derivative);
+	Check("BigInt derivative of x^(2^63 + 2)", derivative.ToString(), "9223372036854775810x^9223372036854775809");
+	Derivative(Parse<Core::BigInt>("x^18446744073709551615"), 2, derivative);
+	Check("BigInt second derivative of x^(2^64 - 1)", derivative.ToString(),
+		"340282366920938463408034375210639556610x^18446744073709551613");
+	Check("ProductOfRange up to 2^64 - 1", Core::ProductOfRange(UINT64_MAX - 1, UINT64_MAX).ToString(),
+		"340282366920938463408034375210639556610");
+}
+
+// Far apart degrees mustn't be laid out densely by Gcd over integers
+static void SparseGcd() {
+	Core::Polynomial gcd;
+	Gcd(Parse<int32_t>("x^4000000000+1"), Parse<int32_t>("x^4000000000-1"), gcd);
+	Check("Gcd of x^4000000000 + 1 and x^4000000000 - 1", gcd.ToString(), "1");
+	Gcd(Parse<int32_t>("6x^4000000000-6"), Parse<int32_t>("4x^2000000000+4"), gcd);
+	Check("Gcd of 6x^4000000000 - 6 and 4x^2000000000 + 4", gcd.ToString(), "2x^2000000000 + 2");
+	// sparse remainders first, then the dense sequence once both are short
+	Gcd(Parse<int32_t>("x^100-1"), Parse<int32_t>("x^6-1"), gcd);
+	Check("Gcd of x^100 - 1 and x^6 - 1", gcd.ToString(), "x^2 - 1");
+	Core::BasicPolynomial<Core::BigInt> big_gcd;
+	Gcd(Parse<Core::BigInt>("x^18446744073709551615-x"), Parse<Core::BigInt>("x^18446744073709551614-1"), big_gcd);
+	Check("BigInt Gcd of x^(2^64 - 1) - x, x^(2^64 - 2) - 1", big_gcd.ToString(), "x^18446744073709551614 - 1");
+}
+
+// int32_t coefficients wrap modulo 2^32 in every merge (run under -fsanitize=undefined to catch signed overflow)
+static void WrappingMerges() {
+	Core::Polynomial sum, product;
+	Add(Parse<int32_t>("2147483647x^3+2147483647"), Parse<int32_t>("5x^3+2x"), sum);
+	Check("Dense Add past INT32_MAX", sum.ToString(), "- 2147483644x^3 + 2x + 2147483647");
+	Add(Parse<int32_t>("2147483647x^3000+1"), Parse<int32_t>("5x^3000+x"), sum);
+	Check("Sparse Add past INT32_MAX", sum.ToString(), "- 2147483644x^3000 + x + 1");
+	MultiplyByTerm(Parse<int32_t>("2147483647x^3+2147483647"), Core::Polynomial::Term{ 2, 3 }, product);
+	Check("MultiplyByTerm past INT32_MAX", product.ToString(), "2147483645x^5 + 2147483645x^2");
+	Check("Parse of like terms past INT32_MAX", Parse<int32_t>("2147483647x^2+5x^2").ToString(), "- 2147483644x^2");
+	Core::MultivariatePolynomial multivariate_sum;
+	Add(Parse<int32_t, Core::MultivariatePolynomial>("2147483647xy+1"), Parse<int32_t, Core::MultivariatePolynomial>("5xy+y"), multivariate_sum);
+	Check("Multivariate Add past INT32_MAX", multivariate_sum.ToString(), "- 2147483644xy + y + 1");
+}
+
+template<typename C>
+static std::string Roots(const char *text) {
+	std::string result;
+	try {
+		for (const Core::IntegerRoot & root : Parse<C>(text).GetRootsWithMultiplicity())
+			result += (result.empty() ? "" : " ") + std::to_string(root.value) + "^" + std::to_string(root.multiplicity);
+	} catch (const std::domain_error &) {
+		result = "domain_error";
+	}
+	return result;
+}
+
+// Constants wider than 64 bits are factored too, roots above the trial division limit mustn't be dropped
+static void WideConstantRoots() {
+	const char *wide = "x^3-1100511627786x^2+1099511638774116277781x-3298534906417744183296";
+	Check("BigInt roots 3, 2^40, 10^9 + 7", Roots<Core::BigInt>(wide), "3^1 1000000007^1 1099511627776^1");
+	Check("Int128 roots 3, 2^40, 10^9 + 7", Roots<Core::Int128>(wide), "3^1 1000000007^1 1099511627776^1");
+	Check("BigInt double root 10^9 + 7 with 2^40",
+		Roots<Core::BigInt>("x^3-1101511627790x^2+2200023270959162788913x-1099511643169162842740069761024"),
+		"1000000007^2 1099511627776^1");
+	// two primes above 2^35 multiply to more than 64 bits, that has to be reported
+	Check("BigInt roots of a wide semiprime constant", Roots<Core::BigInt>("x^2-103079215188x+2361183246142106764907"),
+		"domain_error");
+}
+
+int main() {
+	TopDegrees();
+	SparseGcd();
+	WrappingMerges();
+	WideConstantRoots();
+	std::printf(failed ? "FAILED\n" : "OK\n");
+	return failed ? 1 : 0;
+}